@@ -61,6 +61,34 @@ static inline int cortexm_is_root_mode() {
   return (control & 0x02) == 0;
 }
 
+// Atomically stores desired in *value if *value is equal to expected. Returns non-zero
+// if the value was stored. This works in unprivileged mode because an exception between
+// LDREX and STREX makes STREX fail. Cores without LDREX/STREX (armv6-m) always return
+// zero so the caller must have a fallback (such as an SVCall).
+static inline int
+cortexm_compare_and_swap(volatile int *value, int expected, int desired) {
+#if defined __ARM_FEATURE_LDREX && (__ARM_FEATURE_LDREX & 0x04)
+  __DMB();
+  do {
+    if ((int)__LDREXW((volatile u32 *)value) != expected) {
+      __CLREX();
+      return 0;
+    }
+  } while (__STREXW((u32)desired, (volatile u32 *)value) != 0);
+  __DMB();
+  return 1;
+#else
+  MCU_UNUSED_ARGUMENT(value);
+  MCU_UNUSED_ARGUMENT(expected);
+  MCU_UNUSED_ARGUMENT(desired);
+  return 0;
+#endif
+}
+
+// Same as cortexm_compare_and_swap() but the swap is done with interrupts masked so it
+// works on every core. Unprivileged callers pay for an SVCall.
+int cortexm_masked_compare_and_swap(volatile int *value, int expected, int desired);
+
 void cortexm_delay_us(u32 us) MCU_ROOT_EXEC_CODE;
 void cortexm_delay_ms(u32 ms) MCU_ROOT_EXEC_CODE;
 void cortexm_delay_systick(u32 ticks) MCU_ROOT_EXEC_CODE;
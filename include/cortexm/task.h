@@ -73,6 +73,8 @@ int task_mpu_calc_protection(task_memories_t *mem);
 u32 task_interrupt_stacksize();
 
 u8 task_get_exec_count();
+// number of round robin ticks (stops while the tick is off in tickless mode)
+u32 task_get_tick_count();
 u8 task_get_total();
 
 extern volatile s8 m_task_current_priority MCU_SYS_MEM;
@@ -67,6 +67,18 @@ void mq_flush(mqd_t mqdes);
 ssize_t mq_tryreceive(mqd_t mqdes, char *msg_ptr, size_t msg_len, unsigned *msg_prio);
 int mq_trysend(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_prio);
 
+// non standard zero-copy access
+void *mq_reserve(mqd_t mqdes);
+void *mq_timedreserve(mqd_t mqdes, const struct timespec *abs_timeout);
+int mq_commit(mqd_t mqdes, void *msg_ptr, size_t msg_len, unsigned msg_prio);
+void *mq_peek(mqd_t mqdes, size_t *msg_len, unsigned *msg_prio);
+void *mq_timedpeek(
+  mqd_t mqdes,
+  size_t *msg_len,
+  unsigned *msg_prio,
+  const struct timespec *abs_timeout);
+int mq_release(mqd_t mqdes, const void *msg_ptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -233,6 +233,12 @@ int  posix_trace_trygetnext_event(trace_id_t id,
 int posix_trace_trygetnext_data(trace_id_t id, void * data, size_t num_bytes);
 
 void posix_trace_event_addr(trace_event_id_t event_id, const void * data_ptr, size_t data_len, uint32_t addr);
+/*! \details Records an event in the ring of thread \a tid.
+ *
+ * Each thread's ring has a single writer, so \a tid must be the calling
+ * thread and the call must not be made from an interrupt. Events that
+ * break either rule are not recorded.
+ */
 void posix_trace_event_addr_tid(trace_event_id_t event_id, const void * data_ptr, size_t data_len, uint32_t addr, int tid);
 
 #ifdef __cplusplus
@@ -245,6 +245,8 @@ typedef struct MCU_PACK {
   int (*flash_erase_page)(const devfs_handle_t *handle, void *ctl);
   int (*flash_write_page)(const devfs_handle_t *handle, void *ctl);
   link_transport_driver_t *link_transport_driver;
+  // optional: fills flash_pageinfo_t (addr and size) for ctl->page (enables delta updates)
+  int (*flash_get_page_info)(const devfs_handle_t *handle, void *ctl);
 } sos_boot_config_t;
 
 
@@ -142,10 +142,10 @@ void sos_debug_log_fatal(u32 o_flags, const char *format, ...);
   do {                                                                                   \
     name_value##_sum += sos_realtime() - sos_debug_timer_scope_##name_value;             \
     if (name_value##_count++ == count_value) {                                           \
-      name_value##_count = 0;                                                            \
-      name_value##_sum = 0;                                                              \
       sos_debug_log_datum(                                                               \
         flag_value, MCU_STRINGIFY(name_value) ":%ld", name_value##_sum / count_value);   \
+      name_value##_count = 0;                                                            \
+      name_value##_sum = 0;                                                              \
     }                                                                                    \
   } while (0)
 
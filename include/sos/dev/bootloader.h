@@ -72,6 +72,17 @@ typedef struct MCU_PACK {
   u8 buf[BOOTLOADER_WRITEPAGESIZE] /*! \brief A buffer for writing to the flash */;
 } bootloader_writepage_t;
 
+/*! \brief See details below.
+ * \details This structure is used with \ref I_BOOTLOADER_GET_PAGE_HASH
+ * to compare a flash page with a new image.
+ */
+typedef struct MCU_PACK {
+  u32 addr /*! \brief The start address of the page */;
+  u32 size /*! \brief The size of the page */;
+  u32 page /*! \brief The page number */;
+  u32 crc32c /*! \brief CRC-32C of the whole page (see link_transport_crc32c()) */;
+} bootloader_page_hash_t;
+
 typedef struct {
   u8 * result;
   const u8 * auth_data;
@@ -163,6 +174,30 @@ extern void boot_invoke_bootloader(void *args);
 #define I_BOOTLOADER_IS_SIGNATURE_REQUIRED _IOCTL(BOOTLOADER_IOC_IDENT_CHAR, 5)
 #define I_BOOTLOADER_GET_PUBLIC_KEY _IOCTLR(BOOTLOADER_IOC_IDENT_CHAR, 6, auth_public_key_t)
 
+/*! \brief See below for details.
+ * \details This request reads the location and CRC-32C of the flash page
+ * that contains the address passed as the third IOCTL argument. It is
+ * used to skip pages that are unchanged by a new image
+ * (see link_writeflash_delta()).
+ *
+ * The request fails with ENOTSUP if the bootloader can't look up flash
+ * pages or if it verifies signatures (the contents of flash are hidden).
+ *
+ * \code
+ * bootloader_page_hash_t hash;
+ * link_ioctl_delay(driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_GET_PAGE_HASH, &hash, addr, 0);
+ * \endcode
+ */
+#define I_BOOTLOADER_GET_PAGE_HASH                                                       \
+  _IOCTLR(BOOTLOADER_IOC_IDENT_CHAR, 7, bootloader_page_hash_t)
+
+/*! \brief See below for details.
+ * \details This request erases the single flash page that contains
+ * the address passed as the third IOCTL argument. Pages before the
+ * program start address can't be erased.
+ */
+#define I_BOOTLOADER_ERASE_PAGE _IOCTL(BOOTLOADER_IOC_IDENT_CHAR, 8)
+
 #define I_BOOTLOADER_TOTAL 4
 
 #ifdef __cplusplus
@@ -28,7 +28,11 @@ extern "C" {
 #endif
 
 // 3.3.0 adds path_max and arg_max to sys_info_t
-#define SYS_VERSION (0x030300)
+// 3.4.0 adds I_SYS_GETIDLESTATS
+// 3.5.0 adds I_SYS_GETHEAPPROFILE
+// 3.6.0 adds I_SYS_GETSCHEDTRACE and I_SYS_GETSCHEDSTATS
+// 3.7.0 adds I_SYS_GETPROBE and I_SYS_RESETPROBES
+#define SYS_VERSION (0x030700)
 #define SYS_IOC_CHAR 's'
 
 /*! \details SYS flags used with
@@ -203,6 +207,161 @@ typedef struct MCU_PACK {
   u8 data[32];
 } sys_secret_key_t;
 
+/*! \brief Reasons the system left idle (see sys_idle_stats_t)
+ */
+enum sys_idle_wake_reason {
+  SYS_IDLE_WAKE_REASON_OTHER /*! Another interrupt (such as a device) */,
+  SYS_IDLE_WAKE_REASON_SLEEP /*! A sleeping task's wake time arrived */,
+  SYS_IDLE_WAKE_REASON_TIMER /*! A process timer expired */,
+  SYS_IDLE_WAKE_REASON_CLOCK /*! The microsecond clock rolled over to the next second */,
+  SYS_IDLE_WAKE_REASON_TICK /*! The round robin tick (see CONFIG_SCHED_IS_TICKLESS) */,
+  SYS_IDLE_WAKE_REASON_TOTAL
+};
+
+/*! \brief Idle residency statistics
+ * \details This structure is used with I_SYS_GETIDLESTATS.
+ * Counters start when the scheduler starts. The idle fraction
+ * is \a idle_usec / \a uptime_usec.
+ */
+typedef struct MCU_PACK {
+  u64 idle_usec /*! Total microseconds spent in sos_config.sleep.idle() */;
+  u64 uptime_usec /*! Microseconds since the scheduler started */;
+  u32 wakeup_count /*! Number of times the system left idle */;
+  u32 wakeups_per_second /*! Wakeups during the last full second */;
+  u32 wake_reason_count[SYS_IDLE_WAKE_REASON_TOTAL] /*! Wakeups for each reason */;
+  u32 resd[4];
+} sys_idle_stats_t;
+
+#define SYS_HEAP_PROFILE_TASK_COUNT 8
+#define SYS_HEAP_PROFILE_SITE_COUNT 16
+#define SYS_HEAP_PROFILE_BUCKET_COUNT 16
+#define SYS_HEAP_PROFILE_ID_OTHER 0xffffffff
+
+/*! \brief Heap usage by one task or call site
+ * \details This structure is used in sys_heap_profile_t. The last
+ * entry of each table has the id SYS_HEAP_PROFILE_ID_OTHER once the
+ * other entries are taken and counts everything that did not fit.
+ */
+typedef struct MCU_PACK {
+  u32 id /*! Task ID or call site (return address) */;
+  u32 size /*! Bytes currently allocated */;
+  u32 count /*! Blocks currently allocated */;
+  u32 total_count /*! Blocks allocated since the heap was created */;
+} sys_heap_usage_t;
+
+/*! \brief Heap allocation profile
+ * \details This structure is used with I_SYS_GETHEAPPROFILE.
+ * The kernel must be built with CONFIG_MALLOC_IS_PROFILE.
+ *
+ * Free block bucket \a n counts free blocks of 2^n to 2^(n+1)-1
+ * chunks. \a largest_free_size is exact when the highest non-empty
+ * bucket holds a single block and an upper bound otherwise.
+ * The external fragmentation of the heap is 1 - \a largest_free_size / \a free_size.
+ */
+typedef struct MCU_PACK {
+  u32 pid /*! Process to read (set by the caller) */;
+  u32 chunk_size /*! Bytes per chunk (CONFIG_MALLOC_CHUNK_SIZE) */;
+  u32 heap_size /*! Bytes the heap has taken from the process memory */;
+  u32 used_size /*! Bytes currently allocated */;
+  u32 used_count /*! Blocks currently allocated */;
+  u32 alloc_count /*! Successful allocations */;
+  u32 free_count /*! Blocks freed */;
+  u32 fail_count /*! Allocations that failed */;
+  u32 free_size /*! Bytes in free blocks */;
+  u32 largest_free_size /*! Bytes in the largest free block */;
+  u32 free_block_count[SYS_HEAP_PROFILE_BUCKET_COUNT] /*! Free blocks in each bucket */;
+  u32 free_block_chunks[SYS_HEAP_PROFILE_BUCKET_COUNT] /*! Chunks in each bucket */;
+  sys_heap_usage_t task[SYS_HEAP_PROFILE_TASK_COUNT] /*! Usage by allocating thread */;
+  sys_heap_usage_t site[SYS_HEAP_PROFILE_SITE_COUNT] /*! Usage by call site */;
+  u32 resd[8];
+} sys_heap_profile_t;
+
+#define SYS_SCHED_TRACE_EVENT_COUNT 16
+
+/*! \brief Scheduler trace record types (see sys_sched_trace_event_t)
+ */
+enum sys_sched_trace_type {
+  SYS_SCHED_TRACE_TYPE_SWITCH /*! \a tid started running; \a arg is the task it replaced
+                                 and \a value is 1 if that task was still ready */,
+  SYS_SCHED_TRACE_TYPE_WAKE /*! \a tid became ready; \a arg is the unblock reason and
+                               \a value is the task that woke it */,
+  SYS_SCHED_TRACE_TYPE_BLOCK /*! \a tid stopped being ready; \a value is the object it
+                                waits on (0 for sleep or exit) */,
+  SYS_SCHED_TRACE_TYPE_START /*! \a tid was created as part of process \a value */,
+  SYS_SCHED_TRACE_TYPE_EVENT_ENTER /*! A device event handler started; \a arg is the
+                                      exception number (0 for thread mode) and \a value
+                                      is the callback */,
+  SYS_SCHED_TRACE_TYPE_EVENT_EXIT /*! The device event handler returned \a value */,
+  SYS_SCHED_TRACE_TYPE_TOTAL
+};
+
+/*! \brief Scheduler trace record
+ * \details This structure is used in sys_sched_trace_t.
+ */
+typedef struct MCU_PACK {
+  u32 timestamp /*! Scheduler clock in microseconds (lower 32 bits) */;
+  u8 type /*! Record type (see enum sys_sched_trace_type) */;
+  u8 tid /*! Task the record is about */;
+  u16 arg /*! Depends on \a type */;
+  u32 value /*! Depends on \a type */;
+} sys_sched_trace_event_t;
+
+/*! \brief Scheduler trace
+ * \details This structure is used with I_SYS_GETSCHEDTRACE.
+ * The kernel must be built with CONFIG_SCHED_IS_TRACE.
+ *
+ * The kernel keeps the newest CONFIG_SCHED_TRACE_COUNT records. Set
+ * \a sequence to the \a next_sequence of the previous read to read the
+ * records that follow it; records that were overwritten in between
+ * are counted in \a lost_count.
+ */
+typedef struct MCU_PACK {
+  u32 sequence /*! Sequence of the first record to read (set by the caller) */;
+  u32 next_sequence /*! Sequence to read next */;
+  u32 count /*! Records copied to \a event */;
+  u32 lost_count /*! Records overwritten before they could be read */;
+  sys_sched_trace_event_t event[SYS_SCHED_TRACE_EVENT_COUNT];
+} sys_sched_trace_t;
+
+/*! \brief Scheduler statistics for one task
+ * \details This structure is used with I_SYS_GETSCHEDSTATS.
+ * The kernel must be built with CONFIG_SCHED_IS_TRACE. Counters start
+ * when the task is created.
+ */
+typedef struct MCU_PACK {
+  u32 tid /*! Task to read (set by the caller) */;
+  u32 pid /*! Process the task belongs to */;
+  u64 run_usec /*! Microseconds the task has been running */;
+  u64 wait_usec /*! Microseconds the task has been ready but not running */;
+  u32 max_wait_usec /*! Longest time from ready to running */;
+  u32 switch_count /*! Times the task started running */;
+  u32 preempt_count /*! Times the task was switched out while still ready */;
+  u32 wake_count /*! Times the task became ready */;
+  u32 block_count /*! Times the task blocked or slept */;
+  u32 resd[4];
+} sys_sched_stats_t;
+
+#define SYS_PROBE_NAME_MAX 32
+#define SYS_PROBE_BUCKET_COUNT 32
+
+/*! \brief Cycle probe histogram
+ * \details This structure is used with I_SYS_GETPROBE.
+ * The kernel must be built with CONFIG_SYS_IS_PROBE.
+ *
+ * Bucket \a n counts samples of 2^n to 2^(n+1)-1 cycles (bucket 0
+ * also counts samples of 0 cycles). The mean is \a total / \a count.
+ */
+typedef struct MCU_PACK {
+  u32 index /*! Probe to read (set by the caller, starting at 0) */;
+  char name[SYS_PROBE_NAME_MAX] /*! Probe name */;
+  u32 count /*! Samples recorded */;
+  u32 min /*! Fewest cycles in a sample */;
+  u32 max /*! Most cycles in a sample */;
+  u64 total /*! Sum of all samples in cycles */;
+  u32 bucket[SYS_PROBE_BUCKET_COUNT] /*! Samples in each log2 bucket */;
+  u32 resd[4];
+} sys_probe_t;
+
 #define I_SYS_GETVERSION _IOCTL(SYS_IOC_CHAR, I_MCU_GETVERSION)
 #define I_SYS_GETINFO _IOCTLR(SYS_IOC_CHAR, I_MCU_GETINFO, sys_info_t)
 #define I_SYS_26_GETINFO _IOCTLR(SYS_IOC_CHAR, I_MCU_GETINFO, sys_26_info_t)
@@ -293,7 +452,70 @@ typedef struct MCU_PACK {
  */
 #define I_SYS_DEAUTHENTICATE _IOCTL(SYS_IOC_CHAR, I_MCU_TOTAL + 10)
 
-#define I_SYS_TOTAL 11
+/*! \brief See below for details.
+ * \details Reads the idle residency statistics.
+ * \code
+ * sys_idle_stats_t stats;
+ * ioctl(fd, I_SYS_GETIDLESTATS, &stats);
+ * \endcode
+ *
+ */
+#define I_SYS_GETIDLESTATS _IOCTLR(SYS_IOC_CHAR, I_MCU_TOTAL + 11, sys_idle_stats_t)
+
+/*! \brief See below for details.
+ * \details Reads the heap allocation profile of a process.
+ * \code
+ * sys_heap_profile_t profile;
+ * profile.pid = 1;
+ * ioctl(fd, I_SYS_GETHEAPPROFILE, &profile);
+ * \endcode
+ *
+ */
+#define I_SYS_GETHEAPPROFILE _IOCTLRW(SYS_IOC_CHAR, I_MCU_TOTAL + 12, sys_heap_profile_t)
+
+/*! \brief See below for details.
+ * \details Reads scheduler trace records.
+ * \code
+ * sys_sched_trace_t trace;
+ * trace.sequence = 0;
+ * ioctl(fd, I_SYS_GETSCHEDTRACE, &trace);
+ * \endcode
+ *
+ */
+#define I_SYS_GETSCHEDTRACE _IOCTLRW(SYS_IOC_CHAR, I_MCU_TOTAL + 13, sys_sched_trace_t)
+
+/*! \brief See below for details.
+ * \details Reads the scheduler statistics of a task.
+ * \code
+ * sys_sched_stats_t stats;
+ * stats.tid = 1;
+ * ioctl(fd, I_SYS_GETSCHEDSTATS, &stats);
+ * \endcode
+ *
+ */
+#define I_SYS_GETSCHEDSTATS _IOCTLRW(SYS_IOC_CHAR, I_MCU_TOTAL + 14, sys_sched_stats_t)
+
+/*! \brief See below for details.
+ * \details Reads a cycle probe. Probes are numbered from 0;
+ * the request fails with ENOENT past the last probe.
+ * \code
+ * sys_probe_t probe;
+ * probe.index = 0;
+ * while( ioctl(fd, I_SYS_GETPROBE, &probe) == 0 ){
+ *   probe.index++;
+ * }
+ * \endcode
+ *
+ */
+#define I_SYS_GETPROBE _IOCTLRW(SYS_IOC_CHAR, I_MCU_TOTAL + 15, sys_probe_t)
+
+/*! \brief See below for details.
+ * \details Clears the samples of all cycle probes.
+ *
+ */
+#define I_SYS_RESETPROBES _IOCTL(SYS_IOC_CHAR, I_MCU_TOTAL + 16)
+
+#define I_SYS_TOTAL 17
 
 #ifdef __cplusplus
 }
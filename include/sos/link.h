@@ -4,6 +4,7 @@
 #define DEV_LINK_H_
 
 #include <dirent.h>
+#include <stdio.h>
 #include <sys/stat.h>
 
 #include <time.h>
@@ -90,6 +91,38 @@ int link_unlink(
   const char *path /*! The full path to the file to delete */);
 int link_lseek(link_transport_mdriver_t *driver, int fildes, s32 offset, int whence);
 
+/*! \details Writes \a nbyte bytes to the file at \a path starting at \a offset.
+ *
+ * The file is opened, written and closed by a single command with the data
+ * streamed as one continuous transfer. \a flags are open flags (O_WRONLY is
+ * implied) such as O_CREAT | O_TRUNC. Files are created with mode 0666.
+ * Devices that do not support streaming fall back to
+ * link_open()/link_write()/link_close().
+ *
+ * \return The number of bytes written or less than zero on error
+ */
+int link_sendfile(
+  link_transport_mdriver_t *driver,
+  const char *path,
+  int flags,
+  int offset,
+  const void *buf,
+  int nbyte);
+
+/*! \details Reads up to \a nbyte bytes from the file at \a path starting at \a offset.
+ *
+ * This is the counterpart of link_sendfile().
+ *
+ * \return The number of bytes read (less than \a nbyte at the end of the file) or
+ * less than zero on error
+ */
+int link_recvfile(
+  link_transport_mdriver_t *driver,
+  const char *path,
+  int offset,
+  void *buf,
+  int nbyte);
+
 // For files only
 int link_stat(link_transport_mdriver_t *driver, const char *path, struct stat *buf);
 int link_fstat(link_transport_mdriver_t *driver, int fildes, struct stat *buf);
@@ -124,6 +157,91 @@ int link_gettime(link_transport_mdriver_t *driver, struct link_tm *t);
 
 int link_kill_pid(link_transport_mdriver_t *driver, int pid, int signo);
 int link_get_sys_info(link_transport_mdriver_t *driver, sys_info_t *sys_info);
+int link_get_heap_profile(
+  link_transport_mdriver_t *driver,
+  int pid,
+  sys_heap_profile_t *profile);
+
+/*! \details Reads scheduler trace records starting at \a trace->sequence
+ * (see I_SYS_GETSCHEDTRACE). Returns the number of records read or less
+ * than zero on error.
+ */
+int link_get_sched_trace(link_transport_mdriver_t *driver, sys_sched_trace_t *trace);
+int link_get_sched_stats(
+  link_transport_mdriver_t *driver,
+  int tid,
+  sys_sched_stats_t *stats);
+
+/*! \details Reads the cycle histogram of the probe at \a index (see
+ * I_SYS_GETPROBE). Returns less than zero once \a index is past the last probe.
+ */
+int link_get_probe(link_transport_mdriver_t *driver, int index, sys_probe_t *probe);
+int link_reset_probes(link_transport_mdriver_t *driver);
+
+/*! \details An event decoded from a trace stream (see link_trace_stream_decode()). */
+typedef struct {
+  u64 timestamp;   //!< Scheduler clock in microseconds
+  u32 address;     //!< Kernel address or app address (see LINK_TRACE_APP_ADDRESS)
+  u32 pid;         //!< Process ID
+  u32 drop_count;  //!< Events lost here (only for LINK_POSIX_TRACE_OVERFLOW)
+  u8 tid;          //!< Thread ID
+  u8 event_id;     //!< LINK_POSIX_TRACE_* event ID
+  u8 is_truncated; //!< Non-zero if the device cut the data short
+  u8 data_size;    //!< Bytes of data
+  const u8 *data;  //!< Event data (valid during the callback only)
+} link_trace_stream_event_t;
+
+/*! \details Trace stream decoder state and statistics. */
+typedef struct {
+  u32 next_sequence;    //!< Sequence number expected in the next block
+  u32 block_count;      //!< Valid blocks decoded
+  u32 event_count;      //!< Events decoded
+  u32 drop_count;       //!< Events the device dropped
+  u32 lost_block_count; //!< Blocks missing from the sequence
+  u32 skip_count;       //!< Bytes skipped looking for a valid block
+  u8 is_started;
+} link_trace_stream_decoder_t;
+
+typedef int (*link_trace_stream_callback_t)(
+  void *context,
+  const link_trace_stream_event_t *event);
+
+void link_trace_stream_decoder_init(link_trace_stream_decoder_t *decoder);
+
+/*! \details Decodes trace stream blocks (see CONFIG_TRACE_STREAM_SIZE) in \a buf.
+ *
+ * \a callback is called for each event. Events the device dropped or that
+ * were in lost blocks are reported as a LINK_POSIX_TRACE_OVERFLOW event with
+ * drop_count set. Bytes that are not part of a valid block are skipped so
+ * the stream can share a UART with other output.
+ *
+ * \return The number of bytes used. A block that is cut short at the end of
+ * \a buf is not used and should be passed again with the bytes that follow
+ * it. If \a callback returns less than zero, decoding stops and that value
+ * is returned.
+ */
+int link_trace_stream_decode(
+  link_trace_stream_decoder_t *decoder,
+  const void *buf,
+  int nbyte,
+  link_trace_stream_callback_t callback,
+  void *context);
+
+/*! \details Writes the events in a captured trace stream as Chrome/Perfetto
+ * trace event JSON.
+ *
+ * \a resolve (optional) returns the name of the function at an address or
+ * NULL. App addresses are rebased to LINK_TRACE_APP_ADDRESS so they can be
+ * looked up in the app's ELF file.
+ *
+ * \return The number of events written or less than zero on error
+ */
+int link_trace_stream_export_json(
+  FILE *output,
+  const void *stream,
+  int nbyte,
+  const char *(*resolve)(void *context, u32 address),
+  void *context);
 
 int link_isbootloader(link_transport_mdriver_t *driver);
 int link_bootloader_attr(
@@ -164,6 +282,25 @@ int link_writeflash(
   int nbyte);
 int link_eraseflash(link_transport_mdriver_t *driver);
 
+/*! \details Writes an image to flash erasing and writing only the pages that changed.
+ *
+ * The bootloader reports the CRC-32C of each flash page covered by the image
+ * (see I_BOOTLOADER_GET_PAGE_HASH). Pages that match the image are skipped.
+ * The first page is always rewritten and link_verify_signature() must be called
+ * afterwards (as with link_writeflash()) to write the start of the image.
+ *
+ * If the bootloader can't report page hashes, this does link_eraseflash()
+ * followed by link_writeflash().
+ *
+ * \return The number of bytes written (less than \a nbyte if pages were
+ * skipped) or less than zero on error
+ */
+int link_writeflash_delta(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte);
+
 #if defined(__cplusplus)
 }
 #endif
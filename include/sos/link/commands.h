@@ -98,6 +98,63 @@ typedef struct MCU_PACK {
   u32 d_name_size;
 } link_readdir_reply_t;
 
+#define LINK_READDIR_BULK_MAX 1024
+
+typedef struct MCU_PACK {
+  link_cmd_t cmd;
+  s32 dirp;
+  s32 loc /*! Directory location to resume from (-1 to continue from the current location) */;
+  u32 nbyte /*! Maximum number of bytes of entries to return */;
+} link_readdir_bulk_t;
+
+typedef struct MCU_PACK {
+  s32 err /*! Number of bytes of entries that follow or -1 on error */;
+  s32 err_number;
+  s32 loc /*! Directory location of the next entry (cursor for resuming) */;
+  u16 count /*! Number of entries that follow */;
+  u16 is_end /*! Non-zero if the end of the directory was reached */;
+} link_readdir_bulk_reply_t;
+
+/*! \details Entries are packed back-to-back after a link_readdir_bulk_reply_t.
+ * Each entry header is followed by \a d_name_size bytes of the name (no null
+ * terminator).
+ */
+typedef struct MCU_PACK {
+  u32 d_ino;
+  u8 d_name_size;
+} link_readdir_bulk_entry_t;
+
+/*! \details Streams a whole file to the device.
+ *
+ * The device replies with a link_reply_t (err is zero) to confirm the
+ * command is supported. The host then sends the path followed by \a nbyte
+ * bytes as one continuous packet stream. The device writes each packet to the
+ * file as it arrives and sends a final link_reply_t (err is the number of
+ * bytes written or -1).
+ */
+typedef struct MCU_PACK {
+  link_cmd_t cmd;
+  u16 path_size;
+  u16 flags /*! Open flags (LINK_O_WRONLY is implied) */;
+  s32 offset /*! File offset to start writing from */;
+  u32 nbyte /*! Total number of bytes in the stream */;
+} link_sendfile_t;
+
+/*! \details Streams a whole file from the device.
+ *
+ * The handshake is the same as link_sendfile_t. After the path, the device
+ * sends up to \a nbyte bytes of the file as one continuous packet stream
+ * (a short packet marks the end of the file) followed by a final
+ * link_reply_t (err is the number of bytes read or -1).
+ */
+typedef struct MCU_PACK {
+  link_cmd_t cmd;
+  u16 path_size;
+  u16 resd;
+  s32 offset /*! File offset to start reading from */;
+  u32 nbyte /*! Maximum number of bytes to read */;
+} link_recvfile_t;
+
 typedef struct MCU_PACK {
   link_cmd_t cmd;
   s32 dirp;
@@ -205,6 +262,7 @@ typedef union {
   link_rmdir_t rmdir;
   link_opendir_t opendir;
   link_readdir_t readdir;
+  link_readdir_bulk_t readdir_bulk;
   link_closedir_t closedir;
   link_rewinddir_t rewinddir;
   link_telldir_t telldir;
@@ -218,6 +276,8 @@ typedef union {
   link_chown_t chown;
   link_chmod_t chmod;
   link_mkfs_t mkfs;
+  link_sendfile_t sendfile;
+  link_recvfile_t recvfile;
 } link_op_t;
 
 typedef struct MCU_PACK {
@@ -249,6 +309,9 @@ enum {
   LINK_CMD_CHMOD,
   LINK_CMD_EXEC,
   LINK_CMD_MKFS,
+  LINK_CMD_READDIR_BULK,
+  LINK_CMD_SENDFILE,
+  LINK_CMD_RECVFILE,
   LINK_CMD_TOTAL
 };
 
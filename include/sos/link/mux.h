@@ -0,0 +1,129 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_LINK_MUX_H_
+#define SOS_LINK_MUX_H_
+
+#include "../link.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*! \details The link multiplexer drives many devices from one thread.
+ *
+ * Each device added with link_mux_add() runs its requests one at a time
+ * in the order they were submitted. Requests for different devices run
+ * concurrently: whenever a device is waiting on its tty, link_mux_run()
+ * switches to another device that has data. Completion is reported by
+ * calling the request's callback from within link_mux_run().
+ *
+ * The multiplexer requires the default serial phy (link_load_default_driver())
+ * and is only available on POSIX hosts.
+ *
+ */
+typedef struct link_mux link_mux_t;
+
+/*! \details Stack size for each device when link_mux_create() is passed zero. */
+#define LINK_MUX_DEFAULT_STACK_SIZE (256 * 1024)
+#define LINK_MUX_MIN_STACK_SIZE (16 * 1024)
+
+typedef struct link_mux_request {
+  /*! \details The function to run for the device (the helpers below assign it) */
+  int (*function)(link_transport_mdriver_t *driver, struct link_mux_request *request);
+  void (*callback)(void *context, struct link_mux_request *request);
+  void *context;
+  const char *path /*! Path for open() or serial number for connect() */;
+  int fildes;
+  int flags /*! Open flags or ioctl request */;
+  int mode;
+  void *buf;
+  int nbyte /*! Number of bytes or ioctl integer argument */;
+  int result /*! The return value of the function */;
+  int error_number /*! The value of link_errno when the function returned */;
+  struct link_mux_request *next;
+} link_mux_request_t;
+
+/*! \details Creates a multiplexer for up to \a device_max devices.
+ *
+ * Each device gets a \a stack_size byte stack (allocated when it runs its
+ * first request) for the link functions to run on. Zero selects
+ * LINK_MUX_DEFAULT_STACK_SIZE.
+ *
+ * \return The multiplexer or NULL with errno set
+ */
+link_mux_t *link_mux_create(int device_max, int stack_size);
+
+/*! \details Frees \a mux and gives the drivers back their blocking phy reads.
+ *
+ * Requests that have started are suspended on the device stacks so the
+ * multiplexer can't be destroyed until link_mux_run() returns zero.
+ *
+ * \return Zero on success or -1 with errno set to EBUSY if any request has
+ * not completed
+ */
+int link_mux_destroy(link_mux_t *mux);
+
+int link_mux_add(link_mux_t *mux, link_transport_mdriver_t *driver);
+
+int link_mux_submit(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request);
+
+/*! \details Runs requests until they block and then waits up to \a timeout_ms for
+ * any device to have data.
+ *
+ * \return The number of requests that have not completed
+ */
+int link_mux_run(link_mux_t *mux, int timeout_ms);
+
+int link_mux_connect(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  const char *sn);
+
+int link_mux_open(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  const char *path,
+  int flags,
+  int mode);
+
+int link_mux_close(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes);
+
+int link_mux_read(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes,
+  void *buf,
+  int nbyte);
+
+int link_mux_write(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes,
+  const void *buf,
+  int nbyte);
+
+int link_mux_ioctl(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes,
+  int ioctl_request,
+  void *argp,
+  int arg);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* SOS_LINK_MUX_H_ */
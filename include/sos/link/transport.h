@@ -23,17 +23,70 @@
 #define LINK2_PACKET_ACK (0x07)
 #define LINK2_PACKET_NACK (0x54)
 
+// acks for an empty packet flagged with LINK2_FLAG_IS_CRC32C and/or LINK2_FLAG_IS_LZ
+// (the slave supports CRC-32C, LZ compression or both)
+#define LINK2_PACKET_CRC32C_ACK (0x0a)
+#define LINK2_PACKET_LZ_ACK (0x0b)
+#define LINK2_PACKET_CRC32C_LZ_ACK (0x0c)
+
+// CRC-32C packets use 4 bytes in place of the 2 checksum bytes
+#define LINK_PACKET_CRC32C_SIZE (4)
+
 #define LINK3_PACKET_START (18)
 #define LINK3_PACKET_HEADER_SIZE (6) // start, size, and checksum (2 bytes)
-#define LINK3_PACKET_DATA_SIZE (LINK3_MAX_PACKET_SIZE - LINK3_PACKET_HEADER_SIZE)
+#define LINK3_PACKET_DATA_SIZE (sizeof(link3_pkt_data_t))
 #define LINK3_PACKET_PAYLOAD_SIZE (992)
 
 
 #define LINK3_PACKET_ACK (0x08)
 #define LINK3_PACKET_NACK (0x55)
 
-enum link2_flags { LINK2_FLAG_IS_CHECKSUM = (1 << 0) };
-enum link3_flags { LINK3_FLAG_IS_CHECKSUM = (1 << 0) };
+// windowed acks carry the packet sequence number in place of the checksum
+#define LINK3_PACKET_WINDOW_ACK (0x09)
+#define LINK3_PACKET_WINDOW_NACK (0x56)
+// the slave rejected the acked packet and discards the rest of the transfer
+#define LINK3_PACKET_WINDOW_ABORT (0x57)
+// rx_sequence after an abort -- windowed packets are dropped until the master syncs
+#define LINK3_PACKET_SEQUENCE_ABORTED (0xff)
+
+// the upper nibble of link3_pkt_t.o_flags holds the sequence number
+#define LINK3_PACKET_SEQUENCE_SHIFT (4)
+#define LINK3_PACKET_SEQUENCE_MASK (0x0f)
+#define LINK3_PACKET_SEQUENCE(o_flags)                                                   \
+  (((o_flags) >> LINK3_PACKET_SEQUENCE_SHIFT) & LINK3_PACKET_SEQUENCE_MASK)
+#define LINK3_PACKET_SET_SEQUENCE(o_flags, sequence)                                     \
+  (((o_flags) & ~(LINK3_PACKET_SEQUENCE_MASK << LINK3_PACKET_SEQUENCE_SHIFT))            \
+   | (((sequence) & LINK3_PACKET_SEQUENCE_MASK) << LINK3_PACKET_SEQUENCE_SHIFT))
+
+// must be less than the sequence space so stale acks can be detected
+#define LINK3_WINDOW_SIZE (8)
+#define LINK3_WINDOW_RETRY_MAX (4)
+
+enum link2_flags {
+  LINK2_FLAG_IS_CHECKSUM = (1 << 0),
+  LINK2_FLAG_IS_CRC32C = (1 << 1) /*! Packet ends with a CRC-32C (empty packets keep the 2 byte checksum) */,
+  LINK2_FLAG_IS_LZ
+  = (1 << 2) /*! Packet data is LZ compressed (set in the master's o_flags to request compression) */
+};
+enum link3_flags {
+  LINK3_FLAG_IS_CHECKSUM = (1 << 0),
+  LINK3_FLAG_IS_WINDOW = (1 << 1) /*! Packet is part of a pipelined (windowed) transfer */,
+  LINK3_FLAG_IS_WINDOW_SYNC
+  = (1 << 2) /*! Receiver should resynchronize its sequence to this packet */,
+  LINK3_FLAG_IS_CRC32C = (1 << 3) /*! Packet ends with a CRC-32C */
+};
+
+#define LINK2_PACKET_IS_CRC32C(pkt)                                                      \
+  (((pkt)->o_flags & LINK2_FLAG_IS_CRC32C) && ((pkt)->size > 0))
+#define LINK3_PACKET_IS_CRC32C(pkt) ((pkt)->o_flags & LINK3_FLAG_IS_CRC32C)
+
+// number of bytes on the wire (including the start byte)
+#define LINK2_PACKET_SIZE(pkt)                                                           \
+  ((pkt)->size + LINK2_PACKET_HEADER_SIZE                                                \
+   + (LINK2_PACKET_IS_CRC32C(pkt) ? LINK_PACKET_CRC32C_SIZE - 2 : 0))
+#define LINK3_PACKET_SIZE(pkt)                                                           \
+  ((pkt)->size + LINK3_PACKET_HEADER_SIZE                                                \
+   + (LINK3_PACKET_IS_CRC32C(pkt) ? LINK_PACKET_CRC32C_SIZE - 2 : 0))
 
 typedef struct MCU_PACK {
   u8 ack;
@@ -50,7 +103,7 @@ typedef struct MCU_PACK {
   u8 start;
   u8 o_flags;
   u16 size;
-  u8 data[LINK2_PACKET_DATA_SIZE + 2]; // 2 checksum bytes
+  u8 data[LINK2_PACKET_DATA_SIZE + LINK_PACKET_CRC32C_SIZE]; // 2 checksum bytes or CRC-32C
 } link2_pkt_t;
 
 #define LINK3_STATE_OPEN 0
@@ -68,13 +121,13 @@ typedef struct MCU_PACK {
   u8 data[LINK3_PACKET_PAYLOAD_SIZE];
 } link3_pkt_data_t;
 
-#define LINK3_MAX_PACKET_SIZE (sizeof(link3_pkt_data_t) + 2)
+#define LINK3_MAX_PACKET_SIZE (LINK3_PACKET_DATA_SIZE + LINK_PACKET_CRC32C_SIZE)
 
 typedef struct MCU_PACK {
   u8 start;
   u8 o_flags;
   u16 size;
-  u8 data[LINK3_MAX_PACKET_SIZE]; // 2 checksum bytes
+  u8 data[LINK3_MAX_PACKET_SIZE]; // 2 checksum bytes or CRC-32C
 } link3_pkt_t;
 
 
@@ -148,6 +201,15 @@ typedef struct link_transport_driver {
   u8 shared_secret[32];
   link_transport_crypto_handle_t crypto_handle;
   const link_transport_crypto_driver_t * crypto_driver;
+  // link3 windowed transfers: 0 is not negotiated, 1 is stop-and-wait
+  u8 window_size;
+  u8 tx_sequence;
+  u8 rx_sequence;
+  // packets carry a CRC-32C (the master negotiates this when LINK2/3_FLAG_IS_CHECKSUM is set)
+  u8 is_crc32c;
+  // master to slave packets may be compressed (the master negotiates this when
+  // LINK2_FLAG_IS_LZ is set)
+  u8 is_lz;
 } link_transport_driver_t;
 
 typedef struct {
@@ -173,6 +235,9 @@ typedef struct {
     const u8 identifier[32],
     link_transport_device_keys_t * keys);
 
+  // entries prefetched by link_readdir_r() (allocated on first use)
+  void *readdir_cache;
+
 } link_transport_mdriver_t;
 
 typedef struct {
@@ -222,6 +287,35 @@ int link_transport_slaveread(
 
 u64 link_transport_gettime();
 
+/*! \details Updates a CRC-32C (Castagnoli) with \a nbyte bytes of \a buf.
+ *
+ * Start with \a crc equal to zero. The result of one call can be passed as
+ * \a crc to continue the calculation over more data.
+ */
+u32 link_transport_crc32c(u32 crc, const void *buf, int nbyte);
+
+// compressed data at the end of a buffer this much larger than the
+// decompressed data can be decompressed in place
+#define LINK_TRANSPORT_LZ_IN_PLACE_MARGIN (LINK_PACKET_CRC32C_SIZE)
+
+/*! \details Compresses \a nbyte bytes (up to 64KB) in the LZ4 block format.
+ *
+ * This is only available on the host. The slave only decompresses.
+ * The result can be decompressed in place (see LINK_TRANSPORT_LZ_IN_PLACE_MARGIN).
+ *
+ * \return The compressed size or -1 if it doesn't fit in \a dest_size bytes
+ */
+int link_transport_lz_compress(void *dest, int dest_size, const void *src, int nbyte);
+
+/*! \details Decompresses an LZ4 block from link_transport_lz_compress().
+ *
+ * The decoder needs no memory other than \a dest. \a src may be at the end of
+ * the same buffer as \a dest.
+ *
+ * \return The decompressed size or -1 if the data is corrupt or doesn't fit
+ */
+int link_transport_lz_decompress(void *dest, int dest_size, const void *src, int nbyte);
+
 void link1_transport_mastersettimeout(link_transport_mdriver_t *driver, int t);
 int link1_transport_masterwrite(
   link_transport_mdriver_t *driver,
@@ -258,6 +352,7 @@ int link2_transport_masterwrite(
   const void *buf,
   int nbyte);
 int link2_transport_masterread(link_transport_mdriver_t *driver, void *buf, int nbyte);
+int link2_transport_masternegotiate(link_transport_mdriver_t *driver);
 int link2_transport_slavewrite(
   link_transport_driver_t *driver,
   const void *buf,
@@ -286,6 +381,10 @@ int link3_transport_masterwrite(
   link_transport_mdriver_t *driver,
   const void *buf,
   int nbyte);
+// Reads are not windowed. The slave streams the packets without waiting for
+// acks so there is no round trip to pipeline, but there is also no
+// retransmission: a lost or corrupt packet fails the read and the caller
+// has to repeat the command.
 int link3_transport_masterread(link_transport_mdriver_t *driver, void *buf, int nbyte);
 int link3_transport_slavewrite(
   link_transport_driver_t *driver,
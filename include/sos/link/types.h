@@ -283,6 +283,7 @@ struct link_stat {
 #define LINK_NOTIFY_ID_FILE_WRITE 0x201
 #define LINK_NOTIFY_ID_FILE_READ 0x200
 #define LINK_NOTIFY_ID_POSIX_TRACE_EVENT 0x300
+#define LINK_NOTIFY_ID_POSIX_TRACE_STREAM 0x301
 
 struct link_timespec {
   u32 tv_sec;
@@ -345,6 +346,41 @@ typedef struct MCU_PACK {
   u32 sum32; // must be aligned on 4-byte boundary
 } link_trace_event_t;
 
+/*! \details Traced app addresses are rebased to the address apps are linked at. */
+#define LINK_TRACE_APP_ADDRESS 0xDE000000
+
+/*! \details Marks the start of each block in a trace stream ("TSBK"). */
+#define LINK_TRACE_STREAM_MAGIC 0x4b425354
+
+/*! \details Largest amount of data kept with a trace stream record. */
+#define LINK_TRACE_STREAM_DATA_SIZE 127
+/*! \details Set in a record's data size byte if the data was cut short. */
+#define LINK_TRACE_STREAM_TRUNCATED 0x80
+/*! \details Largest encoded trace stream record. */
+#define LINK_TRACE_STREAM_RECORD_MAX (3 + 5 + 5 + 4 + LINK_TRACE_STREAM_DATA_SIZE)
+
+/*! \details Header of a block of trace stream records.
+ *
+ * Each record that follows is packed as:
+ * - u8 event id
+ * - u8 thread id
+ * - u8 data size (LINK_TRACE_STREAM_TRUNCATED is set if data was cut short)
+ * - microseconds since the previous record in the block (LEB128, 0 for the first)
+ * - process id (LEB128)
+ * - u32 caller address (little endian, app addresses are rebased to 0xDE000000)
+ * - the data
+ */
+typedef struct MCU_PACK {
+  u32 magic;      //!< LINK_TRACE_STREAM_MAGIC
+  u16 size;       //!< Bytes in the block including this header
+  u16 id;         //!< LINK_NOTIFY_ID_POSIX_TRACE_STREAM
+  u32 sequence;   //!< Block number (a gap means blocks were lost)
+  u32 drop_count; //!< Events dropped since the previous block
+  u64 timestamp;  //!< Scheduler clock (microseconds) of the first record
+  u16 count;      //!< Number of records in the block
+  u16 checksum;   //!< Sum of the record bytes
+} link_trace_stream_header_t;
+
 typedef u32 link_mode_t;
 
 /*! \details Link read-only flag when opening a file/device.
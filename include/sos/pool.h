@@ -0,0 +1,232 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_POOL_H_
+#define SOS_POOL_H_
+
+/*! \addtogroup POOL Fixed-size Object Pools
+ * @{
+ *
+ * \details A pool hands out fixed-size blocks from one region of memory
+ * in constant time. Free blocks are kept on a lock-free list (LDREX/STREX
+ * on the device, compiler atomics on the host) so a pool can be shared
+ * by threads and interrupts without a mutex or an SVCall. Cores without
+ * LDREX/STREX (armv6-m) mask interrupts for each update instead, which
+ * takes an SVCall when the caller is unprivileged.
+ *
+ * Pools declared with SOS_POOL_INITIALIZER() need no initialization call:
+ * blocks that have never been used are handed out in order before the
+ * free list is used.
+ *
+ * \code
+ * static SOS_POOL_DECLARE_STORAGE(handle_storage, sizeof(handle_t), 4);
+ * static sos_pool_t handle_pool =
+ *   SOS_POOL_INITIALIZER(handle_storage, sizeof(handle_t), 4);
+ *
+ * handle_t *h = sos_pool_alloc(&handle_pool);
+ * ...
+ * sos_pool_free(&handle_pool, h);
+ * \endcode
+ *
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <sdk/types.h>
+#include <stdlib.h>
+
+#if !defined __link
+#include "cortexm/cortexm.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \details Pool statistics (see sos_pool_get_stats()). */
+typedef struct {
+  u32 used;        //!< Blocks currently allocated
+  u32 peak;        //!< Most blocks allocated at one time
+  u32 alloc_count; //!< Successful allocations
+  u32 free_count;  //!< Blocks returned to the pool
+  u32 fail_count;  //!< Allocations that failed because the pool was empty
+  u32 retry_count; //!< Compare-and-swap retries caused by contention
+} sos_pool_stats_t;
+
+/*! \details Fixed-size object pool. */
+typedef struct {
+  volatile u32 head;   // (tag << 16) | (index + 1) of the first free block, 0 when empty
+  volatile u32 unused; // blocks that have never been allocated start at this index
+  void *storage;
+  u16 block_size;
+  u16 count;
+  volatile sos_pool_stats_t stats;
+} sos_pool_t;
+
+/*! \details Size of each block (object size rounded up to a whole word). */
+#define SOS_POOL_BLOCK_SIZE(object_size)                                                 \
+  ((((object_size) + sizeof(u32) - 1) / sizeof(u32)) * sizeof(u32))
+
+/*! \details Bytes of storage needed for \a count objects. */
+#define SOS_POOL_STORAGE_SIZE(object_size, count)                                        \
+  (SOS_POOL_BLOCK_SIZE(object_size) * (count))
+
+/*! \details Declares word-aligned static storage for a pool. */
+#define SOS_POOL_DECLARE_STORAGE(name, object_size, count)                               \
+  u32 name[SOS_POOL_STORAGE_SIZE(object_size, count) / sizeof(u32)]
+
+/*! \details Static initializer for a pool that uses \a storage. */
+#define SOS_POOL_INITIALIZER(storage_value, object_size, count_value)                    \
+  {                                                                                      \
+    .head = 0, .unused = 0, .storage = (storage_value),                                  \
+    .block_size = SOS_POOL_BLOCK_SIZE(object_size), .count = (count_value), .stats = {0} \
+  }
+
+static inline int sos_pool_compare_and_swap(volatile u32 *value, u32 expected, u32 desired) {
+#if defined __link
+  return __atomic_compare_exchange_n(
+    value, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#elif defined __ARM_FEATURE_LDREX && (__ARM_FEATURE_LDREX & 0x04)
+  return cortexm_compare_and_swap((volatile int *)value, (int)expected, (int)desired);
+#else
+  // cortexm_compare_and_swap() always fails without LDREX/STREX (armv6-m)
+  return cortexm_masked_compare_and_swap((volatile int *)value, (int)expected, (int)desired);
+#endif
+}
+
+static inline u32 sos_pool_add(volatile u32 *value, s32 amount) {
+  u32 current;
+  do {
+    current = *value;
+  } while (sos_pool_compare_and_swap(value, current, current + amount) == 0);
+  return current + amount;
+}
+
+static inline void sos_pool_update_peak(sos_pool_t *pool, u32 used) {
+  u32 peak;
+  do {
+    peak = pool->stats.peak;
+  } while ((used > peak)
+           && (sos_pool_compare_and_swap(&pool->stats.peak, peak, used) == 0));
+}
+
+static inline void *sos_pool_get_block(const sos_pool_t *pool, u32 index) {
+  return (u8 *)pool->storage + index * pool->block_size;
+}
+
+/*! \details Initializes \a pool at runtime.
+ *
+ * @param pool The pool to initialize
+ * @param storage Word-aligned storage for the blocks or NULL to malloc() it
+ * @param object_size Size of each object
+ * @param count Number of objects (up to 65535)
+ * @return Zero on success or -1 with errno set to EINVAL or ENOMEM
+ *
+ */
+static inline int
+sos_pool_initialize(sos_pool_t *pool, void *storage, u32 object_size, u32 count) {
+  if ((count > 0xffff) || (SOS_POOL_BLOCK_SIZE(object_size) > 0xffff)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (storage == NULL) {
+    storage = malloc(SOS_POOL_STORAGE_SIZE(object_size, count));
+    if (storage == NULL) {
+      return -1;
+    }
+  }
+
+  const sos_pool_t initial_pool = SOS_POOL_INITIALIZER(storage, object_size, count);
+  *pool = initial_pool;
+  return 0;
+}
+
+/*! \details Returns a block from \a pool or NULL if the pool is empty. */
+static inline void *sos_pool_alloc(sos_pool_t *pool) {
+  void *block = NULL;
+  u32 head;
+  u32 retry_count = 0;
+
+  while (((head = pool->head) & 0xffff) != 0) {
+    // the tag makes the swap fail if the block was taken and returned meanwhile
+    const u32 index = (head & 0xffff) - 1;
+    const u32 next = *(volatile u32 *)sos_pool_get_block(pool, index);
+    if (sos_pool_compare_and_swap(
+          &pool->head, head, ((head + 0x10000) & 0xffff0000) | (next & 0xffff))) {
+      block = sos_pool_get_block(pool, index);
+      break;
+    }
+    retry_count++;
+  }
+
+  if (block == NULL) {
+    u32 unused;
+    while ((unused = pool->unused) < pool->count) {
+      if (sos_pool_compare_and_swap(&pool->unused, unused, unused + 1)) {
+        block = sos_pool_get_block(pool, unused);
+        break;
+      }
+      retry_count++;
+    }
+  }
+
+  if (retry_count) {
+    sos_pool_add(&pool->stats.retry_count, retry_count);
+  }
+
+  if (block == NULL) {
+    sos_pool_add(&pool->stats.fail_count, 1);
+    return NULL;
+  }
+
+  sos_pool_add(&pool->stats.alloc_count, 1);
+  sos_pool_update_peak(pool, sos_pool_add(&pool->stats.used, 1));
+  return block;
+}
+
+/*! \details Returns true if \a block is from \a pool's storage. */
+static inline int sos_pool_is_member(const sos_pool_t *pool, const void *block) {
+  const u8 *start = pool->storage;
+  return ((const u8 *)block >= start)
+         && ((const u8 *)block < start + pool->count * pool->block_size);
+}
+
+/*! \details Returns \a block (from sos_pool_alloc()) to \a pool. */
+static inline void sos_pool_free(sos_pool_t *pool, void *block) {
+  const u32 index = ((u8 *)block - (u8 *)pool->storage) / pool->block_size;
+  u32 head;
+  u32 retry_count = 0;
+  // count the block as returned first so used never exceeds count
+  sos_pool_add(&pool->stats.used, -1);
+  do {
+    head = pool->head;
+    *(volatile u32 *)block = head & 0xffff;
+    retry_count++;
+  } while (sos_pool_compare_and_swap(
+             &pool->head, head, ((head + 0x10000) & 0xffff0000) | (index + 1))
+           == 0);
+
+  if (retry_count > 1) {
+    sos_pool_add(&pool->stats.retry_count, retry_count - 1);
+  }
+  sos_pool_add(&pool->stats.free_count, 1);
+}
+
+/*! \details Copies \a pool's statistics to \a stats. */
+static inline void sos_pool_get_stats(const sos_pool_t *pool, sos_pool_stats_t *stats) {
+  stats->used = pool->stats.used;
+  stats->peak = pool->stats.peak;
+  stats->alloc_count = pool->stats.alloc_count;
+  stats->free_count = pool->stats.free_count;
+  stats->fail_count = pool->stats.fail_count;
+  stats->retry_count = pool->stats.retry_count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/*! @} */
+
+#endif /* SOS_POOL_H_ */
@@ -0,0 +1,110 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_PROBE_H_
+#define SOS_PROBE_H_
+
+/*! \addtogroup PROBE Cycle Probes
+ * @{
+ *
+ * \details A probe keeps a histogram of how many CPU cycles a section of
+ * kernel code takes (CONFIG_SYS_IS_PROBE). Each probe is registered in the
+ * .sos_probe linker section so the system device can list and reset
+ * them (I_SYS_GETPROBE, I_SYS_RESETPROBES) without a table to maintain.
+ *
+ * \code
+ * SOS_PROBE_DEFINE(my_function);
+ *
+ * void my_function() {
+ *   SOS_PROBE_ENTER(my_function);
+ *   ...
+ *   SOS_PROBE_EXIT(my_function);
+ * }
+ * \endcode
+ *
+ * Cycles come from the DWT cycle counter which unprivileged code cannot
+ * read, so samples are only recorded when the code runs privileged (in
+ * an interrupt, an SVCall or a root thread). sos_probe_check() is called
+ * by the scheduler thread while it is still privileged and raises a
+ * fatal event if the sample it takes there isn't recorded.
+ *
+ */
+
+/*! \file */
+
+#include <sdk/types.h>
+
+#include "sos/dev/sys.h"
+
+#if !defined __link
+#include "cortexm/cortexm.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  u32 count;
+  u32 min;
+  u32 max;
+  u64 total;
+  u32 bucket[SYS_PROBE_BUCKET_COUNT];
+} sos_probe_stats_t;
+
+typedef struct {
+  const char *name;
+  sos_probe_stats_t *stats;
+} sos_probe_t;
+
+#if CONFIG_SYS_IS_PROBE && !defined __link
+
+#define SOS_PROBE_DEFINE(name_value)                                                     \
+  static sos_probe_stats_t sos_probe_stats_##name_value MCU_SYS_MEM;                     \
+  static const sos_probe_t sos_probe_##name_value                                        \
+    __attribute__((section(".sos_probe"), used, aligned(4))) = {                         \
+      .name = MCU_STRINGIFY(name_value),                                                 \
+      .stats = &sos_probe_stats_##name_value}
+
+#define SOS_PROBE_ENTER(name_value)                                                      \
+  const u32 sos_probe_start_##name_value = sos_probe_get_cycles()
+
+#define SOS_PROBE_EXIT(name_value)                                                       \
+  sos_probe_record(&sos_probe_##name_value, sos_probe_start_##name_value)
+
+void sos_probe_initialize();
+void sos_probe_check();
+void sos_probe_root_record(const sos_probe_t *probe, u32 cycles) MCU_ROOT_EXEC_CODE;
+int sos_probe_root_read(sys_probe_t *probe) MCU_ROOT_EXEC_CODE;
+void sos_probe_root_reset() MCU_ROOT_EXEC_CODE;
+
+// CONTROL bit 0 is nPRIV (bit 1 only selects the stack); handler mode is
+// privileged even when the interrupted thread is not
+static inline int sos_probe_is_privileged() {
+  return ((__get_CONTROL() & 0x01) == 0) || (__get_IPSR() != 0);
+}
+
+static inline u32 sos_probe_get_cycles() {
+  return sos_probe_is_privileged() ? cortexm_get_cycle_counter() : 0;
+}
+
+static inline void sos_probe_record(const sos_probe_t *probe, u32 start) {
+  if (sos_probe_is_privileged()) {
+    sos_probe_root_record(probe, cortexm_get_cycle_counter() - start);
+  }
+}
+
+#else
+
+#define SOS_PROBE_DEFINE(name_value) typedef int sos_probe_##name_value##_is_disabled
+#define SOS_PROBE_ENTER(name_value)
+#define SOS_PROBE_EXIT(name_value)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+/*! @} */
+
+#endif /* SOS_PROBE_H_ */
@@ -38,6 +38,26 @@ void sos_trace_root_trace_event(
   const void *data_ptr,
   size_t data_len);
 
+// batched trace stream (CONFIG_TRACE_STREAM_SIZE > 0)
+void sos_trace_stream_event(
+  link_trace_event_id_t event_id,
+  const void *data_ptr,
+  size_t data_len,
+  u32 addr,
+  int tid);
+void sos_trace_stream_root_event(
+  link_trace_event_id_t event_id,
+  const void *data_ptr,
+  size_t data_len,
+  u32 addr,
+  int tid);
+// opens the trace device for the scheduler (task 0)
+void sos_trace_stream_initialize();
+// sends the blocks (task 0) or asks the scheduler to send them (any other thread)
+int sos_trace_stream_flush();
+// called by the scheduler's idle loop
+void sos_trace_stream_poll();
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,6 +33,12 @@ cmsdk_copy_target(${BUILD_RELEASE_TARGET} ${BUILD_DEBUG_TARGET})
 cmsdk_library("${BUILD_RELEASE_OPTIONS}")
 cmsdk_library("${BUILD_DEBUG_OPTIONS}")
 
+# host programs that exercise the link library against virtual devices
+option(SOS_LINK_IS_TEST "Build the link benchmarks" OFF)
+if(SOS_LINK_IS_TEST)
+	add_subdirectory(test/link)
+endif()
+
 install(FILES include/mcu/mcu.h DESTINATION include/StratifyOS/mcu)
 install(DIRECTORY include/sos DESTINATION include/StratifyOS PATTERN CMakelists.txt EXCLUDE)
 
@@ -28,26 +28,18 @@
 
 #include <device/auth.h>
 
-#include "sos_config.h"
-
-#include "sos/symbols.h"
-
 #include "boot_config.h"
-#include "boot_link.h"
-#include "cortexm/cortexm.h"
+#include "boot_link_sys.h"
 #include "cortexm/util.h"
-#include "sos/arch.h"
 #include "sos/debug.h"
-#include "sos/led.h"
-#include "sos/sos.h"
+#include "sos/dev/flash.h"
 
 static bool is_erased = false;
 
 static u8 first_page[256];
 
-static u32 hash_size = 0;
-
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+static u32 hash_size = 0;
 static u8 ecc_context_buffer[256];
 static void *ecc_context = ecc_context_buffer;
 static u8 sha_context_buffer[256];
@@ -75,11 +67,14 @@ static void boot_link_cmd_read(link_transport_driver_t *driver, link_data_t *arg
 static void
 boot_link_cmd_reset_bootloader(link_transport_driver_t *driver, link_data_t *args);
 static void erase_flash(link_transport_driver_t *driver);
+static int get_page_info(u32 addr, flash_pageinfo_t *info);
 static void boot_link_cmd_reset(link_transport_driver_t *driver, link_data_t *args);
 
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
 static const u8 *get_public_key() {
-  return (const u8 *)((u32)sos_config.sys.secret_key_address & ~0x01);
+  return (const u8 *)((size_t)sos_config.sys.secret_key_address & ~0x01);
 }
+#endif
 
 void (*const boot_link_cmd_func_table[LINK_BOOTLOADER_CMD_TOTAL])(
   link_transport_driver_t *,
@@ -87,27 +82,25 @@ void (*const boot_link_cmd_func_table[LINK_BOOTLOADER_CMD_TOTAL])(
   boot_link_cmd_none, boot_link_cmd_readserialno, boot_link_cmd_ioctl,
   boot_link_cmd_read};
 
+#if !defined __link
+// the virtual device reads each op itself and calls boot_link_execute()
 void *boot_link_update(void *arg) {
 
   link_transport_driver_t *driver = arg;
-  link_data_t data;
+  link_op_t op;
 
   dstr("open driver\n");
   if ((driver->handle = driver->open(0, 0)) == LINK_PHY_ERROR) {
     return 0;
   }
 
-  data.op.cmd = 0;
-
   dstr("Enter update loop\n");
   while (1) {
     // Wait for data to arrive on the USB
     int err;
     do {
 
-      if (
-        (err = link_transport_slaveread(driver, &data.op, sizeof(link_op_t), NULL, NULL))
-        < 0) {
+      if ((err = link_transport_slaveread(driver, &op, sizeof(link_op_t), NULL, NULL)) < 0) {
         dstr("e:");
         dint(err);
         dstr("\n");
@@ -116,26 +109,30 @@ void *boot_link_update(void *arg) {
 
     } while (err < 0);
 
-    dstr("EXEC CMD: ");
-    dint(data.op.cmd);
-    dstr("\n");
-    if (data.op.cmd < LINK_BOOTLOADER_CMD_TOTAL) {
-      data.reply.err_number = 0;
-      data.reply.err = 0;
-      boot_link_cmd_func_table[data.op.cmd](driver, &data);
-    } else {
-      data.reply.err = -1;
-      data.reply.err_number = EINVAL;
-    }
-
-    // send the reply
-    if (data.op.cmd != 0) {
-      link_transport_slavewrite(driver, &data.reply, sizeof(data.reply), NULL, NULL);
-      data.op.cmd = 0;
-    }
+    boot_link_execute(driver, &op);
   }
   return NULL;
 }
+#endif
+
+void boot_link_execute(link_transport_driver_t *driver, const link_op_t *op) {
+  link_data_t data = {.op = *op};
+
+  dstr("EXEC CMD: ");
+  dint(data.op.cmd);
+  dstr("\n");
+  if (data.op.cmd < LINK_BOOTLOADER_CMD_TOTAL) {
+    boot_link_cmd_func_table[data.op.cmd](driver, &data);
+  } else {
+    data.reply.err = -1;
+    data.reply.err_number = EINVAL;
+  }
+
+  // send the reply
+  if (data.op.cmd != 0) {
+    link_transport_slavewrite(driver, &data.reply, sizeof(data.reply), NULL, NULL);
+  }
+}
 
 void boot_link_cmd_none(link_transport_driver_t *driver, link_data_t *args) {
   MCU_UNUSED_ARGUMENT(driver);
@@ -218,7 +215,12 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
     // write data to io_buf
     dstr("info\n");
     attr.version = BCDVERSION;
-    sos_config.sys.get_serial_number((mcu_sn_t *)attr.serialno);
+    {
+      // attr is packed
+      mcu_sn_t serial_number;
+      sos_config.sys.get_serial_number(&serial_number);
+      memcpy(attr.serialno, &serial_number, sizeof(attr.serialno));
+    }
     // mcu_core_getserialno((mcu_sn_t *)(attr.serialno));
 
     // attr.startaddr = boot_board_config.program_start_addr;
@@ -389,6 +391,53 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
     }
   } break;
 
+  case I_BOOTLOADER_GET_PAGE_HASH: {
+    flash_pageinfo_t info;
+    args->reply.err = get_page_info(args->op.ioctl.arg, &info);
+    if (args->reply.err < 0) {
+      // the reply is read in place of the data
+      break;
+    }
+
+    const bootloader_page_hash_t hash = {
+      .addr = info.addr,
+      .size = info.size,
+      .page = info.page,
+      .crc32c = link_transport_crc32c(
+        0, boot_link_sys_flash(info.addr, info.size), info.size)};
+
+    if (link_transport_slavewrite(driver, &hash, size, NULL, NULL) < 0) {
+      args->op.cmd = 0;
+    }
+    break;
+  }
+
+  case I_BOOTLOADER_ERASE_PAGE: {
+    flash_pageinfo_t info;
+    args->reply.err = get_page_info(args->op.ioctl.arg, &info);
+    if (args->reply.err < 0) {
+      break;
+    }
+
+    if (info.addr < sos_config.boot.program_start_address) {
+      // never erase the bootloader
+      errno = EINVAL;
+      args->reply.err = -1;
+      break;
+    }
+
+    dstr("erase page:");
+    dint(info.page);
+    dstr("\n");
+    args->reply.err = sos_config.boot.flash_erase_page(
+      &sos_config.boot.flash_handle, (void *)(size_t)info.page);
+    if (args->reply.err != 0) {
+      errno = EIO;
+      args->reply.err = -1;
+    }
+    break;
+  }
+
   default:
     args->reply.err_number = EINVAL;
     args->reply.err = -1;
@@ -400,6 +449,37 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
   }
 }
 
+int get_page_info(u32 addr, flash_pageinfo_t *info) {
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+  // page hashes would reveal the contents of flash and the signature
+  // is calculated as the whole image is written
+  MCU_UNUSED_ARGUMENT(addr);
+  MCU_UNUSED_ARGUMENT(info);
+  errno = ENOTSUP;
+  return -1;
+#else
+  if (sos_config.boot.flash_get_page_info == NULL) {
+    errno = ENOTSUP;
+    return -1;
+  }
+
+  // pages are in order of address
+  info->page = 0;
+  while (sos_config.boot.flash_get_page_info(&sos_config.boot.flash_handle, info) >= 0) {
+    if (addr < info->addr) {
+      break;
+    }
+    if (addr < info->addr + info->size) {
+      return 0;
+    }
+    info->page++;
+  }
+
+  errno = EINVAL;
+  return -1;
+#endif
+}
+
 void boot_link_cmd_read(link_transport_driver_t *driver, link_data_t *args) {
   args->reply.err = read_flash(driver, args->op.read.addr, args->op.read.nbyte);
   dint(args->reply.err);
@@ -419,7 +499,8 @@ void erase_flash(link_transport_driver_t *driver) {
   int result;
   boot_event_flash_t args = {.abort = 0, .total = -1, .increment = -1};
 
-  while (sos_config.boot.flash_erase_page(&sos_config.boot.flash_handle, (void *)page++)
+  while (sos_config.boot.flash_erase_page(
+           &sos_config.boot.flash_handle, (void *)(size_t)page++)
          != 0) {
     // while (mcu_flash_erasepage(FLASH_PORT, (void *)page++) != 0) {
     // these are the bootloader pages and won't be erased
@@ -438,7 +519,7 @@ void erase_flash(link_transport_driver_t *driver) {
 
   // erase the flash pages -- ends when an erase on an invalid page is attempted
   while ((result = sos_config.boot.flash_erase_page(
-            &sos_config.boot.flash_handle, (void *)page++))
+            &sos_config.boot.flash_handle, (void *)(size_t)page++))
          == 0) {
     // while ((result = mcu_flash_erasepage(FLASH_PORT, (void *)page++)) == 0) {
     sos_led_root_enable(0);
@@ -480,7 +561,7 @@ static int mcu_flash_read(const devfs_handle_t *cfg, devfs_async_t *async) {
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
   memset(async->buf, 0, async->nbyte);
 #else
-  memcpy(async->buf, (const void *)async->loc, async->nbyte);
+  memcpy(async->buf, boot_link_sys_flash(async->loc, async->nbyte), async->nbyte);
 #endif
   return async->nbyte;
 }
@@ -0,0 +1,87 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef BOOT_LINK_SYS_H_
+#define BOOT_LINK_SYS_H_
+
+/*
+ * The board services the bootloader command handlers in boot_link.c use.
+ *
+ * The virtual device (test/link/vdevice) builds boot_link.c on the host
+ * with __link defined. It provides sos_config (only the members declared
+ * below), cortexm_reset(), cortexm_get_hardware_id(), mcu_sync_io(),
+ * htoc(), the root LED and sos_handle_event() and maps flash addresses
+ * into its simulated flash.
+ *
+ */
+
+#include "sos/link.h"
+
+#if defined __link
+
+#include "sos/boot/boot_debug.h"
+#include "sos/events.h"
+#include "sos/fs/types.h"
+#include "sos/led.h"
+
+// the virtual device has no crypto api
+#define CONFIG_BOOT_IS_VERIFY_SIGNATURE 0
+
+typedef struct {
+  struct {
+    const void *secret_key_address;
+    u32 secret_key_size;
+    void (*get_serial_number)(mcu_sn_t *serial_number);
+    const void *(*kernel_request_api)(u32 request);
+  } sys;
+  struct {
+    u32 program_start_address;
+    // a host pointer (a device address on a board)
+    u32 *software_bootloader_request_address;
+    u32 software_bootloader_request_value;
+    devfs_handle_t flash_handle;
+    int (*flash_erase_page)(const devfs_handle_t *handle, void *ctl);
+    int (*flash_write_page)(const devfs_handle_t *handle, void *ctl);
+    int (*flash_get_page_info)(const devfs_handle_t *handle, void *ctl);
+  } boot;
+} boot_link_sys_config_t;
+
+extern boot_link_sys_config_t sos_config;
+
+void cortexm_reset(void *args);
+u32 cortexm_get_hardware_id();
+
+int mcu_sync_io(
+  const devfs_handle_t *handle,
+  int (*func)(const devfs_handle_t *handle, devfs_async_t *op),
+  int loc,
+  const void *buf,
+  int nbyte,
+  int flags);
+
+// NULL if [address, address + size) is not in the simulated flash
+const void *boot_link_sys_flash(u32 address, u32 size);
+
+#else
+
+#include "sos_config.h"
+
+#include "sos/symbols.h"
+
+#include "boot_link.h"
+#include "cortexm/cortexm.h"
+#include "sos/arch.h"
+#include "sos/led.h"
+#include "sos/sos.h"
+
+// flash is memory mapped
+static inline const void *boot_link_sys_flash(u32 address, u32 size) {
+  MCU_UNUSED_ARGUMENT(size);
+  return (const void *)address;
+}
+
+#endif
+
+// one command from the host (the body of the loop in boot_link_update())
+void boot_link_execute(link_transport_driver_t *driver, const link_op_t *op);
+
+#endif /* BOOT_LINK_SYS_H_ */
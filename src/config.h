@@ -51,6 +51,21 @@
 #define CONFIG_SCHED_RR_DURATION 10
 #endif
 
+// Only run the round robin tick when tasks share the current priority
+#if !defined CONFIG_SCHED_IS_TICKLESS
+#define CONFIG_SCHED_IS_TICKLESS 0
+#endif
+
+// Record context switches, wakes, blocks and device events in a ring with per-task run time
+#if !defined CONFIG_SCHED_IS_TRACE
+#define CONFIG_SCHED_IS_TRACE 0
+#endif
+
+// number of scheduler trace records (power of two)
+#if !defined CONFIG_SCHED_TRACE_COUNT
+#define CONFIG_SCHED_TRACE_COUNT 128
+#endif
+
 //If the chip has double precision floating point and only 8 sections
 //this needs to be set to zero
 #if !defined CONFIG_TASK_MPU_REGION_OFFSET
@@ -86,6 +101,49 @@
 #define CONFIG_MALLOC_SBRK_JUMP_SIZE 128
 #endif
 
+//keep free chunks in size-class lists for bounded time malloc() and free()
+#if !defined CONFIG_MALLOC_IS_SEGREGATED
+#define CONFIG_MALLOC_IS_SEGREGATED 0
+#endif
+
+//verify every chunk on free() rather than just the freed chunk and the next one
+#if !defined CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
+#if CONFIG_MALLOC_IS_SEGREGATED
+#define CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP 0
+#else
+#define CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP 1
+#endif
+#endif
+
+//chunks verified per malloc()/free() by the incremental heap scrubber (0 to disable)
+#if !defined CONFIG_MALLOC_SCRUB_CHUNKS
+#if CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
+#define CONFIG_MALLOC_SCRUB_CHUNKS 0
+#else
+#define CONFIG_MALLOC_SCRUB_CHUNKS 8
+#endif
+#endif
+
+//count heap use by task and call site and keep a free block histogram (adds a word per block)
+#if !defined CONFIG_MALLOC_IS_PROFILE
+#define CONFIG_MALLOC_IS_PROFILE 0
+#endif
+
+//open file handles kept in a static pool by assetfs and drive_assetfs (then malloc())
+#if !defined CONFIG_SYSFS_HANDLE_POOL_COUNT
+#define CONFIG_SYSFS_HANDLE_POOL_COUNT 4
+#endif
+
+//bytes for two blocks of batched sos_trace records sent from the idle loop (0 to send each event)
+#if !defined CONFIG_TRACE_STREAM_SIZE
+#define CONFIG_TRACE_STREAM_SIZE 0
+#endif
+
+//keep cycle histograms for SOS_PROBE_DEFINE() probes readable with I_SYS_GETPROBE
+#if !defined CONFIG_SYS_IS_PROBE
+#define CONFIG_SYS_IS_PROBE 0
+#endif
+
 // require a valid digital signature when installing applications
 #if !defined CONFIG_APPFS_IS_VERIFY_SIGNATURE
 #define CONFIG_APPFS_IS_VERIFY_SIGNATURE 1
@@ -7,6 +7,16 @@
 
 extern int sos_main();
 
+typedef struct {
+  volatile int *value;
+  int expected;
+  int desired;
+  int result;
+} compare_and_swap_t;
+
+static void root_masked_compare_and_swap(compare_and_swap_t *args) MCU_ROOT_EXEC_CODE;
+static void svcall_masked_compare_and_swap(void *args) MCU_ROOT_EXEC_CODE;
+
 // this is used to ensure svcall's execute from start to finish
 cortexm_svcall_t cortexm_svcall_validation MCU_SYS_MEM;
 
@@ -23,6 +33,8 @@ void cortexm_enter_cycle_scope() {
 
 u32 cortexm_exit_cycle_scope() { return DWT->CYCCNT; }
 
+u32 cortexm_get_cycle_counter() { return DWT->CYCCNT; }
+
 void cortexm_delay_systick(u32 ticks) {
   u32 countdown = ticks;
   u32 start = cortexm_get_systick_value();
@@ -176,6 +188,33 @@ void cortexm_initialize_heap() {
 
 void cortexm_svcall(cortexm_svcall_t call, void *args) { asm volatile("SVC 0\n"); }
 
+void root_masked_compare_and_swap(compare_and_swap_t *args) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  args->result = (*args->value == args->expected);
+  if (args->result) {
+    *args->value = args->desired;
+  }
+  __set_PRIMASK(primask);
+}
+
+void svcall_masked_compare_and_swap(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  root_masked_compare_and_swap(args);
+}
+
+int cortexm_masked_compare_and_swap(volatile int *value, int expected, int desired) {
+  compare_and_swap_t args = {
+    .value = value, .expected = expected, .desired = desired, .result = 0};
+  // CPSID is ignored in unprivileged thread mode
+  if (((__get_CONTROL() & 0x01) == 0) || (__get_IPSR() != 0)) {
+    root_masked_compare_and_swap(&args);
+  } else {
+    cortexm_svcall(svcall_masked_compare_and_swap, &args);
+  }
+  return args.result;
+}
+
 int cortexm_validate_callback(mcu_callback_t callback) {
   // \todo callbacks need to be in ROOT_EXEC_ONLY
   if (
@@ -1,5 +1,7 @@
 #include "sos/fs/devfs.h"
 
+#include "../sys/scheduler/scheduler_trace.h"
+
 // used to execute any handler
 int devfs_execute_event_handler(mcu_event_handler_t *handler, u32 o_events, void *data) {
   int ret = 0;
@@ -7,7 +9,9 @@ int devfs_execute_event_handler(mcu_event_handler_t *handler, u32 o_events, void
   if (handler->callback) {
     event.o_events = o_events;
     event.data = data;
+    SCHEDULER_TRACE_EVENT_ENTER(handler->callback);
     ret = handler->callback(handler->context, &event);
+    SCHEDULER_TRACE_EVENT_EXIT(ret);
   }
   return ret;
 }
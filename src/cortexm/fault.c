@@ -55,6 +55,13 @@ void hardfault_handler(u32 fault_status, hw_stack_frame_t *handler_stack) {
     } else if (fault_status & 0xFF00) {
       return busfault_handler(fault_status >> 8, handler_stack);
     } else if (fault_status & 0xFFFF0000) {
+#if __FPU_USED == 1
+      // NOCP escalates here when the FPU is used with interrupts disabled or in
+      // a handler that the usage fault can't preempt
+      if (((fault_status >> 16) == (1 << 3)) && (task_root_claim_fpu() == 0)) {
+        return;
+      }
+#endif
       return usagefault_handler(fault_status >> 16, handler_stack);
     }
   }
@@ -206,6 +213,12 @@ void cortexm_usagefault_handler() {
   register u32 status;
   status = SCB->CFSR;
   SCB->CFSR = status; // clear the bits by writing one
+#if __FPU_USED == 1
+  // the FPU is turned off for tasks that don't hold its registers
+  if (((status >> 16) == (1 << 3)) && (task_root_claim_fpu() == 0)) {
+    return;
+  }
+#endif
   usagefault_handler(status >> 16, handler_stack);
 }
 
@@ -3,31 +3,55 @@
 #include <errno.h>
 #include <string.h>
 
-#include "sos_config.h"
+#include "config.h"
 
 #include "cortexm/task.h"
 #include "sos/sos.h"
 #include "sos/debug.h"
+#include "sos/probe.h"
 #include "sos/symbols.h"
 #include "task_local.h"
 
+#include "../sys/scheduler/scheduler_timing.h"
+#include "../sys/scheduler/scheduler_trace.h"
+
 #define SYSTICK_MIN_CYCLES 10000
 
 volatile task_t sos_task_table[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
 
 volatile s8 m_task_current_priority MCU_SYS_MEM;
-static volatile u8 m_task_exec_count MCU_SYS_MEM;
 int m_task_rr_reload MCU_SYS_MEM;
 volatile int m_task_current MCU_SYS_MEM;
-static void svcall_read_rr_timer(u32 *val) MCU_ROOT_CODE;
+static volatile u32 m_task_tick_count MCU_SYS_MEM;
+static volatile u8 m_task_is_tick_enabled MCU_SYS_MEM;
+#if CONFIG_SCHED_IS_TICKLESS
+// when the current task's time was last credited while the tick was off
+static struct mcu_timeval m_task_tickless_start MCU_SYS_MEM;
+static u64 get_tickless_cycles() MCU_ROOT_EXEC_CODE;
+static void credit_tickless_time() MCU_ROOT_EXEC_CODE;
+#endif
+#if __FPU_USED == 1
+#define FPU_CPACR_ACCESS ((1 << 20) | (1 << 21) | (1 << 22) | (1 << 23))
+// the task whose values are in the FPU registers (-1 for none)
+static volatile int m_task_fpu_owner MCU_SYS_MEM;
+static void save_fpu(int id) MCU_ROOT_EXEC_CODE;
+static void load_fpu(int id) MCU_ROOT_EXEC_CODE;
+static void update_fpu_access() MCU_ROOT_EXEC_CODE;
+#endif
+static void svcall_read_rr_timer(u64 *val) MCU_ROOT_CODE;
 static int set_systick_interval(int interval) MCU_ROOT_EXEC_CODE;
 static void switch_contexts() MCU_ROOT_EXEC_CODE;
+static int get_next_task() MCU_ROOT_EXEC_CODE;
+static int is_round_robin_tick_needed() MCU_ROOT_EXEC_CODE;
+static void update_round_robin_tick() MCU_ROOT_EXEC_CODE;
 static void task_check_count_flag() MCU_ROOT_EXEC_CODE;
+static void task_check_round_robin_tick() MCU_ROOT_EXEC_CODE;
 
 static void system_reset(); // This is used if the OS process returns
 void system_reset() { cortexm_svcall(cortexm_reset, NULL); }
 u8 task_get_total() { return CONFIG_TASK_TOTAL; }
-u8 task_get_exec_count() { return m_task_exec_count; }
+u8 task_get_exec_count() { return task_get_ready_count(m_task_current_priority); }
+u32 task_get_tick_count() { return m_task_tick_count; }
 
 void task_root_elevate_current_priority(s8 value) {
   cortexm_disable_interrupts();
@@ -54,7 +78,7 @@ int task_init(
   system_stack = (u8 *)system_memory + system_memory_size;
 
   sos_task_table[0].sp = (u8 *)system_stack - sizeof(hw_stack_frame_t);
-  sos_task_table[0].flags = TASK_FLAGS_EXEC | TASK_FLAGS_USED | TASK_FLAGS_ROOT;
+  sos_task_table[0].flags = TASK_FLAGS_USED | TASK_FLAGS_ROOT;
   sos_task_table[0].parent = 0;
   sos_task_table[0].priority = 0;
   sos_task_table[0].pid = 0;
@@ -70,7 +94,7 @@ int task_init(
   frame->pc = ((u32)scheduler_function);
   frame->lr = (u32)system_reset;
   frame->psr = 0x21000000; // default PSR value
-#if __FPU_USED != 0
+#if __FPU_USED == 1
   sos_task_table[0].fpscr = FPU->FPDSCR;
 #endif
 
@@ -102,14 +126,16 @@ int task_init(
   sos_config.mcu.set_interrupt_priority(UsageFault_IRQn, 3);
 
   // enable the FPU if it is in use
-#if __FPU_USED != 0
-  SCB->CPACR =
-    (1 << 20) | (1 << 21) | (1 << 22) | (1 << 23); // allow full access to co-processor
+#if __FPU_USED == 1
+  SCB->CPACR = FPU_CPACR_ACCESS; // allow full access to co-processor
   asm volatile("ISB");
 
   // FPU->FPCCR = (1<<31) | (1<<30); //set CONTROL<2> when FPU is used, enable lazy state
   // preservation
   FPU->FPCCR = 0; // don't automatically save the FPU registers -- save them manually
+
+  // the registers belong to task 0 until another task uses the FPU
+  m_task_fpu_owner = 0;
 #endif
 
   // Turn on the task timer (MCU implementation dependent)
@@ -118,6 +144,7 @@ int task_init(
   sos_task_table[0].rr_time = m_task_rr_reload;
   cortexm_set_stack_ptr((void *)&_top_of_stack); // reset the handler stack pointer
   cortexm_enable_systick_irq();                  // Enable context switching
+  m_task_is_tick_enabled = 1;
   cortexm_set_vector_table_addr(sos_config.sys.vector_table);
 
   sos_config.cache.enable();
@@ -207,9 +234,13 @@ void task_svcall_new_task(new_task_t *task) {
       sos_task_table[i].timer.t = 0;
       sos_task_table[i].rr_time = m_task_rr_reload;
       memcpy((void *)&(sos_task_table[i].mem), task->mem, sizeof(task_memories_t));
-#if __FPU_USED != 0
+#if __FPU_USED == 1
       sos_task_table[i].fpscr = FPU->FPDSCR;
       memset((void *)sos_task_table[i].fp, 0, sizeof(sos_task_table[i].fp));
+      if (m_task_fpu_owner == i) {
+        // don't hand the previous task's registers to the new one
+        m_task_fpu_owner = -1;
+      }
 #endif
       break;
     }
@@ -237,7 +268,11 @@ void task_svcall_new_task(new_task_t *task) {
 void task_root_delete(int id) {
   if ((id < task_get_total()) && (id >= 1)) {
     task_deassert_used(id);
-    task_deassert_exec(id);
+#if __FPU_USED == 1
+    if (m_task_fpu_owner == id) {
+      m_task_fpu_owner = -1;
+    }
+#endif
   }
 }
 
@@ -295,13 +330,20 @@ int task_get_thread_zero(int pid) {
   return -1;
 }
 
-static void svcall_read_rr_timer(u32 *val) {
+static void svcall_read_rr_timer(u64 *val) {
   CORTEXM_SVCALL_ENTER();
+#if CONFIG_SCHED_IS_TICKLESS
+  if (m_task_is_tick_enabled == 0) {
+    *val = (m_task_rr_reload - sos_task_table[m_task_current].rr_time)
+           + get_tickless_cycles();
+    return;
+  }
+#endif
   *val = m_task_rr_reload - SysTick->VAL; // cppcheck-suppress[ConfigurationNotChecked]
 }
 
 u64 task_root_gettime(int tid) {
-  u32 val;
+  u64 val;
   if (tid != task_get_current()) {
     return sos_task_table[tid].timer.t + (m_task_rr_reload - sos_task_table[tid].rr_time);
   } else {
@@ -311,7 +353,7 @@ u64 task_root_gettime(int tid) {
 }
 
 u64 task_gettime(int tid) {
-  u32 val;
+  u64 val;
   if (tid != task_get_current()) {
     return sos_task_table[tid].timer.t + (m_task_rr_reload - sos_task_table[tid].rr_time);
   } else {
@@ -323,11 +365,17 @@ u64 task_gettime(int tid) {
 
 
 
+SOS_PROBE_DEFINE(switch_contexts);
+
 void switch_contexts() {
   // Save the PSP to the current task's stack pointer
-  SOS_DEBUG_ENTER_CYCLE_SCOPE_AVERAGE();
+  SOS_PROBE_ENTER(switch_contexts);
   asm volatile("MRS %0, psp\n\t" : "=r"(sos_task_table[m_task_current].sp));
 
+#if CONFIG_SCHED_IS_TICKLESS
+  credit_tickless_time();
+#endif
+
   if (SCB->SHCSR & (1 << 15)) {
     /*
      * This means the SVCall instruction happened at
@@ -345,58 +393,41 @@ void switch_contexts() {
     SCB->SHCSR &= ~(1 << 15);
   }
 
-#if __FPU_USED == 1
-  volatile void *fpu_stack;
-  if (m_task_current != 0) {
-    // only do this if the task has used the FPU -- copy FPU registers to task table
-    fpu_stack = sos_task_table[m_task_current].fp + 32;
-    asm volatile("VMRS %0, fpscr\n\t" : "=r"(sos_task_table[m_task_current].fpscr));
-    asm volatile("mov r1, %0\n\t" : : "r"(fpu_stack));
-    asm volatile("vstmdb r1!, {s0-s31}\n\t");
-  }
-#endif
-
-  do {
-    m_task_current++;
-    if (m_task_current == task_get_total()) {
-      // The scheduler only uses OS mem -- disable the process MPU regions
-      m_task_current = 0;
-      if (sos_task_table[0].rr_time < SYSTICK_MIN_CYCLES) {
-        sos_task_table[0].rr_time = m_task_rr_reload;
-        sos_task_table[0].timer.t += (m_task_rr_reload);
-      }
+  // the ready lists can be changed by higher priority interrupts -- issue #130
+  cortexm_disable_interrupts();
+  const int previous = m_task_current;
+  m_task_current = get_next_task();
+  SCHEDULER_TRACE_SWITCH(previous, m_task_current);
+  if (m_task_current == 0) {
+    // The scheduler only uses OS mem -- disable the process MPU regions
+    if (sos_task_table[0].rr_time < SYSTICK_MIN_CYCLES) {
+      sos_task_table[0].rr_time = m_task_rr_reload;
+      sos_task_table[0].timer.t += (m_task_rr_reload);
+    }
 
-      // see if all tasks have used up their RR time
-      int i;
-      for (i = 1; i < task_get_total(); i++) {
-        if (task_exec_asserted(i) && (sos_task_table[i].rr_time >= SYSTICK_MIN_CYCLES)) {
+    // see if all tasks have used up their RR time
+    const int first = task_get_ready_first(task_get_current_priority());
+    int i = first;
+    if (i > 0) {
+      do {
+        if (sos_task_table[i].rr_time >= SYSTICK_MIN_CYCLES) {
           break;
         }
-      }
+        i = task_get_ready_next(i);
+      } while (i != first);
 
       // if all executing tasks have used up their RR time -- reload the RR time for
       // executing tasks
-      if (i == task_get_total()) {
-        for (i = 1; i < task_get_total(); i++) {
-          if (task_exec_asserted(i)) {
-            sos_task_table[i].timer.t += (m_task_rr_reload - sos_task_table[i].rr_time);
-            sos_task_table[i].rr_time = m_task_rr_reload;
-          }
-        }
-      }
-
-      break;
-    } else if (task_exec_asserted(m_task_current)) {
-      if (
-        (sos_task_table[m_task_current].rr_time >= SYSTICK_MIN_CYCLES)
-        ||                                    // is there time remaining on the RR
-        task_fifo_asserted(m_task_current)) { // is this a FIFO task
-        // check to see if task is low on memory -- kill if necessary?
-
-        break;
+      if (sos_task_table[i].rr_time < SYSTICK_MIN_CYCLES) {
+        do {
+          sos_task_table[i].timer.t += (m_task_rr_reload - sos_task_table[i].rr_time);
+          sos_task_table[i].rr_time = m_task_rr_reload;
+          i = task_get_ready_next(i);
+        } while (i != first);
       }
     }
-  } while (1);
+  }
+  cortexm_enable_interrupts();
 
   // Enable the MPU for the task stack guard
 #if MPU_PRESENT || __MPU_PRESENT
@@ -416,50 +447,175 @@ void switch_contexts() {
   } else {
     mpu_enable();
   }
-  SOS_DEBUG_EXIT_CYCLE_SCOPE_AVERAGE(SOS_DEBUG_TASK, switch_contexts, 5000);
 
 #endif
 
   _impure_ptr = sos_task_table[m_task_current].reent;
   _global_impure_ptr = sos_task_table[m_task_current].global_reent;
 
-  if (task_fifo_asserted(m_task_current)) {
-    // disable the systick interrupt (because this is a fifo task)
+  update_round_robin_tick();
+
+#if __FPU_USED == 1
+  // the FPU registers are switched by task_root_claim_fpu() when the task uses them
+  update_fpu_access();
+#endif
+
+  if (task_yield_asserted(task_get_current())) {
+    // this means the SYSTICK excepted at the same time as the SVC instruction
+    SCB->SHCSR |= (1 << 15);
+    task_deassert_yield(task_get_current());
+  }
+
+  SOS_PROBE_EXIT(switch_contexts);
+
+  // write the new task's stack pointer to the PSP
+  asm volatile("MSR psp, %0\n\t" : : "r"(sos_task_table[m_task_current].sp));
+}
+
+#if __FPU_USED == 1
+void save_fpu(int id) {
+  asm volatile("VMRS %0, fpscr\n\t" : "=r"(sos_task_table[id].fpscr));
+  asm volatile("vstmia %0, {s0-s31}\n\t" : : "r"(sos_task_table[id].fp) : "memory");
+}
+
+void load_fpu(int id) {
+  asm volatile("VMSR fpscr, %0\n\t" : : "r"(sos_task_table[id].fpscr));
+  asm volatile("vldmia %0, {s0-s31}\n\t" : : "r"(sos_task_table[id].fp) : "memory");
+}
+
+void update_fpu_access() {
+  // tasks that don't own the registers take a usage fault (NOCP) on their first
+  // FPU instruction -- the exception return synchronizes the CPACR write
+  if (m_task_current == m_task_fpu_owner) {
+    SCB->CPACR |= FPU_CPACR_ACCESS;
+  } else {
+    SCB->CPACR &= ~FPU_CPACR_ACCESS;
+  }
+}
+
+int task_root_claim_fpu() {
+  if ((SCB->CPACR & FPU_CPACR_ACCESS) == FPU_CPACR_ACCESS) {
+    // the FPU is already on so the fault wasn't caused by switching
+    return -1;
+  }
+
+  SCB->CPACR |= FPU_CPACR_ACCESS;
+  asm volatile("DSB\n\tISB\n\t");
+
+  const int owner = m_task_fpu_owner;
+  if (owner != m_task_current) {
+    if (owner >= 0) {
+      save_fpu(owner);
+    }
+    load_fpu(m_task_current);
+    m_task_fpu_owner = m_task_current;
+  }
+  return 0;
+}
+#endif
+
+int is_round_robin_tick_needed() {
+#if CONFIG_SCHED_IS_TICKLESS
+  if (m_task_current == 0) {
+    // the scheduler idles when nothing is ready -- anything that makes a task
+    // ready pends a context switch so the tick isn't needed to leave idle
+    return task_get_exec_count() != 0;
+  }
+  // a task that is alone at its priority has nothing to share time with
+  return task_get_exec_count() > 1;
+#else
+  return 1;
+#endif
+}
+
+#if CONFIG_SCHED_IS_TICKLESS
+u64 get_tickless_cycles() {
+  // the SysTick keeps counting with its interrupt off but its wraps aren't
+  // counted -- the usecond clock measures the time instead
+  struct mcu_timeval now;
+  scheduler_timing_root_get_timestamp(&now);
+  const u64 now_usec = scheduler_timing_real64usec(&now);
+  const u64 start_usec = scheduler_timing_real64usec(&m_task_tickless_start);
+  if (now_usec <= start_usec) {
+    return 0;
+  }
+  // split at the second so long stretches don't overflow
+  const u64 elapsed = now_usec - start_usec;
+  const u64 frequency = sos_config.sys.core_clock_frequency;
+  return (elapsed / 1000000ULL) * frequency + (elapsed % 1000000ULL) * frequency / 1000000ULL;
+}
+
+void credit_tickless_time() {
+  // add the time the current task ran with the tick off to its CPU time
+  if (m_task_is_tick_enabled == 0) {
+    sos_task_table[m_task_current].timer.t += get_tickless_cycles();
+    scheduler_timing_root_get_timestamp(&m_task_tickless_start);
+  }
+}
+#endif
+
+void update_round_robin_tick() {
+  if (task_fifo_asserted(m_task_current) || !is_round_robin_tick_needed()) {
+    // disable the systick interrupt (fifo task or no round robin needed)
     cortexm_disable_systick_irq();
+#if CONFIG_SCHED_IS_TICKLESS
+    if (m_task_is_tick_enabled) {
+      scheduler_timing_root_get_timestamp(&m_task_tickless_start);
+    }
+#endif
+    m_task_is_tick_enabled = 0;
   } else {
+#if CONFIG_SCHED_IS_TICKLESS
+    credit_tickless_time();
+#endif
     // init sys tick to the amount of time remaining
     SysTick->LOAD = sos_task_table[m_task_current]
                       .rr_time; // cppcheck-suppress[ConfigurationNotChecked]
     SysTick->VAL = 0; // cppcheck-suppress[ConfigurationNotChecked] force a reload
     // enable the systick interrupt
     cortexm_enable_systick_irq();
+    m_task_is_tick_enabled = 1;
   }
+}
 
-#if __FPU_USED == 1
-  // only do this if the task has used the FPU
-  // task_load_fpu();
-  if (m_task_current != 0) {
-    fpu_stack = sos_task_table[m_task_current].fp;
-    asm volatile("VMSR fpscr, %0\n\t" : : "r"(sos_task_table[m_task_current].fpscr));
-    asm volatile("mov r1, %0\n\t" : : "r"(fpu_stack));
-    asm volatile("vldm r1!, {s0-s31}\n\t");
+int get_next_task() {
+  // executing tasks are the ready tasks at the current priority -- they run in list
+  // order and the scheduler (task 0) runs each time the list wraps
+  const int first = task_get_ready_first(task_get_current_priority());
+  if (first < 0) {
+    return 0;
   }
-#endif
 
-  if (task_yield_asserted(task_get_current())) {
-    // this means the SYSTICK excepted at the same time as the SVC instruction
-    SCB->SHCSR |= (1 << 15);
-    task_deassert_yield(task_get_current());
+  int id = first;
+  if (m_task_current != 0 && task_exec_asserted(m_task_current)) {
+    id = task_get_ready_next(m_task_current);
+    if (id == first) {
+      return 0;
+    }
   }
 
-  // write the new task's stack pointer to the PSP
-  asm volatile("MSR psp, %0\n\t" : : "r"(sos_task_table[m_task_current].sp));
+  do {
+    if (
+      (sos_task_table[id].rr_time >= SYSTICK_MIN_CYCLES) || // is there time remaining on
+                                                            // the RR
+      task_fifo_asserted(id)) {                             // is this a FIFO task
+      // check to see if task is low on memory -- kill if necessary?
+      return id;
+    }
+    id = task_get_ready_next(id);
+  } while (id != first);
+
+  return 0;
 }
 
 void task_root_switch_context() {
 
-  // cppcheck-suppress[ConfigurationNotChecked] save the RR time from the SYSTICK
-  sos_task_table[task_get_current()].rr_time = SysTick->VAL;
+  // with the tick off (tickless) the RR time doesn't change -- credit_tickless_time()
+  // counts the time instead
+  if (!CONFIG_SCHED_IS_TICKLESS || m_task_is_tick_enabled) {
+    // cppcheck-suppress[ConfigurationNotChecked] save the RR time from the SYSTICK
+    sos_task_table[task_get_current()].rr_time = SysTick->VAL;
+  }
 
   // set the pend SV interrupt pending -- causes cortexm_pendsv_handler() to execute when
   // current interrupt exits
@@ -469,11 +625,29 @@ void task_root_switch_context() {
 void task_check_count_flag() {
   // check the countflag
   if (SysTick->CTRL & (1 << 16)) { // cppcheck-suppress[ConfigurationNotChecked]
+    m_task_tick_count++;
     sos_task_table[m_task_current].rr_time = 0;
     switch_contexts();
   }
 }
 
+void task_check_round_robin_tick() {
+#if CONFIG_SCHED_IS_TICKLESS
+  // a task joined (or left) the current priority -- start (or stop) round robin
+  // (SysTick->CTRL isn't read here because that clears the countflag)
+  if (
+    !task_fifo_asserted(m_task_current)
+    && (m_task_is_tick_enabled != is_round_robin_tick_needed())) {
+    if (m_task_is_tick_enabled) {
+      // keep what is left of the slice -- it resumes when the tick is restored
+      sos_task_table[m_task_current].rr_time =
+        SysTick->VAL; // cppcheck-suppress[ConfigurationNotChecked]
+    }
+    update_round_robin_tick();
+  }
+#endif
+}
+
 void cortexm_systick_handler() MCU_WEAK;
 void cortexm_systick_handler() {
   task_save_context();
@@ -487,31 +661,6 @@ void cortexm_pendsv_handler() MCU_WEAK;
 void cortexm_pendsv_handler() {
   task_save_context();
 
-  // disable interrupts -- Re-entrant scheduler issue #130
-  m_task_exec_count = 0;
-  SOS_DEBUG_ENTER_CYCLE_SCOPE_AVERAGE();
-  cortexm_disable_interrupts();
-  int i;
-  for (i = 1; i < task_get_total(); i++) {
-
-    if (
-      task_enabled_active_not_stopped(i) && // enabled, active, and not stopped
-      (task_get_priority(i)
-       == task_get_current_priority())) { // task is equal to the currently executing
-                                          // priority
-      // Enable process execution for highest active priority tasks
-      task_assert_exec(i);
-      m_task_exec_count++;
-    } else {
-      // Disable process execution for lower priority tasks
-      task_deassert_exec(i);
-    }
-  }
-
-  // enable interrupts -- Re-entrant scheduler issue
-  cortexm_enable_interrupts();
-  SOS_DEBUG_EXIT_CYCLE_SCOPE_AVERAGE(SOS_DEBUG_TASK, pend_critical, 1000);
-
   // switch contexts if current task is not executing or it wants to yield
   if (
     (task_get_current()) == 0 || // always switch away from task zero if requested
@@ -521,6 +670,8 @@ void cortexm_pendsv_handler() {
       task_get_current())) { // checks if current task requested a context switch
     task_deassert_yield(task_get_current());
     switch_contexts();
+  } else {
+    task_check_round_robin_tick();
   }
 
   task_load_context();
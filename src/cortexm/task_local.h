@@ -70,6 +70,11 @@ typedef struct {
 
 void task_svcall_new_task(new_task_t *task) MCU_ROOT_CODE;
 
+#if __FPU_USED == 1
+// Loads the current task's FPU registers after a NOCP usage fault (0 if claimed)
+int task_root_claim_fpu() MCU_ROOT_EXEC_CODE;
+#endif
+
 static inline void task_save_context() MCU_ALWAYS_INLINE;
 void task_save_context() {
   asm volatile(
@@ -0,0 +1,126 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "config.h"
+
+#include "cortexm/task.h"
+#include "task_local.h"
+
+// Tasks that are used, active and not stopped are kept in a circular list for
+// their priority. Bit p of the bitmap is set when list p is not empty so the
+// highest ready priority is found with CLZ rather than by scanning the task
+// table. Task 0 (the scheduler) is never in a list.
+
+#if CONFIG_SCHED_HIGHEST_PRIORITY > 31
+#error "The ready bitmap requires CONFIG_SCHED_HIGHEST_PRIORITY to be 31 or less"
+#endif
+
+#define PRIORITY_TOTAL (CONFIG_SCHED_HIGHEST_PRIORITY + 1)
+
+typedef struct {
+  u32 bitmap;
+  u8 head[PRIORITY_TOTAL];
+  u8 count[PRIORITY_TOTAL];
+  u8 next[CONFIG_TASK_TOTAL];
+  u8 prev[CONFIG_TASK_TOTAL];
+  u8 list[CONFIG_TASK_TOTAL] /*! Priority + 1 of the list holding the task (0 if not ready) */;
+} task_ready_t;
+
+static volatile task_ready_t m_task_ready MCU_SYS_MEM;
+
+static int is_priority_valid(int priority) {
+  return (priority >= 0) && (priority < PRIORITY_TOTAL);
+}
+
+static void remove_task(int id) {
+  const int priority = m_task_ready.list[id] - 1;
+  m_task_ready.list[id] = 0;
+  if (--m_task_ready.count[priority] == 0) {
+    m_task_ready.bitmap &= ~(1 << priority);
+    return;
+  }
+
+  const u8 next = m_task_ready.next[id];
+  const u8 prev = m_task_ready.prev[id];
+  m_task_ready.next[prev] = next;
+  m_task_ready.prev[next] = prev;
+  if (m_task_ready.head[priority] == id) {
+    m_task_ready.head[priority] = next;
+  }
+}
+
+static void append_task(int id, int priority) {
+  m_task_ready.list[id] = priority + 1;
+  if (m_task_ready.count[priority]++ == 0) {
+    m_task_ready.head[priority] = id;
+    m_task_ready.next[id] = id;
+    m_task_ready.prev[id] = id;
+    m_task_ready.bitmap |= (1 << priority);
+    return;
+  }
+
+  // the tail is just before the head
+  const u8 head = m_task_ready.head[priority];
+  const u8 tail = m_task_ready.prev[head];
+  m_task_ready.next[tail] = id;
+  m_task_ready.prev[id] = tail;
+  m_task_ready.next[id] = head;
+  m_task_ready.prev[head] = id;
+}
+
+void task_root_update_ready(int id) {
+  if ((id <= 0) || (id >= task_get_total())) {
+    return;
+  }
+
+  // this is called from interrupts that can preempt each other
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+
+  const int priority = task_get_priority(id);
+  const int list = task_enabled_active_not_stopped(id) && is_priority_valid(priority)
+                     ? priority + 1
+                     : 0;
+
+  if (m_task_ready.list[id] != list) {
+    if (m_task_ready.list[id]) {
+      remove_task(id);
+    }
+    if (list) {
+      append_task(id, priority);
+    }
+  }
+
+  __set_PRIMASK(primask);
+}
+
+int task_get_ready_priority() {
+  const u32 bitmap = m_task_ready.bitmap;
+  if (bitmap == 0) {
+    return -1;
+  }
+  return 31 - __CLZ(bitmap);
+}
+
+int task_get_ready_first(int priority) {
+  if (!is_priority_valid(priority) || (m_task_ready.count[priority] == 0)) {
+    return -1;
+  }
+  return m_task_ready.head[priority];
+}
+
+int task_get_ready_next(int id) { return m_task_ready.next[id]; }
+
+u8 task_get_ready_count(int priority) {
+  if (!is_priority_valid(priority)) {
+    return 0;
+  }
+  return m_task_ready.count[priority];
+}
+
+int task_exec_asserted(int id) {
+  if (id == 0) {
+    // the scheduler runs once per round robin cycle
+    return 1;
+  }
+  return m_task_ready.list[id] == task_get_current_priority() + 1;
+}
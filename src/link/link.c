@@ -45,6 +45,7 @@ int link_disconnect(link_transport_mdriver_t *driver) {
   int ret;
 
   driver->transport_version = 0;
+  link_readdir_cache_free(driver);
   if (driver->phy_driver.handle == LINK_PHY_OPEN_ERROR) {
     return 0;
   }
@@ -72,6 +73,9 @@ int link_connect(link_transport_mdriver_t *driver, const char *sn) {
 
   link_debug(LINK_DEBUG_INFO, "Connect to %s", serialno);
 
+  // the new device may not support the same commands
+  link_readdir_cache_free(driver);
+
   while ((err = driver->getname(name, last, LINK_PHY_NAME_MAX)) == 0) {
     // success in getting new name
     driver->transport_version = 0;
@@ -269,8 +269,10 @@ int link_writeflash(
     LINK_DEBUG_MESSAGE, "Address 0x%x, Page size is %d (%d)", addr, page_size, nbyte);
 
   do {
+    // the last page is padded with 0xFF rather than reading past the end of buf
+    const int remaining = nbyte - bytes_written;
     memset(wattr.buf, 0xFF, BOOTLOADER_WRITEPAGESIZE);
-    memcpy(wattr.buf, buf, page_size);
+    memcpy(wattr.buf, buf, remaining < page_size ? remaining : page_size);
 
     link_transport_mastersettimeout(driver, 5000);
     err = link_ioctl_delay(
@@ -291,3 +293,92 @@ int link_writeflash(
 
   return nbyte;
 }
+
+static int get_page_hash(
+  link_transport_mdriver_t *driver,
+  u32 addr,
+  bootloader_page_hash_t *hash) {
+  return link_ioctl_delay(
+    driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_GET_PAGE_HASH, hash, (int)addr, 0);
+}
+
+static u32 calculate_page_crc32c(const u8 *buf, int nbyte, u32 page_size) {
+  // flash beyond the end of the image is left erased
+  u8 erased[256];
+  memset(erased, 0xff, sizeof(erased));
+  u32 crc = link_transport_crc32c(0, buf, nbyte);
+  for (u32 i = (u32)nbyte; i < page_size; i += sizeof(erased)) {
+    const u32 remaining = page_size - i;
+    crc = link_transport_crc32c(
+      crc, erased, remaining < sizeof(erased) ? (int)remaining : (int)sizeof(erased));
+  }
+  return crc;
+}
+
+int link_writeflash_delta(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte) {
+  bootloader_page_hash_t hash;
+  const u8 *image = buf;
+  int bytes_written = 0;
+  int page_count = 0;
+  int changed_count = 0;
+
+  if (get_page_hash(driver, (u32)addr, &hash) < 0 || hash.addr != (u32)addr) {
+    link_debug(
+      LINK_DEBUG_MESSAGE, "Page hashes not available (%d) -- erase and write all",
+      link_errno);
+    int result = link_eraseflash(driver);
+    if (result < 0) {
+      return result;
+    }
+    return link_writeflash(driver, addr, buf, nbyte);
+  }
+
+  int offset = 0;
+  while (offset < nbyte) {
+    if (offset > 0 && get_page_hash(driver, (u32)(addr + offset), &hash) < 0) {
+      link_error("failed to get hash for 0x%x", addr + offset);
+      return -1;
+    }
+
+    const int remaining = nbyte - offset;
+    const int size = remaining < (int)hash.size ? remaining : (int)hash.size;
+
+    // the first page is always rewritten -- erasing it first leaves an
+    // interrupted update without a valid stack pointer so the device stays
+    // in the bootloader
+    if (
+      offset == 0
+      || calculate_page_crc32c(image + offset, size, hash.size) != hash.crc32c) {
+
+      link_transport_mastersettimeout(driver, 5000);
+      int result = link_ioctl_delay(
+        driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_ERASE_PAGE, NULL, (int)hash.addr, 0);
+      link_transport_mastersettimeout(driver, 0);
+      if (result < 0) {
+        link_error("failed to erase page %d", hash.page);
+        return result;
+      }
+
+      result = link_writeflash(driver, (int)hash.addr, image + offset, size);
+      if (result < 0) {
+        return result;
+      }
+
+      bytes_written += size;
+      changed_count++;
+    }
+
+    page_count++;
+    offset += (int)hash.size;
+  }
+
+  link_debug(
+    LINK_DEBUG_MESSAGE, "Wrote %d of %d pages (%d of %d bytes)", changed_count,
+    page_count, bytes_written, nbyte);
+
+  return bytes_written;
+}
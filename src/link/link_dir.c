@@ -1,6 +1,7 @@
 // Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
 #include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +9,8 @@
 
 #include "link_local.h"
 
+static void remove_readdir_dir(link_transport_mdriver_t *driver, DIR *dirp);
+
 // Access to directories
 int link_mkdir(link_transport_mdriver_t *driver, const char *path, int mode) {
   link_op_t op;
@@ -162,10 +165,187 @@ DIR *link_opendir(link_transport_mdriver_t *driver, const char *dirname) {
     link_debug(LINK_DEBUG_WARNING, "Failed to opendir (%d)", link_errno);
   } else {
     link_debug(LINK_DEBUG_INFO, "new dirp is 0x%X", reply.err);
+    // entries left over from a directory that was never closed
+    remove_readdir_dir(driver, (DIR *)((size_t)reply.err));
   }
   return (DIR *)((size_t)reply.err);
 }
 
+void link_readdir_cache_free(link_transport_mdriver_t *driver) {
+  link_readdir_cache_t *cache = driver->readdir_cache;
+  if (cache != NULL) {
+    link_readdir_dir_t *dir = cache->dirs;
+    while (dir != NULL) {
+      link_readdir_dir_t *next = dir->next;
+      free(dir);
+      dir = next;
+    }
+  }
+  free(cache);
+  driver->readdir_cache = NULL;
+}
+
+static link_readdir_cache_t *get_readdir_cache(link_transport_mdriver_t *driver) {
+  if (driver->readdir_cache == NULL) {
+    driver->readdir_cache = calloc(1, sizeof(link_readdir_cache_t));
+  }
+  return driver->readdir_cache;
+}
+
+static link_readdir_dir_t *get_readdir_dir(link_readdir_cache_t *cache, DIR *dirp) {
+  link_readdir_dir_t *dir;
+  for (dir = cache->dirs; dir != NULL; dir = dir->next) {
+    if (dir->dirp == (u32)(size_t)dirp) {
+      return dir;
+    }
+  }
+
+  // each open directory keeps its own entries so reads can be interleaved
+  dir = calloc(1, sizeof(link_readdir_dir_t));
+  if (dir != NULL) {
+    dir->dirp = (u32)(size_t)dirp;
+    dir->next = cache->dirs;
+    cache->dirs = dir;
+  }
+  return dir;
+}
+
+static void remove_readdir_dir(link_transport_mdriver_t *driver, DIR *dirp) {
+  link_readdir_cache_t *cache = driver->readdir_cache;
+  if (cache == NULL) {
+    return;
+  }
+
+  link_readdir_dir_t **dir = &cache->dirs;
+  while (*dir != NULL) {
+    if ((*dir)->dirp == (u32)(size_t)dirp) {
+      link_readdir_dir_t *next = (*dir)->next;
+      free(*dir);
+      *dir = next;
+      return;
+    }
+    dir = &(*dir)->next;
+  }
+}
+
+static int fetch_readdir_bulk(
+  link_transport_mdriver_t *driver,
+  link_readdir_cache_t *cache,
+  link_readdir_dir_t *dir) {
+  link_op_t op;
+  link_readdir_bulk_reply_t reply;
+  int len;
+
+  op.readdir_bulk.cmd = LINK_CMD_READDIR_BULK;
+  op.readdir_bulk.dirp = dir->dirp;
+  // the device directory position is only moved by this dirp's fetches
+  op.readdir_bulk.loc = -1;
+  op.readdir_bulk.nbyte = sizeof(dir->entries);
+
+  dir->offset = 0;
+  dir->size = 0;
+
+  link_debug(LINK_DEBUG_MESSAGE, "Write op");
+  if (link_transport_masterwrite(driver, &op, sizeof(link_readdir_bulk_t)) < 0) {
+    return -1;
+  }
+
+  // older devices reply to unknown commands with a link_reply_t
+  memset(&reply, 0, sizeof(reply));
+  link_debug(LINK_DEBUG_MESSAGE, "Read reply");
+  len = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (len < 0) {
+    return -1;
+  }
+
+  if (len == sizeof(link_reply_t) && reply.err < 0 && reply.err_number == EINVAL) {
+    link_debug(LINK_DEBUG_INFO, "device does not support bulk readdir");
+    cache->is_unsupported = 1;
+    return 0;
+  }
+
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    link_debug(LINK_DEBUG_WARNING, "Failed to readdir bulk (%d)", link_errno);
+    return reply.err;
+  }
+
+  dir->is_end = reply.is_end != 0;
+  if (reply.err == 0) {
+    return 0;
+  }
+
+  if ((u32)reply.err > sizeof(dir->entries)) {
+    link_error("bulk readdir reply is too large (%d)", reply.err);
+    return -1;
+  }
+
+  link_debug(LINK_DEBUG_MESSAGE, "Read %d entries", reply.count);
+  len = link_transport_masterread(driver, dir->entries, reply.err);
+  if (len < 0) {
+    link_error("Failed to read entries");
+    return -1;
+  }
+
+  dir->size = len;
+  return 0;
+}
+
+static int readdir_cached(
+  link_transport_mdriver_t *driver,
+  link_readdir_cache_t *cache,
+  DIR *dirp,
+  struct dirent *entry) {
+  int result;
+
+  link_readdir_dir_t *dir = get_readdir_dir(cache, dirp);
+  if (dir == NULL) {
+    // fall back to reading one entry at a time
+    return 0;
+  }
+
+  if (dir->offset + sizeof(link_readdir_bulk_entry_t) > dir->size) {
+    if (dir->is_end) {
+      link_errno = ENOENT;
+      return -1;
+    }
+
+    if ((result = fetch_readdir_bulk(driver, cache, dir)) < 0) {
+      return result;
+    }
+
+    if (cache->is_unsupported) {
+      return 0;
+    }
+
+    if (dir->size == 0) {
+      link_errno = ENOENT;
+      return -1;
+    }
+  }
+
+  link_readdir_bulk_entry_t link_entry;
+  memcpy(&link_entry, dir->entries + dir->offset, sizeof(link_entry));
+  dir->offset += sizeof(link_entry);
+
+  u32 name_size = link_entry.d_name_size;
+  if (dir->offset + name_size > dir->size) {
+    link_error("bulk readdir entry is truncated");
+    dir->offset = dir->size;
+    return -1;
+  }
+
+  memset(entry, 0, sizeof(struct dirent));
+  if (name_size > sizeof(entry->d_name) - 1) {
+    name_size = sizeof(entry->d_name) - 1;
+  }
+  memcpy(entry->d_name, dir->entries + dir->offset, name_size);
+  entry->d_ino = link_entry.d_ino;
+  dir->offset += link_entry.d_name_size;
+
+  return 1;
+}
+
 int link_readdir_r(
   link_transport_mdriver_t *driver,
   DIR *dirp,
@@ -191,6 +371,22 @@ int link_readdir_r(
     *result = NULL;
   }
 
+  link_readdir_cache_t *cache = get_readdir_cache(driver);
+  if (cache != NULL && cache->is_unsupported == 0) {
+    // entries are fetched many at a time and handed out one at a time
+    const int cache_result = readdir_cached(driver, cache, dirp, entry);
+    if (cache_result < 0) {
+      return cache_result;
+    }
+
+    if (cache_result > 0) {
+      if (result != NULL) {
+        *result = entry;
+      }
+      return 0;
+    }
+  }
+
   link_debug(
     LINK_DEBUG_INFO, "call with (0x%X, %p) and handle %p", dirp, entry,
     driver->phy_driver.handle);
@@ -250,6 +446,9 @@ int link_closedir(link_transport_mdriver_t *driver, DIR *dirp) {
   link_debug(
     LINK_DEBUG_INFO, "call with (0x%X) and handle %p", dirp, driver->phy_driver.handle);
 
+  // the device may re-use dirp for the next directory
+  remove_readdir_dir(driver, dirp);
+
   op.closedir.cmd = LINK_CMD_CLOSEDIR;
   op.closedir.dirp = (u32)(size_t)dirp;
 
@@ -251,9 +251,10 @@ int link_ioctl_delay(
 
     if (err != rw_size) {
       if (err == sizeof(reply)) {
+        // the device sent the reply in place of the data
+        memcpy(&reply, argp, sizeof(reply));
         link_errno = reply.err_number;
         link_error("failed to read IOR data -- bad size %d", link_errno);
-        memcpy(&reply, argp, sizeof(reply));
         return reply.err;
       }
 
@@ -376,6 +377,219 @@ int link_write(link_transport_mdriver_t *driver, int fildes, const void *buf, in
   return reply.err;
 }
 
+static int emulate_sendfile(
+  link_transport_mdriver_t *driver,
+  const char *path,
+  int flags,
+  int offset,
+  const void *buf,
+  int nbyte) {
+  const int fildes =
+    link_open(driver, path, (flags & ~O_ACCMODE) | O_WRONLY, (link_mode_t)0666);
+  if (fildes < 0) {
+    return fildes;
+  }
+
+  int result = 0;
+  if (offset > 0) {
+    result = link_lseek(driver, fildes, offset, SEEK_SET);
+  }
+
+  if (result >= 0) {
+    result = link_write(driver, fildes, buf, nbyte);
+  }
+
+  const int error_number = link_errno;
+  if (link_close(driver, fildes) < 0 && result >= 0) {
+    return -1;
+  }
+  link_errno = error_number;
+  return result;
+}
+
+static int emulate_recvfile(
+  link_transport_mdriver_t *driver,
+  const char *path,
+  int offset,
+  void *buf,
+  int nbyte) {
+  const int fildes = link_open(driver, path, O_RDONLY);
+  if (fildes < 0) {
+    return fildes;
+  }
+
+  int result = 0;
+  if (offset > 0) {
+    result = link_lseek(driver, fildes, offset, SEEK_SET);
+  }
+
+  if (result >= 0) {
+    result = link_read(driver, fildes, buf, nbyte);
+  }
+
+  const int error_number = link_errno;
+  link_close(driver, fildes);
+  link_errno = error_number;
+  return result;
+}
+
+// returns 1 if the device does not support file streaming
+static int start_file_stream(
+  link_transport_mdriver_t *driver,
+  const link_op_t *op,
+  const char *path,
+  int path_size) {
+  link_reply_t reply;
+  int err = link_transport_masterwrite(driver, op, sizeof(link_sendfile_t));
+  if (err < 0) {
+    link_error("failed to write op");
+    return link_handle_err(driver, err);
+  }
+
+  // the device confirms the command before the path is sent
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (err < 0) {
+    link_error("failed to read the reply");
+    return link_handle_err(driver, err);
+  }
+
+  if (reply.err < 0) {
+    // older devices reply EINVAL to commands they don't know
+    link_debug(LINK_DEBUG_MESSAGE, "file streaming not supported (%d)", reply.err_number);
+    return 1;
+  }
+
+  link_debug(LINK_DEBUG_MESSAGE, "Write path (%d bytes)", path_size);
+  err = link_transport_masterwrite(driver, path, path_size);
+  if (err < 0) {
+    link_error("failed to write path");
+    return link_handle_err(driver, err);
+  }
+  return 0;
+}
+
+static int finish_file_stream(link_transport_mdriver_t *driver, int stream_err) {
+  link_reply_t reply;
+
+  // the device sends the status even if it refused the stream -- give extra
+  // time in case closing the file takes awhile
+  link_transport_mastersettimeout(driver, 5000);
+  int err = link_transport_masterread(driver, &reply, sizeof(reply));
+  link_transport_mastersettimeout(driver, 0);
+  if (err < 0) {
+    link_error("failed to read the reply");
+    return link_handle_err(driver, stream_err < 0 ? stream_err : err);
+  }
+
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    link_debug(LINK_DEBUG_WARNING, "Failed to stream file (%d)", link_errno);
+  }
+  return reply.err;
+}
+
+int link_sendfile(
+  link_transport_mdriver_t *driver,
+  const char *path,
+  int flags,
+  int offset,
+  const void *buf,
+  int nbyte) {
+  link_op_t op;
+
+  if (driver == NULL) {
+    return emulate_sendfile(driver, path, flags, offset, buf, nbyte);
+  }
+
+  const int path_size = (int)strnlen(path, LINK_PATH_MAX) + 1;
+  if (path_size > driver->path_max) {
+    link_error("name too long %d > %d", path_size, driver->path_max);
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  op.sendfile.cmd = LINK_CMD_SENDFILE;
+  op.sendfile.path_size = (u16)path_size;
+  op.sendfile.flags = (u16)convert_flags(flags & ~O_ACCMODE);
+  op.sendfile.offset = offset;
+  op.sendfile.nbyte = (u32)nbyte;
+
+  link_debug(
+    LINK_DEBUG_INFO, "call with (%s, 0x%X, %d, %p, %d) and handle %p", path, flags,
+    offset, buf, nbyte, driver->phy_driver.handle);
+
+  int err = start_file_stream(driver, &op, path, path_size);
+  if (err < 0) {
+    return err;
+  }
+
+  if (err > 0) {
+    return emulate_sendfile(driver, path, flags, offset, buf, nbyte);
+  }
+
+  // the whole buffer goes out as one stream of packets
+  link_debug(LINK_DEBUG_MESSAGE, "Write data");
+  err = link_transport_masterwrite(driver, buf, nbyte);
+  if (err < 0) {
+    link_error("failed to write data");
+    if (err == LINK_PHY_ERROR || err == LINK_TIMEOUT_ERROR) {
+      return link_handle_err(driver, err);
+    }
+    // the device refused a packet -- the reply has the reason
+  }
+
+  return finish_file_stream(driver, err);
+}
+
+int link_recvfile(
+  link_transport_mdriver_t *driver,
+  const char *path,
+  int offset,
+  void *buf,
+  int nbyte) {
+  link_op_t op;
+
+  if (driver == NULL) {
+    return emulate_recvfile(driver, path, offset, buf, nbyte);
+  }
+
+  const int path_size = (int)strnlen(path, LINK_PATH_MAX) + 1;
+  if (path_size > driver->path_max) {
+    link_error("name too long %d > %d", path_size, driver->path_max);
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  op.recvfile.cmd = LINK_CMD_RECVFILE;
+  op.recvfile.path_size = (u16)path_size;
+  op.recvfile.resd = 0;
+  op.recvfile.offset = offset;
+  op.recvfile.nbyte = (u32)nbyte;
+
+  link_debug(
+    LINK_DEBUG_INFO, "call with (%s, %d, %p, %d) and handle %p", path, offset, buf,
+    nbyte, driver->phy_driver.handle);
+
+  int err = start_file_stream(driver, &op, path, path_size);
+  if (err < 0) {
+    return err;
+  }
+
+  if (err > 0) {
+    return emulate_recvfile(driver, path, offset, buf, nbyte);
+  }
+
+  // a short packet ends the stream at the end of the file
+  link_debug(LINK_DEBUG_MESSAGE, "Read data");
+  err = link_transport_masterread(driver, buf, nbyte);
+  if (err < 0) {
+    link_error("failed to read data");
+    return link_handle_err(driver, err);
+  }
+
+  return finish_file_stream(driver, err);
+}
+
 int link_close(link_transport_mdriver_t *driver, int fildes) {
   if (driver == NULL) {
     link_debug(LINK_DEBUG_DEBUG, "closing fileno:%d", fildes);
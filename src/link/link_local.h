@@ -19,6 +19,23 @@ extern "C" {
 
 #define LINK_DEVICE_PRESENT_BUT_NOT_BOOTLOADER (-8183650)
 
+// prefetched entries for one open directory
+typedef struct link_readdir_dir {
+  struct link_readdir_dir *next;
+  u32 dirp;
+  u32 offset;
+  u32 size;
+  u8 is_end;
+  u8 entries[LINK_READDIR_BULK_MAX];
+} link_readdir_dir_t;
+
+typedef struct {
+  link_readdir_dir_t *dirs;
+  u8 is_unsupported;
+} link_readdir_cache_t;
+
+void link_readdir_cache_free(link_transport_mdriver_t * driver);
+
 int link_handle_err(link_transport_mdriver_t * driver, int err);
 int link_ioctl_delay(link_transport_mdriver_t * driver, int fildes, int request, void * argp, int arg, int delay);
 
@@ -58,6 +75,12 @@ int link_phy_lock(link_transport_phy_t phy);
 int link_phy_unlock(link_transport_phy_t phy);
 void link_phy_wait(int msec);
 
+#if defined __macosx || defined __linux
+// used by link_mux to wait on the tty rather than in link_phy_read()
+int link_phy_try_read(link_transport_phy_t handle, void * buf, int nbyte);
+int link_phy_get_fd(link_transport_phy_t handle);
+#endif
+
 
 #ifdef __cplusplus
 }
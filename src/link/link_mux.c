@@ -0,0 +1,432 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __macosx || defined __linux
+
+#if defined __macosx
+// ucontext is only declared with _XOPEN_SOURCE on macOS
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "link_local.h"
+#include "sos/link/mux.h"
+
+// how long a device waits on an idle tty before its transport re-checks timeouts
+#define READ_WAIT_MS 10
+
+enum device_state {
+  DEVICE_STATE_IDLE /*! No active request */,
+  DEVICE_STATE_READY /*! Active request can run */,
+  DEVICE_STATE_WAIT /*! Active request is waiting on fd or wake_time */,
+  DEVICE_STATE_DONE /*! Active request has returned */
+};
+
+typedef struct {
+  link_transport_mdriver_t *driver;
+  ucontext_t context;
+  void *stack;
+  int state;
+  int fd;
+  u64 wake_time;
+  link_mux_request_t *active;
+  link_mux_request_t *head;
+  link_mux_request_t *tail;
+} link_mux_device_t;
+
+struct link_mux {
+  ucontext_t loop_context;
+  link_mux_device_t *current;
+  struct pollfd *pollfds;
+  int device_count;
+  int device_max;
+  // each device runs the existing (blocking) link functions on its own stack
+  int stack_size;
+  link_mux_device_t devices[];
+};
+
+// the multiplexer being run on this thread (the phy hooks have no context argument)
+static __thread link_mux_t *m_mux;
+
+static link_mux_device_t *find_device(link_mux_t *mux, link_transport_mdriver_t *driver) {
+  for (int i = 0; i < mux->device_count; i++) {
+    if (mux->devices[i].driver == driver) {
+      return mux->devices + i;
+    }
+  }
+  return NULL;
+}
+
+static void device_yield(link_mux_device_t *device, int fd, int timeout_ms) {
+  device->fd = fd;
+  device->wake_time = link_transport_gettime() + (u64)timeout_ms * 1000UL;
+  device->state = DEVICE_STATE_WAIT;
+  swapcontext(&device->context, &m_mux->loop_context);
+}
+
+static int mux_phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
+  if (m_mux == NULL || m_mux->current == NULL) {
+    // called outside of link_mux_run()
+    return link_phy_read(handle, buf, nbyte);
+  }
+
+  const int result = link_phy_try_read(handle, buf, nbyte);
+  if (result != 0) {
+    return result;
+  }
+
+  // let other devices run until this tty has data
+  device_yield(m_mux->current, link_phy_get_fd(handle), READ_WAIT_MS);
+  return link_phy_try_read(handle, buf, nbyte);
+}
+
+static void mux_phy_wait(int msec) {
+  if (m_mux == NULL || m_mux->current == NULL) {
+    link_phy_wait(msec);
+    return;
+  }
+  device_yield(m_mux->current, -1, msec);
+}
+
+static void device_entry() {
+  link_mux_device_t *device = m_mux->current;
+  while (1) {
+    link_mux_request_t *request = device->active;
+    link_errno = 0;
+    request->result = request->function(device->driver, request);
+    request->error_number = link_errno;
+    device->state = DEVICE_STATE_DONE;
+    swapcontext(&device->context, &m_mux->loop_context);
+  }
+}
+
+static int device_start(link_mux_t *mux, link_mux_device_t *device) {
+  device->active = device->head;
+  device->head = device->head->next;
+  if (device->head == NULL) {
+    device->tail = NULL;
+  }
+  device->active->next = NULL;
+  device->state = DEVICE_STATE_READY;
+
+  if (device->stack == NULL) {
+    device->stack = malloc((size_t)mux->stack_size);
+    if (device->stack == NULL) {
+      return -1;
+    }
+    getcontext(&device->context);
+    device->context.uc_stack.ss_sp = device->stack;
+    device->context.uc_stack.ss_size = (size_t)mux->stack_size;
+    device->context.uc_link = &mux->loop_context;
+    makecontext(&device->context, device_entry, 0);
+  }
+  return 0;
+}
+
+static void device_resume(link_mux_t *mux, link_mux_device_t *device) {
+  mux->current = device;
+  swapcontext(&mux->loop_context, &device->context);
+  mux->current = NULL;
+
+  if (device->state == DEVICE_STATE_DONE) {
+    link_mux_request_t *request = device->active;
+    device->active = NULL;
+    device->state = DEVICE_STATE_IDLE;
+    if (request->callback) {
+      request->callback(request->context, request);
+    }
+  }
+}
+
+link_mux_t *link_mux_create(int device_max, int stack_size) {
+  if (stack_size == 0) {
+    stack_size = LINK_MUX_DEFAULT_STACK_SIZE;
+  }
+
+  if (device_max <= 0 || stack_size < LINK_MUX_MIN_STACK_SIZE) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  link_mux_t *mux =
+    calloc(1, sizeof(link_mux_t) + sizeof(link_mux_device_t) * (size_t)device_max);
+  if (mux == NULL) {
+    return NULL;
+  }
+
+  mux->pollfds = calloc((size_t)device_max, sizeof(struct pollfd));
+  if (mux->pollfds == NULL) {
+    free(mux);
+    return NULL;
+  }
+
+  mux->device_max = device_max;
+  mux->stack_size = stack_size;
+  return mux;
+}
+
+int link_mux_destroy(link_mux_t *mux) {
+  if (mux == NULL) {
+    return 0;
+  }
+
+  for (int i = 0; i < mux->device_count; i++) {
+    const link_mux_device_t *device = mux->devices + i;
+    if (device->head || device->active) {
+      // an active request is suspended on the device stack
+      errno = EBUSY;
+      return -1;
+    }
+  }
+
+  for (int i = 0; i < mux->device_count; i++) {
+    link_mux_device_t *device = mux->devices + i;
+    device->driver->phy_driver.read = link_phy_read;
+    device->driver->phy_driver.wait = link_phy_wait;
+    free(device->stack);
+  }
+
+  free(mux->pollfds);
+  free(mux);
+  return 0;
+}
+
+int link_mux_add(link_mux_t *mux, link_transport_mdriver_t *driver) {
+  if (mux->device_count == mux->device_max) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  if (driver->phy_driver.read != link_phy_read) {
+    // the fd is needed to wait on the device
+    link_error("link mux requires the default phy driver");
+    errno = EINVAL;
+    return -1;
+  }
+
+  link_mux_device_t *device = mux->devices + mux->device_count;
+  memset(device, 0, sizeof(link_mux_device_t));
+  device->driver = driver;
+  device->fd = -1;
+  device->state = DEVICE_STATE_IDLE;
+
+  driver->phy_driver.read = mux_phy_read;
+  driver->phy_driver.wait = mux_phy_wait;
+
+  return mux->device_count++;
+}
+
+int link_mux_submit(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request) {
+  link_mux_device_t *device = find_device(mux, driver);
+  if (device == NULL || request->function == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  request->next = NULL;
+  request->result = 0;
+  request->error_number = 0;
+  if (device->tail) {
+    device->tail->next = request;
+  } else {
+    device->head = request;
+  }
+  device->tail = request;
+  return 0;
+}
+
+int link_mux_run(link_mux_t *mux, int timeout_ms) {
+  m_mux = mux;
+
+  // run every device that can make progress until it blocks
+  for (int i = 0; i < mux->device_count; i++) {
+    link_mux_device_t *device = mux->devices + i;
+    if (device->state == DEVICE_STATE_IDLE && device->head) {
+      if (device_start(mux, device) < 0) {
+        link_error("failed to allocate device stack");
+        continue;
+      }
+    }
+    if (device->state == DEVICE_STATE_READY) {
+      device_resume(mux, device);
+    }
+  }
+
+  // wait for any blocked device to have data or reach its wake time
+  int pending = 0;
+  int ready = 0;
+  int pollfd_count = 0;
+  u64 now = link_transport_gettime();
+  int wait_ms = timeout_ms;
+  for (int i = 0; i < mux->device_count; i++) {
+    link_mux_device_t *device = mux->devices + i;
+    if (device->head || device->active) {
+      pending++;
+    }
+
+    if (device->state == DEVICE_STATE_IDLE && device->head) {
+      // a callback submitted another request
+      ready++;
+    } else if (device->state == DEVICE_STATE_WAIT) {
+      const int device_wait_ms =
+        device->wake_time > now ? (int)((device->wake_time - now + 999) / 1000) : 0;
+      if (device_wait_ms < wait_ms) {
+        wait_ms = device_wait_ms;
+      }
+      if (device->fd >= 0) {
+        mux->pollfds[pollfd_count].fd = device->fd;
+        mux->pollfds[pollfd_count].events = POLLIN;
+        mux->pollfds[pollfd_count].revents = 0;
+        pollfd_count++;
+      }
+    }
+  }
+
+  if (pending == 0) {
+    m_mux = NULL;
+    return 0;
+  }
+
+  if (ready) {
+    wait_ms = 0;
+  }
+
+  if (poll(mux->pollfds, (nfds_t)pollfd_count, wait_ms) < 0 && errno != EINTR) {
+    link_error("poll failed (%d)", errno);
+  }
+
+  now = link_transport_gettime();
+  for (int i = 0; i < mux->device_count; i++) {
+    link_mux_device_t *device = mux->devices + i;
+    if (device->state != DEVICE_STATE_WAIT) {
+      continue;
+    }
+
+    if (device->wake_time <= now) {
+      device->state = DEVICE_STATE_READY;
+      continue;
+    }
+
+    for (int j = 0; j < pollfd_count; j++) {
+      if (mux->pollfds[j].fd == device->fd && mux->pollfds[j].revents) {
+        device->state = DEVICE_STATE_READY;
+        break;
+      }
+    }
+  }
+
+  m_mux = NULL;
+  return pending;
+}
+
+static int run_connect(link_transport_mdriver_t *driver, link_mux_request_t *request) {
+  return link_connect(driver, request->path);
+}
+
+static int run_open(link_transport_mdriver_t *driver, link_mux_request_t *request) {
+  return link_open(driver, request->path, request->flags, request->mode);
+}
+
+static int run_close(link_transport_mdriver_t *driver, link_mux_request_t *request) {
+  return link_close(driver, request->fildes);
+}
+
+static int run_read(link_transport_mdriver_t *driver, link_mux_request_t *request) {
+  return link_read(driver, request->fildes, request->buf, request->nbyte);
+}
+
+static int run_write(link_transport_mdriver_t *driver, link_mux_request_t *request) {
+  return link_write(driver, request->fildes, request->buf, request->nbyte);
+}
+
+static int run_ioctl(link_transport_mdriver_t *driver, link_mux_request_t *request) {
+  return link_ioctl_delay(
+    driver, request->fildes, request->flags, request->buf, request->nbyte, 0);
+}
+
+int link_mux_connect(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  const char *sn) {
+  request->function = run_connect;
+  request->path = sn;
+  return link_mux_submit(mux, driver, request);
+}
+
+int link_mux_open(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  const char *path,
+  int flags,
+  int mode) {
+  request->function = run_open;
+  request->path = path;
+  request->flags = flags;
+  request->mode = mode;
+  return link_mux_submit(mux, driver, request);
+}
+
+int link_mux_close(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes) {
+  request->function = run_close;
+  request->fildes = fildes;
+  return link_mux_submit(mux, driver, request);
+}
+
+int link_mux_read(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes,
+  void *buf,
+  int nbyte) {
+  request->function = run_read;
+  request->fildes = fildes;
+  request->buf = buf;
+  request->nbyte = nbyte;
+  return link_mux_submit(mux, driver, request);
+}
+
+int link_mux_write(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes,
+  const void *buf,
+  int nbyte) {
+  request->function = run_write;
+  request->fildes = fildes;
+  request->buf = (void *)buf;
+  request->nbyte = nbyte;
+  return link_mux_submit(mux, driver, request);
+}
+
+int link_mux_ioctl(
+  link_mux_t *mux,
+  link_transport_mdriver_t *driver,
+  link_mux_request_t *request,
+  int fildes,
+  int ioctl_request,
+  void *argp,
+  int arg) {
+  request->function = run_ioctl;
+  request->fildes = fildes;
+  request->flags = ioctl_request;
+  request->buf = argp;
+  request->nbyte = arg;
+  return link_mux_submit(mux, driver, request);
+}
+
+#endif
@@ -286,6 +286,7 @@ void link_phy_flush(link_transport_phy_t handle) {
 
 #if defined __macosx || defined __linux
 #include <dirent.h>
+#include <poll.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -293,11 +294,57 @@ void link_phy_flush(link_transport_phy_t handle) {
 
 #define BAUDRATE 460800
 
+// how long link_phy_read() blocks waiting for data before returning 0
+#define READ_POLL_TIMEOUT_MS 10
+#define READ_BUFFER_SIZE 4096
+
 typedef struct {
   int fd;
   char device_path[MAX_DEVICE_PATH];
+  // bytes read from fd but not yet consumed by the transport
+  int head;
+  int tail;
+  u8 buffer[READ_BUFFER_SIZE];
 } link_phy_container_t;
 
+static int fill_buffer(link_phy_container_t *phy, int timeout_ms) {
+  struct pollfd pfd = {.fd = phy->fd, .events = POLLIN};
+  const int poll_result = poll(&pfd, 1, timeout_ms);
+  if (poll_result < 0) {
+    return errno == EINTR ? 0 : LINK_PHY_ERROR;
+  }
+
+  if (poll_result == 0) {
+    // the device may have been unplugged while nothing was arriving
+    if (link_phy_status(phy) < 0) {
+      return LINK_PHY_ERROR;
+    }
+    return 0;
+  }
+
+  if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    return LINK_PHY_ERROR;
+  }
+
+  // called only when the buffer is empty
+  const int tmp = errno;
+  const int ret = read(phy->fd, phy->buffer, READ_BUFFER_SIZE);
+  if (ret < 0) {
+    if (errno == EAGAIN) {
+      errno = tmp;
+      return 0;
+    }
+    return LINK_PHY_ERROR;
+  }
+
+  phy->head = 0;
+  phy->tail = ret;
+  if (ret != 0) {
+    link_debug(LINK_DEBUG_DEBUG, "Rx'd %d bytes", ret);
+  }
+  return ret;
+}
+
 // This is the mac osx prefix -- this needs to be in a list so it can also check bluetooth
 #ifdef __macosx
 #define TTY_DEV_PREFIX "tty.usbmodem"
@@ -470,6 +517,8 @@ link_transport_phy_t link_phy_open(const char *name, const void *s_options) {
   }
 
   container->fd = fd;
+  container->head = 0;
+  container->tail = 0;
   strncpy(container->device_path, name, MAX_DEVICE_PATH);
 
   link_phy_flush(phy);
@@ -538,37 +587,41 @@ int link_phy_write(link_transport_phy_t handle, const void *buf, int nbyte) {
   return nbyte;
 }
 
-int link_phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
-  int ret;
-  int tmp;
-  link_phy_container_t *phy = handle;
-
-  if (handle == LINK_PHY_OPEN_ERROR) {
-    return LINK_PHY_ERROR;
-  }
-
-  tmp = errno;
-
-  if (link_phy_status(handle) < 0) {
+static int read_buffer(link_phy_container_t *phy, void *buf, int nbyte, int timeout_ms) {
+  if (phy == LINK_PHY_OPEN_ERROR) {
     return LINK_PHY_ERROR;
   }
 
-  ret = read(phy->fd, buf, nbyte);
-  if (ret < 0) {
-    if (errno == EAGAIN) {
-      errno = tmp;
-      link_phy_wait(1);
-      return 0;
+  if (phy->head == phy->tail) {
+    // block until data arrives rather than spinning on an empty tty
+    const int result = fill_buffer(phy, timeout_ms);
+    if (result <= 0) {
+      return result;
     }
-    return LINK_PHY_ERROR;
   }
 
-  if (ret != 0) {
-    link_debug(LINK_DEBUG_DEBUG, "Rx'd %d bytes", ret);
-  } else {
-    link_phy_wait(1);
+  // the transport reads small pieces (often 1 byte) -- serve them from memory
+  const int available = phy->tail - phy->head;
+  const int bytes_read = nbyte < available ? nbyte : available;
+  memcpy(buf, phy->buffer + phy->head, bytes_read);
+  phy->head += bytes_read;
+  return bytes_read;
+}
+
+int link_phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
+  return read_buffer(handle, buf, nbyte, READ_POLL_TIMEOUT_MS);
+}
+
+int link_phy_try_read(link_transport_phy_t handle, void *buf, int nbyte) {
+  return read_buffer(handle, buf, nbyte, 0);
+}
+
+int link_phy_get_fd(link_transport_phy_t handle) {
+  link_phy_container_t *phy = handle;
+  if (handle == LINK_PHY_OPEN_ERROR) {
+    return -1;
   }
-  return ret;
+  return phy->fd;
 }
 
 int link_phy_close(link_transport_phy_t *handle) {
@@ -590,9 +643,15 @@ int link_phy_close(link_transport_phy_t *handle) {
 void link_phy_wait(int msec) { usleep(msec * 1000); }
 
 void link_phy_flush(link_transport_phy_t handle) {
-  unsigned char c;
-  while (link_phy_read(handle, &c, 1) == 1) {
-    ;
+  link_phy_container_t *phy = handle;
+  if (handle == LINK_PHY_OPEN_ERROR) {
+    return;
+  }
+
+  // discard buffered bytes and anything already waiting on the tty
+  phy->head = phy->tail = 0;
+  while (fill_buffer(phy, 0) > 0) {
+    phy->head = phy->tail = 0;
   }
 }
 
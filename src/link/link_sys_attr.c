@@ -55,6 +55,88 @@ int link_get_sys_info(link_transport_mdriver_t *driver, sys_info_t *sys_info) {
   return 0;
 }
 
+int link_get_heap_profile(
+  link_transport_mdriver_t *driver,
+  int pid,
+  sys_heap_profile_t *profile) {
+  int sys_fd;
+  int result;
+
+  sys_fd = link_open(driver, "/dev/sys", LINK_O_RDWR);
+  if (sys_fd < 0) {
+    return -1;
+  }
+
+  memset(profile, 0, sizeof(sys_heap_profile_t));
+  profile->pid = pid;
+  result = link_ioctl(driver, sys_fd, I_SYS_GETHEAPPROFILE, profile);
+  link_close(driver, sys_fd);
+  return result;
+}
+
+int link_get_sched_trace(link_transport_mdriver_t *driver, sys_sched_trace_t *trace) {
+  int sys_fd;
+  int result;
+
+  sys_fd = link_open(driver, "/dev/sys", LINK_O_RDWR);
+  if (sys_fd < 0) {
+    return -1;
+  }
+
+  result = link_ioctl(driver, sys_fd, I_SYS_GETSCHEDTRACE, trace);
+  link_close(driver, sys_fd);
+  return result;
+}
+
+int link_get_sched_stats(
+  link_transport_mdriver_t *driver,
+  int tid,
+  sys_sched_stats_t *stats) {
+  int sys_fd;
+  int result;
+
+  sys_fd = link_open(driver, "/dev/sys", LINK_O_RDWR);
+  if (sys_fd < 0) {
+    return -1;
+  }
+
+  memset(stats, 0, sizeof(sys_sched_stats_t));
+  stats->tid = tid;
+  result = link_ioctl(driver, sys_fd, I_SYS_GETSCHEDSTATS, stats);
+  link_close(driver, sys_fd);
+  return result;
+}
+
+int link_get_probe(link_transport_mdriver_t *driver, int index, sys_probe_t *probe) {
+  int sys_fd;
+  int result;
+
+  sys_fd = link_open(driver, "/dev/sys", LINK_O_RDWR);
+  if (sys_fd < 0) {
+    return -1;
+  }
+
+  memset(probe, 0, sizeof(sys_probe_t));
+  probe->index = index;
+  result = link_ioctl(driver, sys_fd, I_SYS_GETPROBE, probe);
+  link_close(driver, sys_fd);
+  return result;
+}
+
+int link_reset_probes(link_transport_mdriver_t *driver) {
+  int sys_fd;
+  int result;
+
+  sys_fd = link_open(driver, "/dev/sys", LINK_O_RDWR);
+  if (sys_fd < 0) {
+    return -1;
+  }
+
+  result = link_ioctl(driver, sys_fd, I_SYS_RESETPROBES, NULL);
+  link_close(driver, sys_fd);
+  return result;
+}
+
 sys_info_t convert_sys_23_info(const sys_23_info_t *sys_23_info, const sys_id_t *id) {
   sys_info_t sys_info;
   memset(&sys_info, 0, sizeof(sys_info_t));
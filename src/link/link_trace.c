@@ -0,0 +1,316 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <string.h>
+
+#include "link_local.h"
+
+typedef struct {
+  FILE *output;
+  const char *(*resolve)(void *context, u32 address);
+  void *context;
+  int count;
+} json_export_t;
+
+static const char *get_event_name(u8 event_id);
+static int decode_block(
+  link_trace_stream_decoder_t *decoder,
+  const u8 *block,
+  link_trace_stream_callback_t callback,
+  void *context);
+static int write_json_event(void *context, const link_trace_stream_event_t *event);
+
+void link_trace_stream_decoder_init(link_trace_stream_decoder_t *decoder) {
+  memset(decoder, 0, sizeof(link_trace_stream_decoder_t));
+}
+
+static u32 read_u32(const u8 *src) {
+  return src[0] | (src[1] << 8) | (src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static const u8 *read_varint(const u8 *src, const u8 *end, u32 *value) {
+  *value = 0;
+  for (int shift = 0; (src < end) && (shift < 35); shift += 7) {
+    const u8 byte = *src++;
+    *value |= (u32)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return src;
+    }
+  }
+  return NULL;
+}
+
+static int is_valid_header(const link_trace_stream_header_t *header) {
+  return (header->magic == LINK_TRACE_STREAM_MAGIC)
+         && (header->id == LINK_NOTIFY_ID_POSIX_TRACE_STREAM)
+         && (header->size >= sizeof(link_trace_stream_header_t));
+}
+
+static int report_drops(
+  link_trace_stream_decoder_t *decoder,
+  u64 timestamp,
+  u32 drop_count,
+  link_trace_stream_callback_t callback,
+  void *context) {
+  link_trace_stream_event_t event = {0};
+  if (drop_count == 0) {
+    return 0;
+  }
+  decoder->drop_count += drop_count;
+  event.timestamp = timestamp;
+  event.event_id = LINK_POSIX_TRACE_OVERFLOW;
+  event.drop_count = drop_count;
+  return callback(context, &event);
+}
+
+int link_trace_stream_decode(
+  link_trace_stream_decoder_t *decoder,
+  const void *buf,
+  int nbyte,
+  link_trace_stream_callback_t callback,
+  void *context) {
+  const u8 *start = buf;
+  int offset = 0;
+
+  while (nbyte - offset >= (int)sizeof(link_trace_stream_header_t)) {
+    link_trace_stream_header_t header;
+    memcpy(&header, start + offset, sizeof(header));
+    if (is_valid_header(&header) == 0) {
+      decoder->skip_count++;
+      offset++;
+      continue;
+    }
+
+    if (header.size > nbyte - offset) {
+      // wait for the rest of the block
+      break;
+    }
+
+    u16 checksum = 0;
+    for (u32 i = sizeof(header); i < header.size; i++) {
+      checksum += start[offset + i];
+    }
+    if (checksum != header.checksum) {
+      decoder->skip_count++;
+      offset++;
+      continue;
+    }
+
+    const int result = decode_block(decoder, start + offset, callback, context);
+    if (result < 0) {
+      return result;
+    }
+    offset += header.size;
+  }
+
+  return offset;
+}
+
+int decode_block(
+  link_trace_stream_decoder_t *decoder,
+  const u8 *block,
+  link_trace_stream_callback_t callback,
+  void *context) {
+  link_trace_stream_header_t header;
+  memcpy(&header, block, sizeof(header));
+
+  u32 drop_count = header.drop_count;
+  if (decoder->is_started && (header.sequence != decoder->next_sequence)) {
+    // the number of events in lost blocks is unknown so count each block as one
+    const u32 lost_block_count = header.sequence - decoder->next_sequence;
+    decoder->lost_block_count += lost_block_count;
+    drop_count += lost_block_count;
+  }
+  decoder->is_started = 1;
+  decoder->next_sequence = header.sequence + 1;
+  decoder->block_count++;
+
+  int result = report_drops(decoder, header.timestamp, drop_count, callback, context);
+  if (result < 0) {
+    return result;
+  }
+
+  const u8 *src = block + sizeof(header);
+  const u8 *end = block + header.size;
+  u64 timestamp = header.timestamp;
+  for (u32 i = 0; i < header.count; i++) {
+    link_trace_stream_event_t event;
+    u32 delta;
+    u32 pid;
+    if (end - src < 3) {
+      return 0;
+    }
+    event.event_id = src[0];
+    event.tid = src[1];
+    event.data_size = src[2] & ~LINK_TRACE_STREAM_TRUNCATED;
+    event.is_truncated = (src[2] & LINK_TRACE_STREAM_TRUNCATED) != 0;
+    src = read_varint(src + 3, end, &delta);
+    if (src == NULL) {
+      return 0;
+    }
+    src = read_varint(src, end, &pid);
+    if ((src == NULL) || (end - src < 4 + event.data_size)) {
+      return 0;
+    }
+    timestamp += delta;
+    event.timestamp = timestamp;
+    event.pid = pid;
+    event.drop_count = 0;
+    event.address = read_u32(src);
+    event.data = src + 4;
+    src += 4 + event.data_size;
+
+    decoder->event_count++;
+    result = callback(context, &event);
+    if (result < 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+const char *get_event_name(u8 event_id) {
+  switch (event_id) {
+  case LINK_POSIX_TRACE_OVERFLOW:
+    return "trace overflow";
+  case LINK_POSIX_TRACE_RESUME:
+    return "trace resume";
+  case LINK_POSIX_TRACE_FLUSH_START:
+    return "trace flush start";
+  case LINK_POSIX_TRACE_FLUSH_STOP:
+    return "trace flush stop";
+  case LINK_POSIX_TRACE_START:
+    return "trace start";
+  case LINK_POSIX_TRACE_STOP:
+    return "trace stop";
+  case LINK_POSIX_TRACE_FILTER:
+    return "trace filter";
+  case LINK_POSIX_TRACE_ERROR:
+    return "error";
+  case LINK_POSIX_TRACE_UNNAMED_USER_EVENT:
+    return "unnamed";
+  case LINK_POSIX_TRACE_MESSAGE:
+    return "message";
+  case LINK_POSIX_TRACE_WARNING:
+    return "warning";
+  case LINK_POSIX_TRACE_CRITICAL:
+    return "critical";
+  case LINK_POSIX_TRACE_FATAL:
+    return "fatal";
+  }
+  return NULL;
+}
+
+static void write_json_string(FILE *output, const char *value, int length) {
+  fputc('"', output);
+  for (int i = 0; i < length; i++) {
+    const unsigned char c = value[i];
+    if ((c == '"') || (c == '\\')) {
+      fprintf(output, "\\%c", c);
+    } else if ((c < 0x20) || (c > 0x7e)) {
+      fprintf(output, "\\u%04x", c);
+    } else {
+      fputc(c, output);
+    }
+  }
+  fputc('"', output);
+}
+
+static int is_text(const u8 *data, int size) {
+  // trailing zeros are allowed so strings traced with sizeof() are text
+  while ((size > 0) && (data[size - 1] == 0)) {
+    size--;
+  }
+  for (int i = 0; i < size; i++) {
+    if ((data[i] < 0x20) || (data[i] > 0x7e)) {
+      return -1;
+    }
+  }
+  return size;
+}
+
+int write_json_event(void *context, const link_trace_stream_event_t *event) {
+  json_export_t *json = context;
+  FILE *output = json->output;
+  const char *name = get_event_name(event->event_id);
+
+  fprintf(output, "%s\n{\"name\":", json->count ? "," : "");
+  if (name != NULL) {
+    write_json_string(output, name, strlen(name));
+  } else {
+    fprintf(output, "\"event %d\"", event->event_id);
+  }
+
+  fprintf(
+    output, ",\"cat\":\"sos\",\"ph\":\"i\",\"ts\":%llu",
+    (unsigned long long)event->timestamp);
+
+  if (event->event_id == LINK_POSIX_TRACE_OVERFLOW && event->drop_count) {
+    // dropped events have no thread
+    fprintf(output, ",\"s\":\"g\",\"pid\":0,\"tid\":0,\"args\":{\"dropped\":%lu}}",
+            (unsigned long)event->drop_count);
+    json->count++;
+    return 0;
+  }
+
+  fprintf(
+    output, ",\"s\":\"t\",\"pid\":%lu,\"tid\":%d,\"args\":{\"address\":\"0x%08lx\"",
+    (unsigned long)event->pid, event->tid, (unsigned long)event->address);
+
+  if (event->address >= LINK_TRACE_APP_ADDRESS) {
+    fprintf(
+      output, ",\"app_offset\":\"0x%lx\"",
+      (unsigned long)(event->address - LINK_TRACE_APP_ADDRESS));
+  }
+
+  const char *symbol = json->resolve ? json->resolve(json->context, event->address) : NULL;
+  if (symbol != NULL) {
+    fprintf(output, ",\"symbol\":");
+    write_json_string(output, symbol, strlen(symbol));
+  }
+
+  if (event->data_size) {
+    const int text_size = is_text(event->data, event->data_size);
+    fprintf(output, ",\"data\":");
+    if (text_size >= 0) {
+      write_json_string(output, (const char *)event->data, text_size);
+    } else {
+      fputc('"', output);
+      for (int i = 0; i < event->data_size; i++) {
+        fprintf(output, "%02x", event->data[i]);
+      }
+      fputc('"', output);
+    }
+  }
+
+  if (event->is_truncated) {
+    fprintf(output, ",\"truncated\":true");
+  }
+
+  fprintf(output, "}}");
+  json->count++;
+  return 0;
+}
+
+int link_trace_stream_export_json(
+  FILE *output,
+  const void *stream,
+  int nbyte,
+  const char *(*resolve)(void *context, u32 address),
+  void *context) {
+  link_trace_stream_decoder_t decoder;
+  json_export_t json = {
+    .output = output, .resolve = resolve, .context = context, .count = 0};
+
+  link_trace_stream_decoder_init(&decoder);
+  fprintf(output, "{\"traceEvents\":[");
+  if (link_trace_stream_decode(&decoder, stream, nbyte, write_json_event, &json) < 0) {
+    return -1;
+  }
+  fprintf(output, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  if (ferror(output)) {
+    return -1;
+  }
+  return json.count;
+}
@@ -11,11 +11,22 @@
 
 #define pkt_checksum(pktp) ((pktp)->data[(pktp)->size])
 
+static u32 calculate_crc32c(const link2_pkt_t *pkt) {
+  // covers o_flags and size as well as the data
+  return link_transport_crc32c(0, &pkt->o_flags, pkt->size + 3);
+}
+
 void link2_transport_insert_checksum(link2_pkt_t *pkt) {
   int i;
   u16 checksum;
 
-  // needs to be a more powerful checksum for link2 - optionally enabled
+  if (LINK2_PACKET_IS_CRC32C(pkt)) {
+    const u32 crc = calculate_crc32c(pkt);
+    memcpy(pkt->data + pkt->size, &crc, sizeof(crc));
+    return;
+  }
+
+  // legacy xor checksum -- LINK2_FLAG_IS_CRC32C is used when both ends support it
 
   checksum = 0;
   checksum ^= pkt->size;
@@ -33,6 +44,12 @@ bool link2_transport_checksum_isok(link2_pkt_t *pkt) {
     return false;
   }
 
+  if (LINK2_PACKET_IS_CRC32C(pkt)) {
+    u32 crc;
+    memcpy(&crc, pkt->data + pkt->size, sizeof(crc));
+    return crc == calculate_crc32c(pkt);
+  }
+
   link2_transport_insert_checksum(pkt);
   if (checksum == pkt_checksum(pkt)) {
     return true;
@@ -92,7 +109,7 @@ int link2_transport_wait_packet(
     if (bytes == 0) {
       page_size = 1;
     } else {
-      page_size = (pkt->size - bytes) + LINK2_PACKET_HEADER_SIZE - 1;
+      page_size = (LINK2_PACKET_SIZE(pkt) - 1) - bytes;
     }
 
     bytes_read = driver->read(driver->handle, p, page_size);
@@ -117,7 +134,7 @@ int link2_transport_wait_packet(
       }
     }
 
-  } while (bytes < (pkt->size + LINK2_PACKET_HEADER_SIZE - 1));
+  } while (bytes < (LINK2_PACKET_SIZE(pkt) - 1));
 
   return 0;
 }
@@ -53,7 +53,9 @@ int link2_transport_masterread(link_transport_mdriver_t *driver, void *buf, int
       return err;
     }
 
-    if (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (
+      LINK2_PACKET_IS_CRC32C(&pkt)
+      || (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM)) {
       // a packet has arrived -- checksum it
       if (link2_transport_checksum_isok(&pkt) == false) {
         return SYSFS_SET_RETURN(1);
@@ -92,19 +94,40 @@ int link2_transport_masterwrite(
   p = (void *)buf;
   memset(&pkt, 0, sizeof(pkt));
   pkt.start = LINK2_PACKET_START;
-  pkt.o_flags = driver->phy_driver.o_flags;
 
+  // the slave loops on the uncompressed size
+  int size;
   do {
-
     if ((nbyte - bytes) > LINK2_PACKET_DATA_SIZE) {
-      pkt.size = LINK2_PACKET_DATA_SIZE;
+      size = LINK2_PACKET_DATA_SIZE;
     } else {
-      pkt.size = nbyte - bytes;
+      size = nbyte - bytes;
     }
 
-    memcpy(pkt.data, p, pkt.size);
+    pkt.o_flags = driver->phy_driver.o_flags & ~LINK2_FLAG_IS_LZ;
+    pkt.size = size;
+
+    // an empty packet flagged with CRC-32C is the negotiation query
+    if (driver->phy_driver.is_crc32c && pkt.size > 0) {
+      pkt.o_flags |= LINK2_FLAG_IS_CRC32C;
+    }
+
+    int compressed_size = -1;
+    if (driver->phy_driver.is_lz && size > 0) {
+      // only send the compressed data if it is smaller
+      compressed_size = link_transport_lz_compress(pkt.data, size - 1, p, size);
+    }
+
+    if (compressed_size > 0) {
+      pkt.o_flags |= LINK2_FLAG_IS_LZ;
+      pkt.size = compressed_size;
+    } else {
+      memcpy(pkt.data, p, pkt.size);
+    }
 
-    if (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (
+      LINK2_PACKET_IS_CRC32C(&pkt)
+      || (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM)) {
       link2_transport_insert_checksum(&pkt);
     } else {
       // checksum is set to zero
@@ -113,9 +136,8 @@ int link2_transport_masterwrite(
 
     // send packet
     if (
-      driver->phy_driver.write(
-        driver->phy_driver.handle, &pkt, pkt.size + LINK2_PACKET_HEADER_SIZE)
-      != (pkt.size + LINK2_PACKET_HEADER_SIZE)) {
+      driver->phy_driver.write(driver->phy_driver.handle, &pkt, LINK2_PACKET_SIZE(&pkt))
+      != LINK2_PACKET_SIZE(&pkt)) {
       return SYSFS_SET_RETURN(1);
     }
 
@@ -137,14 +159,63 @@ int link2_transport_masterwrite(
       return SYSFS_SET_RETURN(1);
     }
 
-    bytes += pkt.size;
-    p += pkt.size;
+    bytes += size;
+    p += size;
 
-  } while ((bytes < nbyte) && (pkt.size == LINK2_PACKET_DATA_SIZE));
+  } while ((bytes < nbyte) && (size == LINK2_PACKET_DATA_SIZE));
 
   return bytes;
 }
 
+int link2_transport_masternegotiate(link_transport_mdriver_t *driver) {
+  link2_pkt_t pkt;
+  int err;
+
+  driver->phy_driver.is_crc32c = 0;
+  driver->phy_driver.is_lz = 0;
+
+  u8 o_flags = driver->phy_driver.o_flags & ~LINK2_FLAG_IS_LZ;
+  if (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    o_flags |= LINK2_FLAG_IS_CRC32C;
+  }
+  if (driver->phy_driver.o_flags & LINK2_FLAG_IS_LZ) {
+    o_flags |= LINK2_FLAG_IS_LZ;
+  }
+
+  if ((o_flags & (LINK2_FLAG_IS_CRC32C | LINK2_FLAG_IS_LZ)) == 0) {
+    return 0;
+  }
+
+  // an empty packet is framed the same with or without CRC-32C or compression
+  // so slaves that don't support them just ack an empty read
+  memset(&pkt, 0, sizeof(pkt));
+  pkt.start = LINK2_PACKET_START;
+  pkt.o_flags = o_flags;
+  pkt.size = 0;
+  link2_transport_insert_checksum(&pkt);
+
+  if (
+    driver->phy_driver.write(driver->phy_driver.handle, &pkt, LINK2_PACKET_SIZE(&pkt))
+    != LINK2_PACKET_SIZE(&pkt)) {
+    return SYSFS_SET_RETURN(1);
+  }
+
+  if ((err = wait_ack(driver, pkt_checksum(&pkt), driver->phy_driver.timeout)) < 0) {
+    driver->phy_driver.flush(driver->phy_driver.handle);
+    return err;
+  }
+
+  if (err == LINK2_PACKET_CRC32C_ACK || err == LINK2_PACKET_CRC32C_LZ_ACK) {
+    driver->phy_driver.is_crc32c = 1;
+  }
+
+  if (err == LINK2_PACKET_LZ_ACK || err == LINK2_PACKET_CRC32C_LZ_ACK) {
+    driver->phy_driver.is_lz = 1;
+  }
+
+  return 0;
+}
+
 int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout) {
   link_ack_t ack;
   char *p;
@@ -28,6 +28,11 @@ int link2_transport_slaveread(
   do {
 
     if (link2_transport_wait_start(driver, &pkt, driver->timeout) < 0) {
+      if (pkt.start == LINK_PACKET_START) {
+        // a new master is probing the protocol version -- it will negotiate again
+        driver->is_crc32c = 0;
+        driver->is_lz = 0;
+      }
       driver->flush(driver->handle);
       send_ack(driver, LINK2_PACKET_NACK, 0);
       return -1 * __LINE__;
@@ -47,7 +52,7 @@ int link2_transport_slaveread(
     }
 
     // a packet has arrived -- checksum it
-    if (driver->o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (LINK2_PACKET_IS_CRC32C(&pkt) || (driver->o_flags & LINK2_FLAG_IS_CHECKSUM)) {
       checksum = pkt_checksum(&pkt);
       if (link2_transport_checksum_isok(&pkt) == false) {
         // bad checksum on packet -- treat as a non-packet
@@ -59,6 +64,38 @@ int link2_transport_slaveread(
       checksum = 0;
     }
 
+    if ((pkt.size == 0) && (pkt.o_flags & (LINK2_FLAG_IS_CRC32C | LINK2_FLAG_IS_LZ))) {
+      // the master is asking if CRC-32C and/or compression are supported
+      // the full size keeps the loop waiting for the data packet
+      driver->is_crc32c = (pkt.o_flags & LINK2_FLAG_IS_CRC32C) != 0;
+      driver->is_lz = (pkt.o_flags & LINK2_FLAG_IS_LZ) != 0;
+      u8 ack = LINK2_PACKET_CRC32C_LZ_ACK;
+      if (driver->is_crc32c == 0) {
+        ack = LINK2_PACKET_LZ_ACK;
+      } else if (driver->is_lz == 0) {
+        ack = LINK2_PACKET_CRC32C_ACK;
+      }
+      if (send_ack(driver, ack, checksum) < 0) {
+        return -1 * __LINE__;
+      }
+      pkt.size = LINK2_PACKET_DATA_SIZE;
+      continue;
+    }
+
+    if (pkt.o_flags & LINK2_FLAG_IS_LZ) {
+      // move the compressed data to the end of the buffer and decompress in place
+      u8 *compressed = pkt.data + sizeof(pkt.data) - pkt.size;
+      memmove(compressed, pkt.data, pkt.size);
+      const int size = link_transport_lz_decompress(
+        pkt.data, LINK2_PACKET_DATA_SIZE, compressed, pkt.size);
+      if (size < 0) {
+        driver->flush(driver->handle);
+        send_ack(driver, LINK2_PACKET_NACK, checksum);
+        return -1 * __LINE__;
+      }
+      pkt.size = size;
+    }
+
     // callback to handle incoming data as it arrives
     if (callback == NULL) {
       // copy the valid data to the buffer
@@ -104,6 +141,9 @@ int link2_transport_slavewrite(
   p = (void *)buf;
   pkt.start = LINK2_PACKET_START;
   pkt.o_flags = driver->o_flags;
+  if (driver->is_crc32c) {
+    pkt.o_flags |= LINK2_FLAG_IS_CRC32C;
+  }
 
   do {
 
@@ -125,14 +165,12 @@ int link2_transport_slavewrite(
       memcpy(pkt.data, p, pkt.size);
     }
 
-    if (driver->o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (LINK2_PACKET_IS_CRC32C(&pkt) || (driver->o_flags & LINK2_FLAG_IS_CHECKSUM)) {
       link2_transport_insert_checksum(&pkt);
     }
 
     // send packet
-    if (
-      driver->write(driver->handle, &pkt, pkt.size + LINK2_PACKET_HEADER_SIZE)
-      != (pkt.size + LINK2_PACKET_HEADER_SIZE)) {
+    if (driver->write(driver->handle, &pkt, LINK2_PACKET_SIZE(&pkt)) != LINK2_PACKET_SIZE(&pkt)) {
       return -1 * __LINE__;
     }
 
@@ -16,6 +16,7 @@
 #define pkt_checksum(pktp) ((pktp)->data[(pktp)->size])
 
 static int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout);
+static int read_ack(link_transport_mdriver_t *driver, link_ack_t *ack, int timeout);
 
 static void *ecc_context(link_transport_mdriver_t *driver) {
   return driver->phy_driver.crypto_handle.ecc_context;
@@ -164,7 +165,9 @@ int link3_transport_masterread(link_transport_mdriver_t *driver, void *buf, int
       return err;
     }
 
-    if (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM) {
+    if (
+      LINK3_PACKET_IS_CRC32C(&pkt)
+      || (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM)) {
       // a packet has arrived -- checksum it
       if (link3_transport_checksum_isok(&pkt) == false) {
         return SYSFS_SET_RETURN(1);
@@ -180,7 +183,7 @@ int link3_transport_masterread(link_transport_mdriver_t *driver, void *buf, int
 
     if (driver->transport_version == 3) {
       // decrypt the packet
-      const u16 unaligned_bytes = pkt.size % 16;
+      const u16 unaligned_bytes = data->data_size % 16;
       const u16 padding_bytes = unaligned_bytes ? 16 - unaligned_bytes : 0;
       memset(data->data + data->data_size, 0, padding_bytes);
       aes_api(driver)->decrypt_cbc(
@@ -198,61 +201,79 @@ int link3_transport_masterread(link_transport_mdriver_t *driver, void *buf, int
   return bytes;
 }
 
-int link3_transport_masterwrite(
+static void build_packet(
+  link_transport_mdriver_t *driver,
+  link3_pkt_t *pkt,
+  const u8 *p,
+  int size,
+  u8 o_flags) {
+  link3_pkt_data_t *data = (link3_pkt_data_t *)pkt->data;
+
+  pkt->start = LINK3_PACKET_START;
+  pkt->o_flags = o_flags;
+  if (driver->phy_driver.is_crc32c) {
+    pkt->o_flags |= LINK3_FLAG_IS_CRC32C;
+  }
+  data->data_size = size;
+
+  // total packet size -- data size plus header
+  pkt->size = data->data_size + (sizeof(*data) - sizeof(data->data));
+
+  if (driver->transport_version == 3) {
+    // this is the actual number of data bytes before padding
+    const u16 unaligned_bytes = data->data_size % 16;
+    const u16 padding_bytes = unaligned_bytes ? 16 - unaligned_bytes : 0;
+    memset(data->data + data->data_size, 0, padding_bytes);
+
+    random_api(driver)->random(random_context(driver), data->iv, sizeof(data->iv));
+
+    aes_api(driver)->encrypt_cbc(
+      aes_context(driver), data->data_size + padding_bytes, data->iv, p, data->data);
+
+  } else {
+    memcpy(data->data, p, data->data_size);
+  }
+
+  if (LINK3_PACKET_IS_CRC32C(pkt) || (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM)) {
+    link3_transport_insert_checksum(pkt);
+  } else {
+    // checksum is set to zero
+    pkt_checksum(pkt) = 0;
+  }
+}
+
+static int write_packet(link_transport_mdriver_t *driver, link3_pkt_t *pkt) {
+  if (
+    driver->phy_driver.write(driver->phy_driver.handle, pkt, LINK3_PACKET_SIZE(pkt))
+    != LINK3_PACKET_SIZE(pkt)) {
+    return SYSFS_SET_RETURN(1);
+  }
+  return 0;
+}
+
+static int masterwrite_stop_and_wait(
   link_transport_mdriver_t *driver,
   const void *buf,
   int nbyte) {
   int bytes;
   int err;
 
-  if (driver == 0) {
-    return -1;
-  }
-
   bytes = 0;
-  const u8 * p = buf;
-  link3_pkt_t pkt = {.start = LINK3_PACKET_START, .o_flags = driver->phy_driver.o_flags};
+  const u8 *p = buf;
+  link3_pkt_t pkt = {};
   link3_pkt_data_t *data = (link3_pkt_data_t *)pkt.data;
 
   do {
 
     if ((nbyte - bytes) > (int)sizeof(data->data)) {
-      data->data_size = sizeof(data->data);
+      build_packet(driver, &pkt, p, sizeof(data->data), driver->phy_driver.o_flags);
     } else {
-      data->data_size = nbyte - bytes;
-    }
-
-    // total packet size -- data size plus header
-    pkt.size = data->data_size + (sizeof(*data) - sizeof(data->data));
-
-    if (driver->transport_version == 3) {
-      // this is the actual number of data bytes before padding
-      const u16 unaligned_bytes = pkt.size % 16;
-      const u16 padding_bytes = unaligned_bytes ? 16 - unaligned_bytes : 0;
-      memset(data->data + data->data_size, 0, padding_bytes);
-
-      random_api(driver)->random(random_context(driver), data->iv, sizeof(data->iv));
-
-      aes_api(driver)->encrypt_cbc(
-        aes_context(driver), data->data_size + padding_bytes, data->iv, p, data->data);
-
-    } else {
-      memcpy(data->data, p, data->data_size);
-    }
-
-    if (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM) {
-      link3_transport_insert_checksum(&pkt);
-    } else {
-      // checksum is set to zero
-      pkt_checksum(&pkt) = 0;
+      build_packet(driver, &pkt, p, nbyte - bytes, driver->phy_driver.o_flags);
     }
 
     // send packet
-    if (
-      driver->phy_driver.write(
-        driver->phy_driver.handle, &pkt, pkt.size + LINK3_PACKET_HEADER_SIZE)
-      != (pkt.size + LINK3_PACKET_HEADER_SIZE)) {
-      return SYSFS_SET_RETURN(1);
+    if ((err = write_packet(driver, &pkt)) < 0) {
+      return err;
     }
 
     // received ack of the checksum
@@ -278,17 +299,163 @@ int link3_transport_masterwrite(
   return bytes;
 }
 
-int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout) {
-  link_ack_t ack;
+static int masterwrite_window(
+  link_transport_mdriver_t *driver,
+  const void *buf,
+  int nbyte) {
+  link_transport_driver_t *const phy_driver = &driver->phy_driver;
+  const u8 *p = buf;
+  link3_pkt_t pkt = {};
+
+  // an empty write still sends one (empty) packet
+  const int packet_count =
+    nbyte > 0 ? (nbyte + LINK3_PACKET_PAYLOAD_SIZE - 1) / LINK3_PACKET_PAYLOAD_SIZE : 1;
+
+  // base is the oldest un-acked packet, next is the next packet to send
+  int base = 0;
+  int next = 0;
+  int retry_count = 0;
+
+  // the first windowed packet tells the slave where the sequence starts
+  int is_sync = (phy_driver->window_size == 0);
+
+  while (base < packet_count) {
+    // until the slave has acked a windowed packet, only one packet is outstanding
+    const int window_size = phy_driver->window_size ? phy_driver->window_size : 1;
+
+    while ((next < packet_count) && (next - base < window_size)) {
+      const int offset = next * LINK3_PACKET_PAYLOAD_SIZE;
+      const int size = (nbyte - offset) > LINK3_PACKET_PAYLOAD_SIZE
+                         ? LINK3_PACKET_PAYLOAD_SIZE
+                         : nbyte - offset;
+      u8 o_flags = phy_driver->o_flags | LINK3_FLAG_IS_WINDOW;
+      if (is_sync && (next == base)) {
+        o_flags |= LINK3_FLAG_IS_WINDOW_SYNC;
+      }
+      o_flags = LINK3_PACKET_SET_SEQUENCE(o_flags, phy_driver->tx_sequence + next);
+
+      build_packet(driver, &pkt, p + offset, size, o_flags);
+
+      const int write_result = write_packet(driver, &pkt);
+      if (write_result < 0) {
+        return write_result;
+      }
+      next++;
+    }
+
+    link_ack_t ack;
+    const int ack_result = read_ack(driver, &ack, phy_driver->timeout);
+    if (ack_result == LINK_TIMEOUT_ERROR) {
+      // packets or acks were lost -- resend everything that is outstanding
+      if (++retry_count > LINK3_WINDOW_RETRY_MAX) {
+        phy_driver->flush(phy_driver->handle);
+        return ack_result;
+      }
+      next = base;
+      continue;
+    }
+
+    if (ack_result < 0) {
+      phy_driver->flush(phy_driver->handle);
+      return ack_result;
+    }
+
+    // distance of the acked sequence number from the oldest outstanding packet
+    const int offset =
+      (ack.checksum - (phy_driver->tx_sequence + base)) & LINK3_PACKET_SEQUENCE_MASK;
+
+    switch (ack.ack) {
+    case LINK3_PACKET_WINDOW_ACK:
+      // cumulative -- every packet up to and including offset was received
+      if (offset < next - base) {
+        if (phy_driver->window_size == 0) {
+          phy_driver->window_size = LINK3_WINDOW_SIZE;
+          // slaves that support windows also support CRC-32C
+          phy_driver->is_crc32c = (phy_driver->o_flags & LINK3_FLAG_IS_CHECKSUM) != 0;
+        }
+        base += offset + 1;
+        retry_count = 0;
+        is_sync = 0;
+      }
+      // otherwise it is a stale ack for a re-sent duplicate
+      break;
+
+    case LINK3_PACKET_WINDOW_NACK:
+      // the slave is waiting for the packet at offset
+      if (++retry_count > LINK3_WINDOW_RETRY_MAX) {
+        phy_driver->flush(phy_driver->handle);
+        return SYSFS_SET_RETURN(1);
+      }
+      if (offset <= next - base) {
+        base += offset;
+      } else {
+        // the slave has lost track of the sequence
+        is_sync = 1;
+      }
+      next = base;
+      break;
+
+    case LINK3_PACKET_WINDOW_ABORT:
+      // the slave gave up on the transfer -- the next one starts with a sync packet
+      phy_driver->window_size = 0;
+      phy_driver->flush(phy_driver->handle);
+      return LINK_PROT_ERROR;
+
+    case LINK3_PACKET_ACK:
+      if ((phy_driver->window_size == 0) && (ack.checksum == pkt_checksum(&pkt))) {
+        // the slave does not support windowed transfers
+        phy_driver->window_size = 1;
+        if (packet_count == 1) {
+          return nbyte;
+        }
+        const int result = masterwrite_stop_and_wait(
+          driver, p + LINK3_PACKET_PAYLOAD_SIZE, nbyte - LINK3_PACKET_PAYLOAD_SIZE);
+        if (result < 0) {
+          return result;
+        }
+        return result + LINK3_PACKET_PAYLOAD_SIZE;
+      }
+      return LINK_PROT_ERROR;
+
+    default:
+      phy_driver->flush(phy_driver->handle);
+      return SYSFS_SET_RETURN(1);
+    }
+  }
+
+  phy_driver->tx_sequence =
+    (phy_driver->tx_sequence + packet_count) & LINK3_PACKET_SEQUENCE_MASK;
+
+  return nbyte;
+}
+
+int link3_transport_masterwrite(
+  link_transport_mdriver_t *driver,
+  const void *buf,
+  int nbyte) {
+
+  if (driver == 0) {
+    return -1;
+  }
+
+  if (driver->phy_driver.window_size == 1) {
+    // slave only supports one packet at a time
+    return masterwrite_stop_and_wait(driver, buf, nbyte);
+  }
+
+  return masterwrite_window(driver, buf, nbyte);
+}
+
+int read_ack(link_transport_mdriver_t *driver, link_ack_t *ack, int timeout) {
   int ret;
 
   int count = 0;
-  char *p = (char *)&ack;
+  char *p = (char *)ack;
   size_t bytes_read = 0;
   u64 start_time, stop_time;
   do {
     start_time = link_transport_gettime();
-    ret = driver->phy_driver.read(driver->phy_driver.handle, p, sizeof(ack) - bytes_read);
+    ret = driver->phy_driver.read(driver->phy_driver.handle, p, sizeof(*ack) - bytes_read);
 
     if (ret < 0) {
       return LINK_PHY_ERROR;
@@ -305,7 +472,18 @@ int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout) {
         return LINK_TIMEOUT_ERROR;
       }
     }
-  } while (bytes_read < sizeof(ack));
+  } while (bytes_read < sizeof(*ack));
+
+  return 0;
+}
+
+int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout) {
+  link_ack_t ack;
+  int ret;
+
+  if ((ret = read_ack(driver, &ack, timeout)) < 0) {
+    return ret;
+  }
 
   if (ack.checksum != checksum) {
     return LINK_PROT_ERROR;
@@ -87,13 +87,103 @@ const int verify_result = driver->verify(device_info.identifier, device_info.sig
   return 0;
 }
 
+static int wait_window_packet(
+  link_transport_driver_t *driver,
+  link3_pkt_t *pkt,
+  link_ack_t *ack) {
+  int error_count = 0;
+  int is_nack_sent = 0;
+
+  do {
+    int error_line = 0;
+    u8 checksum = 0;
+
+    if (link3_transport_wait_start(driver, pkt, driver->timeout) < 0) {
+      if (pkt->start == LINK_PACKET_START || pkt->start == LINK2_PACKET_START) {
+        // a new master is probing the protocol version -- it needs the legacy NACK
+        driver->window_size = 0;
+        driver->is_crc32c = 0;
+      }
+      error_line = __LINE__;
+    } else if (link3_transport_wait_packet(driver, pkt, driver->timeout) < 0) {
+      error_line = __LINE__;
+    } else if (pkt->start != LINK3_PACKET_START) {
+      // if packet does not start with the start byte then it is not a packet
+      error_line = __LINE__;
+    } else if (
+      LINK3_PACKET_IS_CRC32C(pkt) || (driver->o_flags & LINK3_FLAG_IS_CHECKSUM)) {
+      // a packet has arrived -- checksum it
+      checksum = pkt_checksum(pkt);
+      if (link3_transport_checksum_isok(pkt) == false) {
+        // bad checksum on packet -- treat as a non-packet
+        error_line = __LINE__;
+      } else if (LINK3_PACKET_IS_CRC32C(pkt)) {
+        // reply in kind
+        driver->is_crc32c = 1;
+      }
+    }
+
+    if (error_line) {
+      driver->flush(driver->handle);
+      if (driver->window_size == 0 || ++error_count > LINK3_WINDOW_RETRY_MAX) {
+        send_ack(driver, LINK3_PACKET_NACK, checksum);
+        return -1 * error_line;
+      }
+
+      // ask the master to go back to the first missing packet (unless it was told to stop)
+      if ((is_nack_sent == 0) && (driver->rx_sequence != LINK3_PACKET_SEQUENCE_ABORTED)) {
+        send_ack(driver, LINK3_PACKET_WINDOW_NACK, driver->rx_sequence);
+        is_nack_sent = 1;
+      }
+      continue;
+    }
+
+    if ((pkt->o_flags & LINK3_FLAG_IS_WINDOW) == 0) {
+      // master is using stop-and-wait
+      driver->window_size = 0;
+      ack->ack = LINK3_PACKET_ACK;
+      ack->checksum = checksum;
+      return 0;
+    }
+
+    const u8 sequence = LINK3_PACKET_SEQUENCE(pkt->o_flags);
+    driver->window_size = LINK3_WINDOW_SIZE;
+    if (pkt->o_flags & LINK3_FLAG_IS_WINDOW_SYNC) {
+      driver->rx_sequence = sequence;
+    } else if (driver->rx_sequence == LINK3_PACKET_SEQUENCE_ABORTED) {
+      // the rest of an aborted transfer that was already in flight
+      continue;
+    }
+
+    if (sequence == driver->rx_sequence) {
+      driver->rx_sequence = (sequence + 1) & LINK3_PACKET_SEQUENCE_MASK;
+      ack->ack = LINK3_PACKET_WINDOW_ACK;
+      ack->checksum = sequence;
+      return 0;
+    }
+
+    if (((driver->rx_sequence - sequence) & LINK3_PACKET_SEQUENCE_MASK) <= LINK3_WINDOW_SIZE) {
+      // duplicate of a packet that was already received -- the ack was lost
+      send_ack(
+        driver, LINK3_PACKET_WINDOW_ACK,
+        (driver->rx_sequence - 1) & LINK3_PACKET_SEQUENCE_MASK);
+    } else if (is_nack_sent == 0) {
+      // a packet was dropped -- discard everything until it is re-sent
+      send_ack(driver, LINK3_PACKET_WINDOW_NACK, driver->rx_sequence);
+      is_nack_sent = 1;
+    }
+
+  } while (1);
+}
+
 int link3_transport_slaveread(
   link_transport_driver_t *driver,
   void *buf,
   int nbyte,
   int (*callback)(void *, void *, int),
   void *context) {
-  u16 checksum;
+  link_ack_t ack;
+  int result;
 
   link3_pkt_t pkt = {};
   int bytes = 0;
@@ -103,39 +193,11 @@ int link3_transport_slaveread(
 
   do {
 
-    if (link3_transport_wait_start(driver, &pkt, driver->timeout) < 0) {
-      driver->flush(driver->handle);
-      send_ack(driver, LINK3_PACKET_NACK, 0);
-      return -1 * __LINE__;
-    }
-
-    if (link3_transport_wait_packet(driver, &pkt, driver->timeout) < 0) {
-      driver->flush(driver->handle);
-      send_ack(driver, LINK3_PACKET_NACK, 0);
-      return -1 * __LINE__;
+    if ((result = wait_window_packet(driver, &pkt, &ack)) < 0) {
+      return result;
     }
 
-    if (pkt.start != LINK3_PACKET_START) {
-      // if packet does not start with the start byte then it is not a packet
-      driver->flush(driver->handle);
-      send_ack(driver, LINK3_PACKET_NACK, 0);
-      return -1 * __LINE__;
-    }
-
-    // a packet has arrived -- checksum it
-    if (driver->o_flags & LINK3_FLAG_IS_CHECKSUM) {
-      checksum = pkt_checksum(&pkt);
-      if (link3_transport_checksum_isok(&pkt) == false) {
-        // bad checksum on packet -- treat as a non-packet
-        driver->flush(driver->handle);
-        send_ack(driver, LINK3_PACKET_NACK, checksum);
-        return -1 * __LINE__;
-      }
-    } else {
-      checksum = 0;
-    }
-
-    const u16 unaligned_bytes = pkt.size % 16;
+    const u16 unaligned_bytes = data->data_size % 16;
     const u16 padding_bytes = unaligned_bytes ? 16 - unaligned_bytes : 0;
     memset(data->data + data->data_size, 0, padding_bytes);
 
@@ -148,18 +210,24 @@ int link3_transport_slaveread(
       memcpy(p, data->data, data->data_size);
       bytes += data->data_size;
       p += data->data_size;
-      send_ack(driver, LINK3_PACKET_ACK, checksum);
+      send_ack(driver, ack.ack, ack.checksum);
     } else {
-      int result;
 
       //decrypt??
 
       if ((result = callback(context, pkt.data, pkt.size)) < 0) {
-        send_ack(driver, LINK3_PACKET_NACK, checksum);
+        if (ack.ack == LINK3_PACKET_ACK) {
+          send_ack(driver, LINK3_PACKET_NACK, ack.checksum);
+        } else {
+          // a window nack would make the master resend -- tell it to stop instead
+          driver->rx_sequence = LINK3_PACKET_SEQUENCE_ABORTED;
+          send_ack(driver, LINK3_PACKET_WINDOW_ABORT, ack.checksum);
+          driver->flush(driver->handle);
+        }
         return result;
       } else {
         bytes += data->data_size;
-        if (send_ack(driver, LINK3_PACKET_ACK, checksum) < 0) {
+        if (send_ack(driver, ack.ack, ack.checksum) < 0) {
           return -1 * __LINE__;
         }
       }
@@ -187,6 +255,9 @@ int link3_transport_slavewrite(
   char* p = (void *)buf;
   pkt.start = LINK3_PACKET_START;
   pkt.o_flags = driver->o_flags;
+  if (driver->is_crc32c) {
+    pkt.o_flags |= LINK3_FLAG_IS_CRC32C;
+  }
 
   link3_pkt_data_t * const data = (link3_pkt_data_t *)pkt.data;
 
@@ -212,14 +283,12 @@ int link3_transport_slavewrite(
       memcpy(pkt.data, p, data->data_size);
     }
 
-    if (driver->o_flags & LINK3_FLAG_IS_CHECKSUM) {
+    if (LINK3_PACKET_IS_CRC32C(&pkt) || (driver->o_flags & LINK3_FLAG_IS_CHECKSUM)) {
       link3_transport_insert_checksum(&pkt);
     }
 
     // send packet
-    if (
-      driver->write(driver->handle, &pkt, pkt.size + LINK3_PACKET_HEADER_SIZE)
-      != (pkt.size + LINK3_PACKET_HEADER_SIZE)) {
+    if (driver->write(driver->handle, &pkt, LINK3_PACKET_SIZE(&pkt)) != LINK3_PACKET_SIZE(&pkt)) {
       return -1 * __LINE__;
     }
 
@@ -0,0 +1,222 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "sos/link/transport.h"
+
+// LZ4 block format: each sequence is a token (literal length in the upper
+// nibble, match length - 4 in the lower nibble), optional literal length
+// bytes, the literals, a 2 byte little endian offset and optional match
+// length bytes. A nibble of 15 is continued by bytes that are added until
+// one is less than 255. The last sequence only has literals.
+//
+// The compressor only emits blocks where the decoder's output never passes its
+// input when the block sits at the end of a buffer
+// LINK_TRANSPORT_LZ_IN_PLACE_MARGIN bytes larger than the decompressed data.
+// The slave uses this to decompress within the packet buffer.
+
+#define MIN_MATCH 4
+
+static int read_length(const u8 **src, const u8 *end, int length) {
+  if (length == 15) {
+    u8 value;
+    do {
+      if (*src == end) {
+        return -1;
+      }
+      value = *(*src)++;
+      length += value;
+    } while (value == 255);
+  }
+  return length;
+}
+
+int link_transport_lz_decompress(void *dest, int dest_size, const void *src, int nbyte) {
+  const u8 *in = src;
+  const u8 *const in_end = in + nbyte;
+  u8 *const out_start = dest;
+  u8 *out = dest;
+  u8 *const out_end = out + dest_size;
+
+  while (in < in_end) {
+    const u8 token = *in++;
+
+    const int literal_length = read_length(&in, in_end, token >> 4);
+    if (
+      literal_length < 0 || literal_length > in_end - in
+      || literal_length > out_end - out) {
+      return -1;
+    }
+    // decompressing in place can overlap
+    memmove(out, in, literal_length);
+    in += literal_length;
+    out += literal_length;
+
+    if (in == in_end) {
+      // the last sequence has no match
+      break;
+    }
+
+    if (in_end - in < 2) {
+      return -1;
+    }
+    const int offset = in[0] | (in[1] << 8);
+    in += 2;
+
+    int match_length = read_length(&in, in_end, token & 0x0f);
+    if (match_length < 0) {
+      return -1;
+    }
+    match_length += MIN_MATCH;
+
+    if (offset == 0 || offset > out - out_start || match_length > out_end - out) {
+      return -1;
+    }
+
+    // the match may overlap the bytes being written
+    const u8 *match = out - offset;
+    for (int i = 0; i < match_length; i++) {
+      out[i] = match[i];
+    }
+    out += match_length;
+  }
+
+  return (int)(out - out_start);
+}
+
+#if defined __link
+
+#define HASH_BITS 10
+
+static u32 read_u32(const u8 *p) {
+  u32 value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static u32 hash(u32 value) { return (value * 2654435761U) >> (32 - HASH_BITS); }
+
+static u8 *write_length(u8 *out, const u8 *out_end, int length) {
+  // the nibble already holds 15
+  length -= 15;
+  while (length >= 255) {
+    if (out == out_end) {
+      return NULL;
+    }
+    *out++ = 255;
+    length -= 255;
+  }
+  if (out == out_end) {
+    return NULL;
+  }
+  *out++ = (u8)length;
+  return out;
+}
+
+static u8 *write_sequence(
+  u8 *out,
+  const u8 *out_end,
+  const u8 *literals,
+  int literal_length,
+  int offset,
+  int match_length) {
+  const int match_code = match_length - MIN_MATCH;
+  if (out == out_end) {
+    return NULL;
+  }
+
+  u8 *token = out++;
+  *token = (u8)((literal_length < 15 ? literal_length : 15) << 4);
+  if (literal_length >= 15 && (out = write_length(out, out_end, literal_length)) == NULL) {
+    return NULL;
+  }
+
+  if (literal_length > out_end - out) {
+    return NULL;
+  }
+  memcpy(out, literals, literal_length);
+  out += literal_length;
+
+  if (match_length == 0) {
+    return out;
+  }
+
+  if (out_end - out < 2) {
+    return NULL;
+  }
+  *out++ = (u8)offset;
+  *out++ = (u8)(offset >> 8);
+
+  *token |= (u8)(match_code < 15 ? match_code : 15);
+  if (match_code >= 15) {
+    out = write_length(out, out_end, match_code);
+  }
+  return out;
+}
+
+int link_transport_lz_compress(void *dest, int dest_size, const void *src, int nbyte) {
+  // positions are stored plus one so zero is an empty slot
+  u16 table[1 << HASH_BITS];
+  const u8 *const in_start = src;
+  const u8 *const in_end = in_start + nbyte;
+  const u8 *in = in_start;
+  const u8 *literals = in_start;
+  u8 *const out_start = dest;
+  u8 *out = dest;
+  const u8 *const out_end = out + dest_size;
+  // the most that decompressed data gets ahead of compressed data
+  int lead = 0;
+
+  if (nbyte > 0xffff) {
+    return -1;
+  }
+
+  memset(table, 0, sizeof(table));
+
+  while (in_end - in >= MIN_MATCH) {
+    const u32 value = read_u32(in);
+    const u32 h = hash(value);
+    const int candidate = table[h] - 1;
+    table[h] = (u16)(in - in_start + 1);
+
+    if (candidate < 0 || read_u32(in_start + candidate) != value) {
+      in++;
+      continue;
+    }
+
+    const u8 *match = in_start + candidate;
+    int match_length = MIN_MATCH;
+    while (in + match_length < in_end && in[match_length] == match[match_length]) {
+      match_length++;
+    }
+
+    out = write_sequence(
+      out, out_end, literals, (int)(in - literals), (int)(in - match), match_length);
+    if (out == NULL) {
+      return -1;
+    }
+
+    in += match_length;
+    literals = in;
+
+    const int sequence_lead = (int)((in - in_start) - (out - out_start));
+    if (sequence_lead > lead) {
+      lead = sequence_lead;
+    }
+  }
+
+  out = write_sequence(out, out_end, literals, (int)(in_end - literals), 0, 0);
+  if (out == NULL) {
+    return -1;
+  }
+
+  const int size = (int)(out - out_start);
+  if (size + lead > nbyte + LINK_TRANSPORT_LZ_IN_PLACE_MARGIN) {
+    // the decoder would overwrite compressed data it hasn't read yet
+    return -1;
+  }
+
+  return size;
+}
+
+#endif
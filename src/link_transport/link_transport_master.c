@@ -96,6 +96,11 @@ int resolve_protocol(link_transport_mdriver_t *driver) {
   }
 
   if (driver->transport_version == 0) {
+    // a new slave needs to re-negotiate windowed transfers, CRC-32C and compression
+    driver->phy_driver.window_size = 0;
+    driver->phy_driver.is_crc32c = 0;
+    driver->phy_driver.is_lz = 0;
+
     // need to do protocol resolution starting with link1
     const int result = link1_transport_masterwrite(driver, 0, 0);
     if (result == 0) {
@@ -106,6 +111,12 @@ int resolve_protocol(link_transport_mdriver_t *driver) {
       if (nack == LINK2_PACKET_NACK) {
         // printf("------------------- Resolved to Link2 -------------------\n");
         driver->transport_version = 2;
+
+        const int link2_result = link2_transport_masternegotiate(driver);
+        if (link2_result < 0) {
+          driver->transport_version = 0;
+          return link2_result;
+        }
       } else if (nack == LINK3_PACKET_NACK) {
         // printf("------------------- Resolved to Link3 -------------------\n");
         driver->transport_version = 3;
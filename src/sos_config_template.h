@@ -18,6 +18,11 @@
 #define CONFIG_SCHED_DEFAULT_PRIORITY 0
 // duration is in milliseconds
 #define CONFIG_SCHED_RR_DURATION 10
+// stop the round robin tick when a task is alone at its priority or the system is idle
+#define CONFIG_SCHED_IS_TICKLESS 0
+// trace context switches, wakes, blocks and device events (read with I_SYS_GETSCHEDTRACE)
+#define CONFIG_SCHED_IS_TRACE 0
+#define CONFIG_SCHED_TRACE_COUNT 128
 
 // Task options
 // total number of threads (system and application)
@@ -30,6 +35,22 @@
 
 #define CONFIG_MALLOC_CHUNK_SIZE 32
 #define CONFIG_MALLOC_SBRK_JUMP_SIZE 128
+// keep free chunks in size-class lists for bounded time malloc() and free()
+#define CONFIG_MALLOC_IS_SEGREGATED 0
+// verify every chunk on free() (default when not segregated) or just the freed chunk's neighbors
+#define CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP 1
+// chunks verified per malloc()/free() by the incremental heap scrubber (0 to disable)
+#define CONFIG_MALLOC_SCRUB_CHUNKS 0
+// count heap use by task and call site and keep a free block histogram (adds a word per block)
+#define CONFIG_MALLOC_IS_PROFILE 0
+
+// open file handles kept in a static pool by assetfs and drive_assetfs (then malloc())
+#define CONFIG_SYSFS_HANDLE_POOL_COUNT 4
+
+// bytes for two blocks of batched sos_trace records sent from the idle loop (0 to send each event)
+#define CONFIG_TRACE_STREAM_SIZE 0
+// keep cycle histograms of kernel hot paths (read with I_SYS_GETPROBE)
+#define CONFIG_SYS_IS_PROBE 0
 
 // require a valid digital signature when installing applications
 #define CONFIG_APPFS_IS_VERIFY_SIGNATURE 1
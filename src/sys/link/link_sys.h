@@ -0,0 +1,171 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef LINK_SYS_H_
+#define LINK_SYS_H_
+
+/*
+ * The kernel services the link command handlers in link_thread.c use.
+ *
+ * On a board these are the kernel's own calls. The virtual device
+ * (test/link/vdevice) builds link_thread.c on the host with __link
+ * defined and implements the link_sys_*() calls against a host
+ * directory (DIR handles must fit in the 32-bits the protocol has for
+ * them) along with htoc(). link_sys_driver_fildes() is the descriptor
+ * the link itself uses which the host can't read, write or close.
+ *
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "sos/link.h"
+
+#if defined __link
+
+#include <unistd.h>
+
+#include "../../link/link_local.h"
+#include "cortexm/util.h"
+#include "sos/debug.h"
+
+// sos/debug.h prints every message on the host -- use the link library log instead
+#undef sos_debug_log_datum
+#undef sos_debug_log_directive
+#undef sos_debug_log_info
+#undef sos_debug_log_warning
+#undef sos_debug_log_error
+#define sos_debug_log_datum(o_flags, ...) link_debug(LINK_DEBUG_MESSAGE, __VA_ARGS__)
+#define sos_debug_log_directive(o_flags, ...)
+#define sos_debug_log_info(o_flags, ...) link_debug(LINK_DEBUG_INFO, __VA_ARGS__)
+#define sos_debug_log_warning(o_flags, ...) link_debug(LINK_DEBUG_WARNING, __VA_ARGS__)
+#define sos_debug_log_error(o_flags, ...) link_debug(LINK_DEBUG_ERROR, __VA_ARGS__)
+
+// glibc leaves ARG_MAX undefined
+#if !defined ARG_MAX
+#define ARG_MAX LINK_PATH_ARG_MAX
+#endif
+
+int link_sys_driver_fildes(const link_transport_driver_t *driver);
+int link_sys_open(const char *path, int flags, int mode);
+int link_sys_close(int fildes);
+int link_sys_read(int fildes, void *buf, int nbyte);
+int link_sys_write(int fildes, const void *buf, int nbyte);
+int link_sys_lseek(int fildes, int offset, int whence);
+int link_sys_ioctl(int fildes, int request, void *arg);
+int link_sys_fstat(int fildes, struct stat *st);
+int link_sys_stat(const char *path, struct stat *st);
+int link_sys_link(const char *old_path, const char *new_path);
+int link_sys_unlink(const char *path);
+int link_sys_rename(const char *old_path, const char *new_path);
+int link_sys_mkdir(const char *path, mode_t mode);
+int link_sys_rmdir(const char *path);
+int link_sys_chmod(const char *path, mode_t mode);
+int link_sys_chown(const char *path, uid_t uid, gid_t gid);
+DIR *link_sys_opendir(const char *path);
+int link_sys_readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result);
+int link_sys_closedir(DIR *dirp);
+void link_sys_seekdir(DIR *dirp, long loc);
+long link_sys_telldir(DIR *dirp);
+int link_sys_mkfs(const char *path);
+int link_sys_process_start(const char *path_arg, char *const envp[]);
+
+#else
+
+#include <unistd.h>
+
+#include "cortexm/util.h"
+
+#include "../process/process_start.h"
+#include "../scheduler/scheduler_local.h"
+
+#include "sos/debug.h"
+#include "sos/fs.h"
+#include "sos/sos.h"
+
+#include "trace.h"
+
+static inline int link_sys_driver_fildes(const link_transport_driver_t *driver) {
+  return driver->handle;
+}
+
+static inline int link_sys_open(const char *path, int flags, int mode) {
+  return open(path, flags, mode);
+}
+
+static inline int link_sys_close(int fildes) { return close(fildes); }
+
+static inline int link_sys_read(int fildes, void *buf, int nbyte) {
+  return read(fildes, buf, nbyte);
+}
+
+static inline int link_sys_write(int fildes, const void *buf, int nbyte) {
+  return write(fildes, buf, nbyte);
+}
+
+static inline int link_sys_lseek(int fildes, int offset, int whence) {
+  return lseek(fildes, offset, whence);
+}
+
+static inline int link_sys_ioctl(int fildes, int request, void *arg) {
+  return ioctl(fildes, request, arg);
+}
+
+static inline int link_sys_fstat(int fildes, struct stat *st) { return fstat(fildes, st); }
+
+static inline int link_sys_stat(const char *path, struct stat *st) {
+  return stat(path, st);
+}
+
+static inline int link_sys_link(const char *old_path, const char *new_path) {
+  return link(old_path, new_path);
+}
+
+static inline int link_sys_unlink(const char *path) { return unlink(path); }
+
+static inline int link_sys_rename(const char *old_path, const char *new_path) {
+  return rename(old_path, new_path);
+}
+
+static inline int link_sys_mkdir(const char *path, mode_t mode) {
+  return mkdir(path, mode);
+}
+
+static inline int link_sys_rmdir(const char *path) { return rmdir(path); }
+
+static inline int link_sys_chmod(const char *path, mode_t mode) {
+  return chmod(path, mode);
+}
+
+static inline int link_sys_chown(const char *path, uid_t uid, gid_t gid) {
+  return chown(path, uid, gid);
+}
+
+static inline DIR *link_sys_opendir(const char *path) { return opendir(path); }
+
+static inline int
+link_sys_readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result) {
+  return readdir_r(dirp, entry, result);
+}
+
+static inline int link_sys_closedir(DIR *dirp) { return closedir(dirp); }
+
+static inline void link_sys_seekdir(DIR *dirp, long loc) { seekdir(dirp, loc); }
+
+static inline long link_sys_telldir(DIR *dirp) { return telldir(dirp); }
+
+static inline int link_sys_mkfs(const char *path) { return mkfs(path); }
+
+static inline int link_sys_process_start(const char *path_arg, char *const envp[]) {
+  return process_start(path_arg, envp);
+}
+
+#endif
+
+// sos_config.sys.get_serial_number() (the kernel version is in link_thread.c)
+void link_sys_get_serial_number(mcu_sn_t *serial_number);
+
+// one command from the host (the body of the loop in link_update())
+void link_execute(link_transport_driver_t *driver, const link_op_t *op);
+
+#endif /* LINK_SYS_H_ */
@@ -13,17 +13,7 @@
 #include <stdbool.h>
 #include <sys/fcntl.h> //Defines the flags
 
-#include "cortexm/util.h"
-
-#include "../process/process_start.h"
-#include "../scheduler/scheduler_local.h"
-
-#include "sos/debug.h"
-#include "sos/fs.h"
-#include "sos/sos.h"
-
-#include "sos/link.h"
-#include "trace.h"
+#include "link_sys.h"
 
 #define SERIAL_NUM_WIDTH 3
 
@@ -50,6 +40,8 @@ typedef struct {
   link_reply_t reply;
 } link_data_t;
 
+static int accept_file_stream(link_transport_driver_t *driver, link_data_t *args);
+
 static void link_cmd_none(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_readserialno(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args);
@@ -72,6 +64,9 @@ static void link_cmd_chown(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_chmod(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_exec(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_mkfs(link_transport_driver_t *driver, link_data_t *args);
+static void link_cmd_readdir_bulk(link_transport_driver_t *driver, link_data_t *args);
+static void link_cmd_sendfile(link_transport_driver_t *driver, link_data_t *args);
+static void link_cmd_recvfile(link_transport_driver_t *driver, link_data_t *args);
 
 void (*const link_cmd_func_table[LINK_CMD_TOTAL])(
   link_transport_driver_t *,
@@ -81,13 +76,15 @@ void (*const link_cmd_func_table[LINK_CMD_TOTAL])(
   link_cmd_unlink,   link_cmd_lseek,        link_cmd_stat,    link_cmd_fstat,
   link_cmd_mkdir,    link_cmd_rmdir,        link_cmd_opendir, link_cmd_readdir,
   link_cmd_closedir, link_cmd_rename,       link_cmd_chown,   link_cmd_chmod,
-  link_cmd_exec,     link_cmd_mkfs};
+  link_cmd_exec,     link_cmd_mkfs,         link_cmd_readdir_bulk, link_cmd_sendfile,
+  link_cmd_recvfile};
 
+#if !defined __link
+// the virtual device reads each op itself and calls link_execute()
 void *link_update(void *arg) {
   int err;
   link_transport_driver_t *driver = arg;
-  link_data_t data;
-  data.op.cmd = 0;
+  link_op_t op;
 
   sos_debug_log_info(SOS_DEBUG_LINK, "Open link driver");
   if ((driver->handle = driver->open(NULL, 0)) == LINK_PHY_ERROR) {
@@ -107,10 +104,8 @@ void *link_update(void *arg) {
     // Wait for data to arrive on the link transport device
     while (1) {
 
-      if (
-        (err = link_transport_slaveread(driver, &data.op, sizeof(data.op), NULL, NULL))
-        <= 0) {
-        data.op = (link_op_t){};
+      if ((err = link_transport_slaveread(driver, &op, sizeof(op), NULL, NULL)) <= 0) {
+        op = (link_op_t){};
         //very fast USB drivers (STM32H735) have trouble without a short delay here
         //need to give the host a little time to react
         usleep(100);
@@ -119,26 +114,32 @@ void *link_update(void *arg) {
       }
       break;
     }
-    if (data.op.cmd < LINK_CMD_TOTAL) {
-      link_cmd_func_table[data.op.cmd](driver, &data);
-    } else {
-      data.reply.err = -1;
-      data.reply.err_number = EINVAL;
-    }
 
-    // send the reply
-    if (data.op.cmd != 0) {
-      sos_debug_log_datum(
-        SOS_DEBUG_LINK, "linkm:D->>H: Reply %d errno %d", data.reply.err,
-        data.reply.err_number);
-      link_transport_slavewrite(driver, &data.reply, sizeof(data.reply), NULL, NULL);
-      data.op.cmd = 0;
-    }
+    link_execute(driver, &op);
   }
 
   sos_debug_log_warning(SOS_DEBUG_LINK, "Link quit");
   return NULL;
 }
+#endif
+
+void link_execute(link_transport_driver_t *driver, const link_op_t *op) {
+  link_data_t data = {.op = *op};
+  if (data.op.cmd < LINK_CMD_TOTAL) {
+    link_cmd_func_table[data.op.cmd](driver, &data);
+  } else {
+    data.reply.err = -1;
+    data.reply.err_number = EINVAL;
+  }
+
+  // send the reply
+  if (data.op.cmd != 0) {
+    sos_debug_log_datum(
+      SOS_DEBUG_LINK, "linkm:D->>H: Reply %d errno %d", data.reply.err,
+      data.reply.err_number);
+    link_transport_slavewrite(driver, &data.reply, sizeof(data.reply), NULL, NULL);
+  }
+}
 
 void link_cmd_none(link_transport_driver_t *driver, link_data_t *args) {}
 
@@ -146,26 +147,31 @@ void link_cmd_isbootloader(link_transport_driver_t *driver, link_data_t *args) {
   args->reply.err = 0; // this is not the bootloader
 }
 
-static void svcall_get_serialno(void *dest) MCU_ROOT_EXEC_CODE;
-void svcall_get_serialno(void *dest) {
+#if !defined __link
+static void svcall_get_serial_number(void *dest) MCU_ROOT_EXEC_CODE;
+void svcall_get_serial_number(void *dest) {
   CORTEXM_SVCALL_ENTER();
-  mcu_sn_t serial_number;
-  int i, j;
-  char *p = dest;
-  sos_config.sys.get_serial_number(&serial_number);
-  for (j = SERIAL_NUM_WIDTH; j >= 0; j--) {
-    for (i = 0; i < 8; i++) {
-      *p++ = htoc((serial_number.sn[j] >> 28) & 0x0F);
-      serial_number.sn[j] <<= 4;
-    }
-  }
+  sos_config.sys.get_serial_number(dest);
 }
 
+void link_sys_get_serial_number(mcu_sn_t *serial_number) {
+  cortexm_svcall(svcall_get_serial_number, serial_number);
+}
+#endif
+
 void link_cmd_readserialno(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(SOS_DEBUG_LINK, "linkm:H->>D: read serial no");
   char serialno[LINK_PACKET_DATA_SIZE];
   memset(serialno, 0, LINK_PACKET_DATA_SIZE);
-  cortexm_svcall(svcall_get_serialno, serialno);
+  mcu_sn_t serial_number;
+  link_sys_get_serial_number(&serial_number);
+  char *p = serialno;
+  for (int j = SERIAL_NUM_WIDTH; j >= 0; j--) {
+    for (int i = 0; i < 8; i++) {
+      *p++ = htoc((serial_number.sn[j] >> 28) & 0x0F);
+      serial_number.sn[j] <<= 4;
+    }
+  }
 
   args->reply.err = strlen(serialno);
   args->reply.err_number = 0;
@@ -193,7 +199,7 @@ void link_cmd_open(link_transport_driver_t *driver, link_data_t *args) {
   }
 
   sos_debug_log_datum(SOS_DEBUG_LINK, "linkm:H->>D: open %s", path);
-  args->reply.err = open(path, args->op.open.flags, args->op.open.mode);
+  args->reply.err = link_sys_open(path, args->op.open.flags, args->op.open.mode);
   if (args->reply.err < 0) {
     sos_debug_log_error(SOS_DEBUG_LINK, "Failed to open %s (%d)", path, errno);
     args->reply.err_number = errno;
@@ -214,7 +220,7 @@ void link_cmd_link(link_transport_driver_t *driver, link_data_t *args) {
   }
 
   sos_debug_log_datum(SOS_DEBUG_LINK, "linkm:H->>D: link %s %s", old_path, new_path);
-  args->reply.err = link(old_path, new_path);
+  args->reply.err = link_sys_link(old_path, new_path);
   if (args->reply.err < 0) {
     sos_debug_log_error(SOS_DEBUG_LINK, "Failed to link %s (%d)", old_path, errno);
     args->reply.err_number = errno;
@@ -237,14 +243,16 @@ void link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: ioctl %d 0x%08x", args->op.ioctl.fildes,
     args->op.ioctl.request);
-  if (args->op.ioctl.fildes != driver->handle) {
+  if (args->op.ioctl.fildes != link_sys_driver_fildes(driver)) {
     if (_IOCTL_IOCTLRW(args->op.ioctl.request) == 0) {
       // This means the third argument is just an integer
       args->reply.err =
-        ioctl(args->op.ioctl.fildes, args->op.ioctl.request, args->op.ioctl.arg);
+        link_sys_ioctl(
+          args->op.ioctl.fildes, args->op.ioctl.request, (void *)(size_t)args->op.ioctl.arg);
     } else {
       // This means a read or write is happening and the pointer should be passed
-      args->reply.err = ioctl(args->op.ioctl.fildes, args->op.ioctl.request, io_buf);
+      args->reply.err =
+        link_sys_ioctl(args->op.ioctl.fildes, args->op.ioctl.request, io_buf);
     }
     args->reply.err_number = errno;
   } else {
@@ -274,7 +282,7 @@ void link_cmd_read(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: read fd=%d size=%d", args->op.read.fildes,
     args->op.read.nbyte);
-  if (args->op.read.fildes != driver->handle) {
+  if (args->op.read.fildes != link_sys_driver_fildes(driver)) {
     errno = 0;
     args->reply.err = read_device(driver, args->op.read.fildes, args->op.read.nbyte);
   } else {
@@ -291,7 +299,7 @@ void link_cmd_write(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: write fd=%d size=%d", args->op.write.fildes,
     args->op.write.nbyte);
-  if (args->op.write.fildes != driver->handle) {
+  if (args->op.write.fildes != link_sys_driver_fildes(driver)) {
     errno = 0;
     args->reply.err = write_device(driver, args->op.write.fildes, args->op.write.nbyte);
   } else {
@@ -308,8 +316,8 @@ void link_cmd_write(link_transport_driver_t *driver, link_data_t *args) {
 
 void link_cmd_close(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(SOS_DEBUG_LINK, "linkm:H->>D: close fd=%d", args->op.write.fildes);
-  if (args->op.ioctl.fildes != driver->handle) {
-    args->reply.err = close(args->op.close.fildes);
+  if (args->op.ioctl.fildes != link_sys_driver_fildes(driver)) {
+    args->reply.err = link_sys_close(args->op.close.fildes);
   } else {
     args->reply.err = -1;
     args->reply.err_number = EBADF;
@@ -327,7 +335,7 @@ void link_cmd_unlink(link_transport_driver_t *driver, link_data_t *args) {
     return;
   }
   sos_debug_log_datum(SOS_DEBUG_LINK, "linkm:H->>D: unlink %s", path);
-  args->reply.err = unlink(path);
+  args->reply.err = link_sys_unlink(path);
   if (args->reply.err < 0) {
     sos_debug_log_error(SOS_DEBUG_LINK, "Failed to unlink (%d)", errno);
     args->reply.err_number = errno;
@@ -339,7 +347,7 @@ void link_cmd_lseek(link_transport_driver_t *driver, link_data_t *args) {
     SOS_DEBUG_LINK, "linkm:H->>D: lseek fd=%d whence=%d offset=%d", args->op.lseek.fildes,
     args->op.lseek.whence, args->op.lseek.offset);
   args->reply.err =
-    lseek(args->op.lseek.fildes, args->op.lseek.offset, args->op.lseek.whence);
+    link_sys_lseek(args->op.lseek.fildes, args->op.lseek.offset, args->op.lseek.whence);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -357,7 +365,7 @@ void link_cmd_stat(link_transport_driver_t *driver, link_data_t *args) {
   }
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: stat %s", path);
-  args->reply.err = stat(path, &st);
+  args->reply.err = link_sys_stat(path, &st);
   if (args->reply.err < 0) {
     sos_debug_log_datum(
       SOS_DEBUG_LINK, "linkm:D->>H: failed");
@@ -393,7 +401,7 @@ void link_cmd_fstat(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: fstat fd=%d", args->op.fstat.fildes);
 
-  args->reply.err = fstat(args->op.fstat.fildes, (struct stat *)&st);
+  args->reply.err = link_sys_fstat(args->op.fstat.fildes, (struct stat *)&st);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -424,7 +432,7 @@ void link_cmd_mkdir(link_transport_driver_t *driver, link_data_t *args) {
 
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: mkdir %s 0%o", path, args->op.mkdir.mode);
-  args->reply.err = mkdir(path, args->op.mkdir.mode);
+  args->reply.err = link_sys_mkdir(path, args->op.mkdir.mode);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -438,7 +446,7 @@ void link_cmd_rmdir(link_transport_driver_t *driver, link_data_t *args) {
   }
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: rmdir %s", path);
-  args->reply.err = rmdir(path);
+  args->reply.err = link_sys_rmdir(path);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -453,7 +461,7 @@ void link_cmd_opendir(link_transport_driver_t *driver, link_data_t *args) {
 
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: opendir %s", path);
-  args->reply.err = (int)opendir(path);
+  args->reply.err = (int)(size_t)link_sys_opendir(path);
   if (args->reply.err == 0) {
     sos_debug_log_error(SOS_DEBUG_LINK, "Failed to open dir %s (%d)", path, errno);
     args->reply.err_number = errno;
@@ -467,7 +475,7 @@ void link_cmd_readdir(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: readdir dirp=%p", args->op.readdir.dirp);
 
-  args->reply.err = readdir_r((DIR *)args->op.readdir.dirp, &de, NULL);
+  args->reply.err = link_sys_readdir_r((DIR *)(size_t)args->op.readdir.dirp, &de, NULL);
 
   if (args->reply.err < 0) {
     args->reply.err = -1;
@@ -502,10 +510,145 @@ void link_cmd_readdir(link_transport_driver_t *driver, link_data_t *args) {
   link_transport_slavewrite(driver, &lde, sizeof(struct link_dirent), NULL, NULL);
 }
 
+// streams the entries that link_cmd_readdir_bulk() counted one packet at a time
+typedef struct {
+  DIR *dirp;
+  u16 count;
+  u8 offset;
+  u8 size;
+  u8 entry[sizeof(link_readdir_bulk_entry_t) + LINK_NAME_MAX_LARGE];
+} readdir_bulk_stream_t;
+
+static int read_readdir_bulk_entry(
+  DIR *dirp,
+  u32 *d_ino,
+  char *d_name,
+  u8 *d_name_size) {
+  struct dirent de;
+  if (link_sys_readdir_r(dirp, &de, NULL) < 0) {
+    return -1;
+  }
+  *d_ino = de.d_ino;
+  *d_name_size = strnlen(de.d_name, LINK_NAME_MAX_LARGE);
+  if (d_name != NULL) {
+    memcpy(d_name, de.d_name, *d_name_size);
+  }
+  return 0;
+}
+
+static int readdir_bulk_callback(void *context, void *buf, int nbyte) {
+  readdir_bulk_stream_t *stream = context;
+  u8 *dest = buf;
+  int bytes = 0;
+
+  while (bytes < nbyte) {
+    if (stream->offset == stream->size) {
+      link_readdir_bulk_entry_t entry = {};
+      char *name = (char *)stream->entry + sizeof(entry);
+      u32 d_ino;
+      u8 name_size;
+      if (
+        (stream->count == 0)
+        || (read_readdir_bulk_entry(stream->dirp, &d_ino, name, &name_size) < 0)) {
+        // the directory changed since the entries were counted -- pad to the size sent
+        memset(dest + bytes, 0, nbyte - bytes);
+        return nbyte;
+      }
+      entry.d_ino = d_ino;
+      entry.d_name_size = name_size;
+      memcpy(stream->entry, &entry, sizeof(entry));
+      stream->size = sizeof(entry) + name_size;
+      stream->offset = 0;
+      stream->count--;
+    }
+
+    int chunk = stream->size - stream->offset;
+    if (chunk > nbyte - bytes) {
+      chunk = nbyte - bytes;
+    }
+    memcpy(dest + bytes, stream->entry + stream->offset, chunk);
+    stream->offset += chunk;
+    bytes += chunk;
+  }
+  return bytes;
+}
+
+void link_cmd_readdir_bulk(link_transport_driver_t *driver, link_data_t *args) {
+  DIR *dirp = (DIR *)(size_t)args->op.readdir_bulk.dirp;
+  link_readdir_bulk_reply_t reply = {};
+  u32 size = 0;
+
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:H->>D: readdir bulk dirp=%p loc=%d", dirp,
+    args->op.readdir_bulk.loc);
+
+  const u32 capacity = args->op.readdir_bulk.nbyte < LINK_READDIR_BULK_MAX
+                         ? args->op.readdir_bulk.nbyte
+                         : LINK_READDIR_BULK_MAX;
+
+  errno = 0;
+  if (args->op.readdir_bulk.loc >= 0) {
+    link_sys_seekdir(dirp, args->op.readdir_bulk.loc);
+  }
+  const long start_loc = link_sys_telldir(dirp);
+
+  // count what fits first so the reply can go ahead of the entries
+  while (1) {
+    u32 d_ino;
+    u8 name_size;
+    const long loc = link_sys_telldir(dirp);
+    if (read_readdir_bulk_entry(dirp, &d_ino, NULL, &name_size) < 0) {
+      if (errno == ENOENT) {
+        reply.is_end = 1;
+      } else if (reply.count == 0) {
+        sos_debug_log_error(SOS_DEBUG_LINK, "Failed to read dir (%d)", errno);
+        reply.err = -1;
+        reply.err_number = errno;
+      }
+      break;
+    }
+
+    if (size + sizeof(link_readdir_bulk_entry_t) + name_size > capacity) {
+      // this one goes in the next transfer
+      link_sys_seekdir(dirp, loc);
+      break;
+    }
+
+    size += sizeof(link_readdir_bulk_entry_t) + name_size;
+    reply.count++;
+  }
+
+  if (reply.err == 0) {
+    reply.err = size;
+  }
+  reply.loc = link_sys_telldir(dirp);
+
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:D->>H: %d entries end=%d", reply.count, reply.is_end);
+
+  // the reply is sent here rather than by link_update()
+  args->op.cmd = 0;
+
+  if (link_transport_slavewrite(driver, &reply, sizeof(reply), NULL, NULL) < 0) {
+    return;
+  }
+
+  if (reply.err <= 0) {
+    return;
+  }
+
+  // read the entries again as they are sent rather than holding them all
+  readdir_bulk_stream_t stream = {.dirp = dirp, .count = reply.count};
+  link_sys_seekdir(dirp, start_loc);
+  BETWEEN_LINK_WRITE_DELAY();
+  link_transport_slavewrite(driver, NULL, size, readdir_bulk_callback, &stream);
+  link_sys_seekdir(dirp, reply.loc);
+}
+
 void link_cmd_closedir(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: closedir dirp=%p", args->op.closedir.dirp);
-  args->reply.err = closedir((DIR *)args->op.closedir.dirp);
+  args->reply.err = link_sys_closedir((DIR *)(size_t)args->op.closedir.dirp);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -527,7 +670,7 @@ void link_cmd_rename(link_transport_driver_t *driver, link_data_t *args) {
 
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: rename %s to %s", old_path, new_path);
-  args->reply.err = rename(old_path, new_path);
+  args->reply.err = link_sys_rename(old_path, new_path);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -543,7 +686,7 @@ void link_cmd_chown(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: chown %s uid=%d gid=%d", path, args->op.chown.uid, args->op.chown.gid);
 
-  args->reply.err = chown(path, args->op.chown.uid, args->op.chown.gid);
+  args->reply.err = link_sys_chown(path, args->op.chown.uid, args->op.chown.gid);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -559,7 +702,7 @@ void link_cmd_chmod(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: chmod %s mode=0%o gid=%d", path, args->op.chmod.mode);
 
-  args->reply.err = chmod(path, args->op.chmod.mode);
+  args->reply.err = link_sys_chmod(path, args->op.chmod.mode);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   }
@@ -578,7 +721,7 @@ void link_cmd_exec(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: exec %s", path_arg);
 
-  args->reply.err = process_start(path_arg, NULL);
+  args->reply.err = link_sys_process_start(path_arg, NULL);
   if (args->reply.err < 0) {
     sos_debug_log_error(SOS_DEBUG_LINK, "Failed to exec %s (%d)", path_arg, errno);
     args->reply.err_number = errno;
@@ -606,7 +749,7 @@ void link_cmd_mkfs(link_transport_driver_t *driver, link_data_t *args) {
   sos_debug_log_datum(
     SOS_DEBUG_LINK, "linkm:H->>D: mkfs %s", path);
 
-  args->reply.err = mkfs(path);
+  args->reply.err = link_sys_mkfs(path);
   if (args->reply.err < 0) {
     args->reply.err_number = errno;
   } else {
@@ -614,11 +757,123 @@ void link_cmd_mkfs(link_transport_driver_t *driver, link_data_t *args) {
   }
 }
 
+void link_cmd_sendfile(link_transport_driver_t *driver, link_data_t *args) {
+  char path[PATH_MAX + 1];
+  if (accept_file_stream(driver, args) < 0) {
+    return;
+  }
+
+  if (read_path(driver, path, args->op.sendfile.path_size, PATH_MAX) < 0) {
+    driver->flush(driver->handle);
+    args->reply.err = -1;
+    args->reply.err_number = EINVAL;
+    return;
+  }
+
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:H->>D: sendfile %s offset=%d size=%d", path,
+    args->op.sendfile.offset, args->op.sendfile.nbyte);
+
+  errno = 0;
+  int fildes =
+    link_sys_open(path, (args->op.sendfile.flags & ~O_ACCMODE) | O_WRONLY, 0666);
+  int error_number = errno;
+  if (fildes >= 0 && args->op.sendfile.offset > 0) {
+    if (link_sys_lseek(fildes, args->op.sendfile.offset, SEEK_SET) < 0) {
+      error_number = errno;
+      link_sys_close(fildes);
+      fildes = -1;
+    }
+  }
+
+  // each packet is written to the file as it arrives -- if the file could
+  // not be opened, the first packet is NACK'd which ends the stream
+  args->reply.err = write_device(driver, fildes, args->op.sendfile.nbyte);
+  if (fildes < 0) {
+    args->reply.err = -1;
+    args->reply.err_number = error_number;
+  } else {
+    if (args->reply.err < 0) {
+      args->reply.err_number = errno;
+    }
+    if (link_sys_close(fildes) < 0 && args->reply.err >= 0) {
+      args->reply.err = -1;
+      args->reply.err_number = errno;
+    }
+  }
+
+  if (args->reply.err < 0) {
+    sos_debug_log_error(
+      SOS_DEBUG_LINK, "Failed to sendfile %s (%d)", path, args->reply.err_number);
+  }
+}
+
+void link_cmd_recvfile(link_transport_driver_t *driver, link_data_t *args) {
+  char path[PATH_MAX + 1];
+  if (accept_file_stream(driver, args) < 0) {
+    return;
+  }
+
+  if (read_path(driver, path, args->op.recvfile.path_size, PATH_MAX) < 0) {
+    driver->flush(driver->handle);
+    args->reply.err = -1;
+    args->reply.err_number = EINVAL;
+    return;
+  }
+
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:H->>D: recvfile %s offset=%d size=%d", path,
+    args->op.recvfile.offset, args->op.recvfile.nbyte);
+
+  errno = 0;
+  int fildes = link_sys_open(path, O_RDONLY, 0);
+  if (fildes >= 0 && args->op.recvfile.offset > 0) {
+    if (link_sys_lseek(fildes, args->op.recvfile.offset, SEEK_SET) < 0) {
+      const int error_number = errno;
+      link_sys_close(fildes);
+      fildes = -1;
+      errno = error_number;
+    }
+  }
+
+  if (fildes < 0) {
+    // an empty packet ends the stream -- the reply carries the error
+    args->reply.err = -1;
+    args->reply.err_number = errno;
+    link_transport_slavewrite(driver, NULL, 0, NULL, NULL);
+  } else {
+    // the file is read straight into each packet -- a short read ends the stream
+    args->reply.err = read_device(driver, fildes, args->op.recvfile.nbyte);
+    if (args->reply.err < 0) {
+      args->reply.err_number = errno;
+    }
+    link_sys_close(fildes);
+  }
+
+  if (args->reply.err < 0) {
+    sos_debug_log_error(
+      SOS_DEBUG_LINK, "Failed to recvfile %s (%d)", path, args->reply.err_number);
+  }
+}
+
+int accept_file_stream(link_transport_driver_t *driver, link_data_t *args) {
+  // older devices reply EINVAL to unknown commands -- this tells the host
+  // the command is supported and it can send the path
+  link_reply_t reply = {.err = 0, .err_number = 0};
+  args->reply.err = 0;
+  args->reply.err_number = 0;
+  if (link_transport_slavewrite(driver, &reply, sizeof(reply), NULL, NULL) < 0) {
+    args->op.cmd = 0;
+    return -1;
+  }
+  return 0;
+}
+
 int read_device_callback(void *context, void *buf, int nbyte) {
   int *fildes;
   int ret;
   fildes = context;
-  ret = read(*fildes, buf, nbyte);
+  ret = link_sys_read(*fildes, buf, nbyte);
   return ret;
 }
 
@@ -626,7 +881,7 @@ int write_device_callback(void *context, void *buf, int nbyte) {
   int *fildes;
   int ret;
   fildes = context;
-  ret = write(*fildes, buf, nbyte);
+  ret = link_sys_write(*fildes, buf, nbyte);
   return ret;
 }
 
@@ -7,11 +7,17 @@
 #include <sys/types.h>
 #include <string.h>
 
+#include "sys/malloc/malloc_local.h"
+
 void * _calloc_r(struct _reent * reent_ptr, size_t s1, size_t s2){
+	return malloc_allocate_cleared_r(reent_ptr, s1, s2, MALLOC_CALL_SITE());
+}
+
+void * malloc_allocate_cleared_r(struct _reent * reent_ptr, size_t s1, size_t s2, u32 site){
 	int size;
 	void * alloc;
 	size = s1*s2;
-	alloc = _malloc_r(reent_ptr, size);
+	alloc = malloc_allocate_r(reent_ptr, size, site);
 	if ( alloc != NULL ){
 		memset(alloc, 0, size);
 	}
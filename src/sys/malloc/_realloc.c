@@ -3,6 +3,10 @@
 #include "sys/malloc/malloc_local.h"
 
 void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
+  return malloc_reallocate_r(reent_ptr, addr, size, MALLOC_CALL_SITE());
+}
+
+void *malloc_reallocate_r(struct _reent *reent_ptr, void *addr, size_t size, u32 site) {
 
   if (reent_ptr == NULL) {
     errno = EINVAL;
@@ -17,7 +21,7 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
   }
 
   if (addr == NULL) {
-    return _malloc_r(reent_ptr, size);
+    return malloc_allocate_r(reent_ptr, size, site);
   }
 
   __malloc_lock(reent_ptr);
@@ -29,7 +33,7 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
     return NULL;
   }
 
-  const u16 num_chunks_requested = malloc_calc_num_chunks(size);
+  const u16 num_chunks_requested = malloc_calc_num_chunks(size + MALLOC_PROFILE_TAG_SIZE);
   // Check to see if current memory can be resized
   malloc_chunk_t * chunk = malloc_chunk_from_addr(addr);
 
@@ -43,7 +47,9 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
   // check to see if new chunk count is less than or equal to current count
 
   if (num_chunks_requested == chunk->header.num_chunks) {
+    malloc_profile_release(malloc_get_heap(reent_ptr), chunk);
     malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
+    malloc_profile_allocate(malloc_get_heap(reent_ptr), chunk, site);
     __malloc_unlock(reent_ptr);
     return addr;
   }
@@ -51,9 +57,11 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
   malloc_chunk_t *next = NULL;
   if (num_chunks_requested < chunk->header.num_chunks) {
     const u16 free_chunks_next = chunk->header.num_chunks - num_chunks_requested;
+    malloc_profile_release(malloc_get_heap(reent_ptr), chunk);
     malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
+    malloc_profile_allocate(malloc_get_heap(reent_ptr), chunk, site);
     next = chunk + num_chunks_requested;
-    malloc_set_chunk_free(next, free_chunks_next);
+    malloc_release_chunks(reent_ptr, next, free_chunks_next);
     __malloc_unlock(reent_ptr);
     return addr;
   }
@@ -64,13 +72,19 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
                                                                         // chunk is free
     const u16 free_chunks_with_next = next->header.num_chunks + chunk->header.num_chunks;
     if (num_chunks_requested < free_chunks_with_next) {
+      malloc_profile_release(malloc_get_heap(reent_ptr), chunk);
+      malloc_claim_free_chunk(reent_ptr, chunk, next);
       malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
+      malloc_profile_allocate(malloc_get_heap(reent_ptr), chunk, site);
       next = chunk + chunk->header.num_chunks;
-      malloc_set_chunk_free(next, free_chunks_with_next - num_chunks_requested);
+      malloc_release_chunks(reent_ptr, next, free_chunks_with_next - num_chunks_requested);
       __malloc_unlock(reent_ptr);
       return addr;
     } else if (free_chunks_with_next == num_chunks_requested) {
+      malloc_profile_release(malloc_get_heap(reent_ptr), chunk);
+      malloc_claim_free_chunk(reent_ptr, chunk, next);
       malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
+      malloc_profile_allocate(malloc_get_heap(reent_ptr), chunk, site);
       __malloc_unlock(reent_ptr);
       return addr;
     }
@@ -78,7 +92,7 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
 
   __malloc_unlock(reent_ptr);
 
-  void * alloc = _malloc_r(reent_ptr, size);
+  void * alloc = malloc_allocate_r(reent_ptr, size, site);
 
   if (alloc != NULL) {
     chunk = malloc_chunk_from_addr(addr);
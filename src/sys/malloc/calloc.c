@@ -55,6 +55,8 @@ Supporting OS subroutines required: <<close>>, <<fstat>>, <<isatty>>,
 #include <string.h>
 #include <stdlib.h>
 
+#include "sys/malloc/malloc_local.h"
+
 #ifndef _REENT_ONLY
 
 _PTR
@@ -62,7 +64,7 @@ _DEFUN (calloc, (n, size),
 	size_t n _AND
 	size_t size)
 {
-  return _calloc_r (_GLOBAL_REENT, n, size);
+  return malloc_allocate_cleared_r (_GLOBAL_REENT, n, size, MALLOC_CALL_SITE());
 }
 
 #endif
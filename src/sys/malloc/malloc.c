@@ -206,13 +206,15 @@ Supporting OS subroutines required: <<sbrk>>.  */
 #include <stdlib.h>
 #include <malloc.h>
 
+#include "sys/malloc/malloc_local.h"
+
 #ifndef _REENT_ONLY
 
 _PTR
 _DEFUN (malloc, (nbytes),
 	size_t nbytes)		/* get a block */
 {
-  return _malloc_r (_GLOBAL_REENT, nbytes);
+  return malloc_allocate_r (_GLOBAL_REENT, nbytes, MALLOC_CALL_SITE());
 }
 
 void
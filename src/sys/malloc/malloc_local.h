@@ -16,6 +16,10 @@
 
 #include "cortexm/task.h"
 
+#if CONFIG_MALLOC_IS_PROFILE
+#include "sos/dev/sys.h"
+#endif
+
 typedef struct MCU_PACK {
   u16 task_id;
   u16 num_chunks;
@@ -30,6 +34,59 @@ typedef struct {
   char memory[MALLOC_DATA_SIZE];
 } malloc_chunk_t;
 
+#if CONFIG_MALLOC_IS_SEGREGATED
+#define MALLOC_SEGREGATED_CLASS_COUNT 31
+
+typedef struct {
+  u32 bitmap;
+  malloc_chunk_t *last;
+  malloc_chunk_t *list[MALLOC_SEGREGATED_CLASS_COUNT];
+} malloc_segregated_t;
+#endif
+
+#if CONFIG_MALLOC_IS_PROFILE
+// allocations end with a word that holds their task and call site indices
+#define MALLOC_PROFILE_TAG_SIZE sizeof(u32)
+#define MALLOC_CALL_SITE() ((u32)__builtin_return_address(0))
+
+typedef struct {
+  u32 used_size;
+  u32 used_count;
+  u32 alloc_count;
+  u32 free_count;
+  u32 fail_count;
+  u32 free_block_count[SYS_HEAP_PROFILE_BUCKET_COUNT];
+  u32 free_block_chunks[SYS_HEAP_PROFILE_BUCKET_COUNT];
+  sys_heap_usage_t task[SYS_HEAP_PROFILE_TASK_COUNT];
+  sys_heap_usage_t site[SYS_HEAP_PROFILE_SITE_COUNT];
+} malloc_profile_t;
+#else
+#define MALLOC_PROFILE_TAG_SIZE 0
+#define MALLOC_CALL_SITE() 0
+#endif
+
+// The first (task 0) chunk of each heap holds malloc_heap_t when the allocator keeps
+// state per heap. Plain first-fit heaps (the default) don't give up a chunk for it.
+#define MALLOC_IS_HEAP_HEADER                                                            \
+  (CONFIG_MALLOC_IS_SEGREGATED || (CONFIG_MALLOC_SCRUB_CHUNKS > 0)                       \
+   || CONFIG_MALLOC_IS_PROFILE)
+
+#if MALLOC_IS_HEAP_HEADER
+typedef struct {
+  malloc_chunk_t *scrub_chunk;
+  u32 scrub_check_count;
+  u32 scrub_pass_count;
+  u32 neighbor_check_count;
+  u32 heap_check_count;
+#if CONFIG_MALLOC_IS_SEGREGATED
+  malloc_segregated_t segregated;
+#endif
+#if CONFIG_MALLOC_IS_PROFILE
+  malloc_profile_t profile;
+#endif
+} malloc_heap_t;
+#endif
+
 void malloc_set_chunk_used(
   struct _reent *reent,
   malloc_chunk_t *chunk,
@@ -41,8 +98,59 @@ u16 malloc_calc_num_chunks(u32 size);
 malloc_chunk_t *malloc_chunk_from_addr(void *addr);
 
 int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap);
+#if MALLOC_IS_HEAP_HEADER
+malloc_heap_t *malloc_get_heap(struct _reent *reent_ptr);
+#endif
+void malloc_merge_chunk(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  malloc_chunk_t *merged_chunk);
+void malloc_release_chunks(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u16 num_chunks);
+void malloc_claim_free_chunk(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  malloc_chunk_t *free_chunk);
+
+#if CONFIG_MALLOC_IS_SEGREGATED
+void malloc_segregated_extend(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u16 num_chunks);
+void malloc_segregated_release(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u16 num_chunks);
+malloc_chunk_t *malloc_segregated_take(struct _reent *reent_ptr, u16 num_chunks);
+void malloc_segregated_claim(struct _reent *reent_ptr, malloc_chunk_t *chunk);
+malloc_chunk_t *malloc_segregated_take_last(struct _reent *reent_ptr);
+#endif
 
+#if CONFIG_MALLOC_IS_PROFILE
+void malloc_profile_allocate(malloc_heap_t *heap, malloc_chunk_t *chunk, u32 site);
+void malloc_profile_release(malloc_heap_t *heap, malloc_chunk_t *chunk);
+void malloc_profile_fail(struct _reent *reent_ptr);
+void malloc_profile_insert_free(malloc_heap_t *heap, u16 num_chunks);
+void malloc_profile_remove_free(malloc_heap_t *heap, u16 num_chunks);
+u32 malloc_profile_get_largest_free_size(const malloc_heap_t *heap);
+int malloc_get_profile(struct _reent *reent_ptr, sys_heap_profile_t *profile);
+#else
+#define malloc_profile_allocate(heap, chunk, site)
+#define malloc_profile_release(heap, chunk)
+#define malloc_profile_fail(reent_ptr)
+#define malloc_profile_insert_free(heap, num_chunks)
+#define malloc_profile_remove_free(heap, num_chunks)
+#endif
 
+void *malloc_allocate_r(struct _reent *reent_ptr, size_t size, u32 site);
+void *malloc_allocate_cleared_r(
+  struct _reent *reent_ptr,
+  size_t count,
+  size_t size,
+  u32 site);
+void *malloc_reallocate_r(struct _reent *reent_ptr, void *addr, size_t size, u32 site);
 void malloc_free_task_r(struct _reent *reent_ptr, int task_id);
 
 void __malloc_lock(struct _reent *ptr);
@@ -0,0 +1,154 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*
+ * Allocation profiler (CONFIG_MALLOC_IS_PROFILE).
+ *
+ * The counters live in the heap header (malloc_heap_t) and are updated
+ * as blocks change state so reading them never walks the heap. Each
+ * allocation ends with a tag word that holds the index of its task and
+ * call site entries so free() can update them without a search.
+ *
+ * Free blocks are counted in log2 buckets of their chunk count. In
+ * first-fit mode adjacent free chunks that have not been merged yet are
+ * counted as separate blocks, which is how the allocator sees them.
+ */
+
+#include "cortexm/cortexm.h"
+#include "sys/malloc/malloc_local.h"
+
+#if CONFIG_MALLOC_IS_PROFILE
+
+static u32 *get_tag(malloc_chunk_t *chunk) {
+  return ((u32 *)(chunk + chunk->header.num_chunks)) - 1;
+}
+
+static int get_bucket(u16 num_chunks) { return 31 - __CLZ(num_chunks); }
+
+static u16 get_usage_index(sys_heap_usage_t *usage, int count, u32 id) {
+  // entries are taken in order and never given back
+  for (int i = 0; i < count - 1; i++) {
+    if (usage[i].total_count == 0) {
+      usage[i].id = id;
+      return i;
+    }
+    if (usage[i].id == id) {
+      return i;
+    }
+  }
+  usage[count - 1].id = SYS_HEAP_PROFILE_ID_OTHER;
+  return count - 1;
+}
+
+static u16 add_usage(sys_heap_usage_t *usage, int count, u32 id, u32 size) {
+  const u16 index = get_usage_index(usage, count, id);
+  usage[index].size += size;
+  usage[index].count++;
+  usage[index].total_count++;
+  return index;
+}
+
+static void remove_usage(sys_heap_usage_t *usage, int count, u16 index, u32 size) {
+  if (index >= count) {
+    // the caller wrote past the end of the block
+    index = count - 1;
+  }
+  usage[index].size -= size;
+  usage[index].count--;
+}
+
+void malloc_profile_allocate(malloc_heap_t *heap, malloc_chunk_t *chunk, u32 site) {
+  malloc_profile_t *profile = &heap->profile;
+  const u32 size = chunk->header.actual_size;
+  const u16 task_index =
+    add_usage(profile->task, SYS_HEAP_PROFILE_TASK_COUNT, chunk->header.task_id, size);
+  const u16 site_index = add_usage(profile->site, SYS_HEAP_PROFILE_SITE_COUNT, site, size);
+  *get_tag(chunk) = (task_index << 16) | site_index;
+  profile->used_size += size;
+  profile->used_count++;
+  profile->alloc_count++;
+}
+
+void malloc_profile_release(malloc_heap_t *heap, malloc_chunk_t *chunk) {
+  malloc_profile_t *profile = &heap->profile;
+  const u32 size = chunk->header.actual_size;
+  const u32 tag = *get_tag(chunk);
+  remove_usage(profile->task, SYS_HEAP_PROFILE_TASK_COUNT, tag >> 16, size);
+  remove_usage(profile->site, SYS_HEAP_PROFILE_SITE_COUNT, tag & 0xffff, size);
+  profile->used_size -= size;
+  profile->used_count--;
+  profile->free_count++;
+}
+
+void malloc_profile_fail(struct _reent *reent_ptr) {
+  if (reent_ptr->procmem_base->size > 0) {
+    malloc_get_heap(reent_ptr)->profile.fail_count++;
+  }
+}
+
+void malloc_profile_insert_free(malloc_heap_t *heap, u16 num_chunks) {
+  const int bucket = get_bucket(num_chunks);
+  heap->profile.free_block_count[bucket]++;
+  heap->profile.free_block_chunks[bucket] += num_chunks;
+}
+
+void malloc_profile_remove_free(malloc_heap_t *heap, u16 num_chunks) {
+  const int bucket = get_bucket(num_chunks);
+  heap->profile.free_block_count[bucket]--;
+  heap->profile.free_block_chunks[bucket] -= num_chunks;
+}
+
+u32 malloc_profile_get_largest_free_size(const malloc_heap_t *heap) {
+  const malloc_profile_t *profile = &heap->profile;
+  for (int bucket = SYS_HEAP_PROFILE_BUCKET_COUNT - 1; bucket >= 0; bucket--) {
+    const u32 count = profile->free_block_count[bucket];
+    if (count) {
+      // the other blocks in the bucket have at least 2^bucket chunks each
+      u32 largest = profile->free_block_chunks[bucket] - (count - 1) * (1 << bucket);
+      if (largest > (2U << bucket) - 1) {
+        largest = (2U << bucket) - 1;
+      }
+      return largest * CONFIG_MALLOC_CHUNK_SIZE;
+    }
+  }
+  return 0;
+}
+
+int malloc_get_profile(struct _reent *reent_ptr, sys_heap_profile_t *profile) {
+  const u32 pid = profile->pid;
+  if (
+    (reent_ptr == NULL) || (reent_ptr->procmem_base == NULL)
+    || (reent_ptr->procmem_base->size == 0)) {
+    return -1;
+  }
+
+  // this may run outside the process so check the header without faulting
+  malloc_chunk_t *first = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+  if (
+    (cortexm_verify_zero_sum32(first, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t))
+     == 0)
+    || (first->header.actual_size != sizeof(malloc_heap_t))) {
+    return -1;
+  }
+
+  const malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  *profile = (sys_heap_profile_t){};
+  profile->pid = pid;
+  profile->chunk_size = CONFIG_MALLOC_CHUNK_SIZE;
+  profile->heap_size = reent_ptr->procmem_base->size;
+  profile->used_size = heap->profile.used_size;
+  profile->used_count = heap->profile.used_count;
+  profile->alloc_count = heap->profile.alloc_count;
+  profile->free_count = heap->profile.free_count;
+  profile->fail_count = heap->profile.fail_count;
+  for (int i = 0; i < SYS_HEAP_PROFILE_BUCKET_COUNT; i++) {
+    profile->free_block_count[i] = heap->profile.free_block_count[i];
+    profile->free_block_chunks[i] = heap->profile.free_block_chunks[i];
+    profile->free_size += heap->profile.free_block_chunks[i] * CONFIG_MALLOC_CHUNK_SIZE;
+  }
+  profile->largest_free_size = malloc_profile_get_largest_free_size(heap);
+  memcpy(profile->task, heap->profile.task, sizeof(profile->task));
+  memcpy(profile->site, heap->profile.site, sizeof(profile->site));
+  return 0;
+}
+
+#endif
@@ -0,0 +1,224 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*
+ * Segregated free lists for the process heap (CONFIG_MALLOC_IS_SEGREGATED).
+ *
+ * The heap keeps the same chunk headers as the first-fit allocator so
+ * mallinfo(), realloc() and malloc_free_task_r() walk it the same way.
+ * The free list heads are in the heap header (malloc_heap_t). Each free block stores its list links in its memory
+ * area and a pointer to its own header in its last word (the footer) so
+ * that freeing a chunk can merge with the block before it without a walk.
+ *
+ * Blocks are binned by chunk count: 1, 2 and 3 chunks have their own
+ * class, larger blocks use two classes per power of two. A bitmap of
+ * non-empty classes makes finding a block that fits O(1).
+ */
+
+#include "cortexm/cortexm.h"
+#include "sys/malloc/malloc_local.h"
+
+#if CONFIG_MALLOC_IS_SEGREGATED
+
+#if CONFIG_MALLOC_CHUNK_SIZE < 24
+#error "CONFIG_MALLOC_IS_SEGREGATED needs CONFIG_MALLOC_CHUNK_SIZE of at least 24"
+#endif
+
+typedef struct {
+  malloc_chunk_t *next;
+  malloc_chunk_t *previous;
+} segregated_links_t;
+
+static malloc_chunk_t *get_first_chunk(struct _reent *reent_ptr) {
+  return (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+}
+
+static segregated_links_t *get_links(malloc_chunk_t *chunk) {
+  return (segregated_links_t *)chunk->memory;
+}
+
+static malloc_chunk_t **get_footer(malloc_chunk_t *chunk) {
+  return ((malloc_chunk_t **)(chunk + chunk->header.num_chunks)) - 1;
+}
+
+static int get_class(u16 num_chunks) {
+  if (num_chunks < 4) {
+    return num_chunks - 1;
+  }
+  const int power = 31 - __CLZ(num_chunks);
+  const int half = (num_chunks >> (power - 1)) & 0x01;
+  return 3 + (power - 2) * 2 + half;
+}
+
+// every block in the returned class (or above) has at least num_chunks
+static int get_fit_class(u16 num_chunks) {
+  const int class = get_class(num_chunks);
+  if (num_chunks < 4) {
+    return class;
+  }
+  const int power = 31 - __CLZ(num_chunks);
+  if (num_chunks & ((1 << (power - 1)) - 1)) {
+    return class + 1;
+  }
+  return class;
+}
+
+static int is_chunk(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  malloc_chunk_t *first = get_first_chunk(reent_ptr);
+  const u32 offset = (u32)chunk - (u32)first;
+  if ((chunk < first) || (offset >= reent_ptr->procmem_base->size)) {
+    return 0;
+  }
+  return (offset % CONFIG_MALLOC_CHUNK_SIZE) == 0;
+}
+
+static void insert_chunk(malloc_heap_t *heap, malloc_chunk_t *chunk) {
+  malloc_segregated_t *segregated = &heap->segregated;
+  const int class = get_class(chunk->header.num_chunks);
+  segregated_links_t *links = get_links(chunk);
+  links->previous = NULL;
+  links->next = segregated->list[class];
+  if (links->next != NULL) {
+    get_links(links->next)->previous = chunk;
+  }
+  segregated->list[class] = chunk;
+  segregated->bitmap |= (1 << class);
+  *get_footer(chunk) = chunk;
+  malloc_profile_insert_free(heap, chunk->header.num_chunks);
+}
+
+static void remove_chunk(malloc_heap_t *heap, malloc_chunk_t *chunk) {
+  malloc_segregated_t *segregated = &heap->segregated;
+  const int class = get_class(chunk->header.num_chunks);
+  segregated_links_t *links = get_links(chunk);
+  if (links->previous != NULL) {
+    get_links(links->previous)->next = links->next;
+  } else {
+    segregated->list[class] = links->next;
+  }
+  if (links->next != NULL) {
+    get_links(links->next)->previous = links->previous;
+  }
+  if (segregated->list[class] == NULL) {
+    segregated->bitmap &= ~(1 << class);
+  }
+  malloc_profile_remove_free(heap, chunk->header.num_chunks);
+}
+
+// the footer is only trusted if it leads to a listed free block that ends at chunk
+static malloc_chunk_t *get_previous_free(
+  struct _reent *reent_ptr,
+  malloc_segregated_t *segregated,
+  malloc_chunk_t *chunk) {
+  malloc_chunk_t *previous = *((malloc_chunk_t **)chunk - 1);
+  if ((previous >= chunk) || (is_chunk(reent_ptr, previous) == 0)) {
+    return NULL;
+  }
+
+  if (
+    (cortexm_verify_zero_sum32(previous, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t))
+     == 0)
+    || (previous->header.actual_size != 0)
+    || (previous + previous->header.num_chunks != chunk)) {
+    return NULL;
+  }
+
+  malloc_chunk_t *link = get_links(previous)->previous;
+  if (link == NULL) {
+    return segregated->list[get_class(previous->header.num_chunks)] == previous
+             ? previous
+             : NULL;
+  }
+
+  if (is_chunk(reent_ptr, link) == 0) {
+    return NULL;
+  }
+  return get_links(link)->next == previous ? previous : NULL;
+}
+
+void malloc_segregated_extend(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u16 num_chunks) {
+  malloc_get_heap(reent_ptr)->segregated.last = chunk + num_chunks;
+  if (num_chunks) {
+    malloc_segregated_release(reent_ptr, chunk, num_chunks);
+  }
+}
+
+void malloc_segregated_release(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u16 num_chunks) {
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  malloc_segregated_t *segregated = &heap->segregated;
+  malloc_chunk_t *next = chunk + num_chunks;
+
+  if ((next != segregated->last) && (malloc_chunk_is_free(next) == 1)) {
+    remove_chunk(heap, next);
+    num_chunks += next->header.num_chunks;
+    malloc_merge_chunk(reent_ptr, chunk, next);
+  }
+
+  malloc_chunk_t *previous = get_previous_free(reent_ptr, segregated, chunk);
+  if (previous != NULL) {
+    remove_chunk(heap, previous);
+    num_chunks += previous->header.num_chunks;
+    malloc_merge_chunk(reent_ptr, previous, chunk);
+    chunk = previous;
+  }
+
+  malloc_set_chunk_free(chunk, num_chunks);
+  insert_chunk(heap, chunk);
+}
+
+malloc_chunk_t *malloc_segregated_take(struct _reent *reent_ptr, u16 num_chunks) {
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  malloc_segregated_t *segregated = &heap->segregated;
+  const int fit_class = get_fit_class(num_chunks);
+  const u32 available = fit_class < MALLOC_SEGREGATED_CLASS_COUNT
+                          ? segregated->bitmap & ~((1 << fit_class) - 1)
+                          : 0;
+
+  malloc_chunk_t *chunk;
+  if (available) {
+    chunk = segregated->list[__builtin_ctz(available)];
+  } else {
+    // the head of the smaller class may still be big enough
+    chunk = segregated->list[get_class(num_chunks)];
+  }
+
+  if ((chunk == NULL) || (malloc_chunk_is_free(chunk) != 1)) {
+    return NULL;
+  }
+
+  if (chunk->header.num_chunks < num_chunks) {
+    return NULL;
+  }
+
+  remove_chunk(heap, chunk);
+  const u16 extra_chunks = chunk->header.num_chunks - num_chunks;
+  if (extra_chunks) {
+    // the block after a free block is never free so the remainder needs no merge
+    malloc_set_chunk_free(chunk + num_chunks, extra_chunks);
+    insert_chunk(heap, chunk + num_chunks);
+    malloc_set_chunk_free(chunk, num_chunks);
+  }
+  return chunk;
+}
+
+void malloc_segregated_claim(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  remove_chunk(malloc_get_heap(reent_ptr), chunk);
+}
+
+malloc_chunk_t *malloc_segregated_take_last(struct _reent *reent_ptr) {
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  malloc_segregated_t *segregated = &heap->segregated;
+  malloc_chunk_t *last = get_previous_free(reent_ptr, segregated, segregated->last);
+  if (last != NULL) {
+    remove_chunk(heap, last);
+    segregated->last = last;
+  }
+  return last;
+}
+
+#endif
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <malloc.h>
 
+#include "sys/malloc/malloc_local.h"
+
 void malloc_stats(){
 	_malloc_stats_r(_REENT);
 }
@@ -16,5 +18,25 @@ void _malloc_stats_r(struct _reent * reent_ptr){
 	iprintf("Total Free Chunks %d\n", mi.ordblks);
 	iprintf("Total Free Memory %d bytes\n", mi.fordblks);
 	iprintf("Total Used Memory %d bytes\n", mi.uordblks);
+#if MALLOC_IS_HEAP_HEADER
+	if( reent_ptr->procmem_base->size > 0 ){
+		const malloc_heap_t * heap = malloc_get_heap(reent_ptr);
+		iprintf("Whole Heap Checks %ld\n", heap->heap_check_count);
+		iprintf("Neighbor Chunk Checks %ld\n", heap->neighbor_check_count);
+		iprintf("Scrubbed Chunks %ld\n", heap->scrub_check_count);
+		iprintf("Scrub Passes %ld\n", heap->scrub_pass_count);
+#if CONFIG_MALLOC_IS_PROFILE
+		iprintf("Largest Free Block %ld bytes\n", malloc_profile_get_largest_free_size(heap));
+		iprintf("Allocations %ld Frees %ld Failures %ld\n", heap->profile.alloc_count,
+			heap->profile.free_count, heap->profile.fail_count);
+		for(int i=0; i < SYS_HEAP_PROFILE_SITE_COUNT; i++){
+			const sys_heap_usage_t * site = heap->profile.site + i;
+			if( site->total_count ){
+				iprintf("Site 0x%lX %ld bytes in %ld blocks\n", site->id, site->size, site->count);
+			}
+		}
+#endif
+	}
+#endif
 }
 
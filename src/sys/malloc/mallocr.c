@@ -9,6 +9,7 @@
 
 #include "config.h"
 #include "sos/debug.h"
+#include "sos/probe.h"
 #include "trace.h"
 
 #define ENABLE_DEEP_TRACE 0
@@ -16,10 +17,18 @@
 static void set_last_chunk(malloc_chunk_t *chunk);
 static void cleanup_memory(struct _reent *reent_ptr, int release_extra_memory);
 static malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks);
+#if CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
 static int is_memory_corrupt(struct _reent *reent_ptr);
+#else
+static int is_neighbor_corrupt(struct _reent *reent_ptr, malloc_chunk_t *chunk);
+#endif
+static void scrub_memory(struct _reent *reent_ptr);
 
 void malloc_process_fault(void *loc);
 
+SOS_PROBE_DEFINE(_malloc_r);
+SOS_PROBE_DEFINE(_free_r);
+
 u16 malloc_calc_num_chunks(u32 size) {
   int num_chunks;
   if (size > MALLOC_DATA_SIZE) {
@@ -32,9 +41,39 @@ u16 malloc_calc_num_chunks(u32 size) {
   return num_chunks;
 }
 
+#if MALLOC_IS_HEAP_HEADER
+malloc_heap_t *malloc_get_heap(struct _reent *reent_ptr) {
+  malloc_chunk_t *first = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+  return (malloc_heap_t *)first->memory;
+}
+#endif
+
+void malloc_merge_chunk(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  malloc_chunk_t *merged_chunk) {
+#if MALLOC_IS_HEAP_HEADER
+  // merged_chunk is no longer a chunk boundary
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  if (heap->scrub_chunk == merged_chunk) {
+    heap->scrub_chunk = chunk;
+  }
+#else
+  MCU_UNUSED_ARGUMENT(reent_ptr);
+  MCU_UNUSED_ARGUMENT(chunk);
+  MCU_UNUSED_ARGUMENT(merged_chunk);
+#endif
+}
+
 malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks) {
+#if CONFIG_MALLOC_IS_SEGREGATED
+  return malloc_segregated_take(reent_ptr, num_chunks);
+#else
   int loop_count = 0;
   malloc_chunk_t *chunk = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+#if CONFIG_MALLOC_IS_PROFILE
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+#endif
 
 #if ENABLE_DEEP_TRACE
   sos_debug_log_info(SOS_DEBUG_MALLOC, "-----------find free");
@@ -52,8 +91,22 @@ malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks) {
       return NULL;
     }
 
-    if ((is_free == 1) && (chunk->header.num_chunks >= num_chunks)) {
-      return chunk;
+    if (is_free == 1) {
+      // free() only merges forward so merge any free chunks that follow
+      malloc_chunk_t *next = chunk + chunk->header.num_chunks;
+      while ((next->header.num_chunks != 0) && (malloc_chunk_is_free(next) == 1)) {
+        malloc_profile_remove_free(heap, chunk->header.num_chunks);
+        malloc_profile_remove_free(heap, next->header.num_chunks);
+        malloc_set_chunk_free(chunk, chunk->header.num_chunks + next->header.num_chunks);
+        malloc_profile_insert_free(heap, chunk->header.num_chunks);
+        malloc_merge_chunk(reent_ptr, chunk, next);
+        next = chunk + chunk->header.num_chunks;
+      }
+
+      if (chunk->header.num_chunks >= num_chunks) {
+        malloc_profile_remove_free(heap, chunk->header.num_chunks);
+        return chunk;
+      }
     }
     loop_count++;
     chunk = chunk + chunk->header.num_chunks;
@@ -61,10 +114,15 @@ malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks) {
 
   // No block found to fit size
   return NULL;
+#endif
 }
 
+#if CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
 int is_memory_corrupt(struct _reent *reent_ptr) {
   malloc_chunk_t *chunk = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+#if MALLOC_IS_HEAP_HEADER
+  malloc_get_heap(reent_ptr)->heap_check_count++;
+#endif
 
   while (chunk->header.num_chunks != 0) {
     int is_free = malloc_chunk_is_free(chunk);
@@ -75,34 +133,106 @@ int is_memory_corrupt(struct _reent *reent_ptr) {
   }
   return 0;
 }
+#else
+int is_neighbor_corrupt(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+#if MALLOC_IS_HEAP_HEADER
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  heap->neighbor_check_count++;
+#else
+  MCU_UNUSED_ARGUMENT(reent_ptr);
+#endif
+  if (malloc_chunk_is_free(chunk) == -1) {
+    return -1;
+  }
+
+  // the chunk header is valid so the next header is inside the heap
+#if MALLOC_IS_HEAP_HEADER
+  heap->neighbor_check_count++;
+#endif
+  if (malloc_chunk_is_free(chunk + chunk->header.num_chunks) == -1) {
+    return -1;
+  }
+  return 0;
+}
+#endif
+
+void scrub_memory(struct _reent *reent_ptr) {
+#if CONFIG_MALLOC_SCRUB_CHUNKS > 0
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+  malloc_chunk_t *chunk = heap->scrub_chunk;
+  if (chunk == NULL) {
+    chunk = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+  }
+
+  for (int i = 0; i < CONFIG_MALLOC_SCRUB_CHUNKS; i++) {
+    heap->scrub_check_count++;
+    if (malloc_chunk_is_free(chunk) == -1) {
+      return;
+    }
+
+    if (chunk->header.num_chunks == 0) {
+      // the last chunk -- start the next pass at the beginning of the heap
+      heap->scrub_pass_count++;
+      chunk = NULL;
+      break;
+    }
+    chunk += chunk->header.num_chunks;
+  }
+  heap->scrub_chunk = chunk;
+#else
+  MCU_UNUSED_ARGUMENT(reent_ptr);
+#endif
+}
 
 void cleanup_memory(struct _reent *reent_ptr, int release_extra_memory) {
+#if MALLOC_IS_HEAP_HEADER
+  malloc_heap_t *heap = malloc_get_heap(reent_ptr);
+#endif
+#if CONFIG_MALLOC_IS_SEGREGATED
+  // free blocks are merged as they are released
+  if (release_extra_memory) {
+    malloc_chunk_t *last_free_chunk = malloc_segregated_take_last(reent_ptr);
+    if (last_free_chunk != NULL) {
+      _sbrk_r(
+        reent_ptr, -1 * (last_free_chunk->header.num_chunks * CONFIG_MALLOC_CHUNK_SIZE));
+      set_last_chunk(last_free_chunk);
+      if (heap->scrub_chunk > last_free_chunk) {
+        heap->scrub_chunk = NULL;
+      }
+    }
+  }
+  return;
+#endif
   malloc_chunk_t *current;
   malloc_chunk_t *next;
   malloc_chunk_t *last_chunk_if_free = 0;
   current = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
   next = current + (current->header.num_chunks);
+  if (malloc_chunk_is_free(current) == 1) {
+    // without a heap header the first chunk can be the last free chunk
+    last_chunk_if_free = current;
+  }
   // if num_chunks is zero -- that is the last chunk
   while (next->header.num_chunks != 0) {
     int current_free = malloc_chunk_is_free(current);
     int next_free = malloc_chunk_is_free(next);
 
-    if (next_free) {
-      last_chunk_if_free = next;
-    } else {
-      last_chunk_if_free = 0;
-    }
-
     if (next_free == -1) {
       return;
     }
 
     if ((current_free == 1) && (next_free == 1)) { // both blocks are free
       // combine the free chunks as one larger free chunk
+      malloc_profile_remove_free(heap, current->header.num_chunks);
+      malloc_profile_remove_free(heap, next->header.num_chunks);
       malloc_set_chunk_free(
         current, current->header.num_chunks + next->header.num_chunks);
+      malloc_profile_insert_free(heap, current->header.num_chunks);
+      malloc_merge_chunk(reent_ptr, current, next);
+      last_chunk_if_free = current;
     } else {
       current = next;
+      last_chunk_if_free = next_free ? next : 0;
     }
     next = next + next->header.num_chunks;
   }
@@ -112,8 +242,14 @@ void cleanup_memory(struct _reent *reent_ptr, int release_extra_memory) {
     // do negative _sbrk to give memory back to stack
     ptrdiff_t size =
       -1 * (last_chunk_if_free->header.num_chunks * CONFIG_MALLOC_CHUNK_SIZE);
+    malloc_profile_remove_free(heap, last_chunk_if_free->header.num_chunks);
     _sbrk_r(reent_ptr, size);
     set_last_chunk(last_chunk_if_free);
+#if MALLOC_IS_HEAP_HEADER
+    if (heap->scrub_chunk > last_chunk_if_free) {
+      heap->scrub_chunk = NULL;
+    }
+#endif
   }
 }
 
@@ -142,7 +278,7 @@ void malloc_free_task_r(struct _reent *reent_ptr, int task_id) {
 }
 
 void _free_r(struct _reent *reent_ptr, void *addr) {
-  SOS_DEBUG_ENTER_TIMER_SCOPE(_free_r);
+  SOS_PROBE_ENTER(_free_r);
   int tmp;
 
   malloc_chunk_t *chunk;
@@ -191,6 +327,7 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
   }
 
   __malloc_lock(reent_ptr);
+#if CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
   // check for corrupt memory
   if (is_memory_corrupt(reent_ptr) < 0) {
     sos_debug_log_error(SOS_DEBUG_MALLOC, "Free Memory Corrupt 0x%lX", (u32)reent_ptr);
@@ -199,6 +336,7 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
     malloc_process_fault(reent_ptr); // this will exit the process
     return;
   }
+#endif
 
   tmp = (unsigned int)chunk - (unsigned int)(&(base->base));
   if (tmp % CONFIG_MALLOC_CHUNK_SIZE) {
@@ -207,6 +345,25 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
     return;
   }
 
+#if MALLOC_IS_HEAP_HEADER
+  if (tmp == 0) {
+    sos_debug_log_warning(SOS_DEBUG_MALLOC, "Free addr is the heap header");
+    __malloc_unlock(reent_ptr);
+    return;
+  }
+#endif
+
+#if !CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
+  // check the chunk and the one after it rather than the whole heap
+  if (is_neighbor_corrupt(reent_ptr, chunk) < 0) {
+    sos_debug_log_error(SOS_DEBUG_MALLOC, "Free Chunk Corrupt 0x%lX", (u32)chunk);
+    SOS_TRACE_CRITICAL("Heap Fault");
+    __malloc_unlock(reent_ptr);
+    malloc_process_fault(reent_ptr); // this will exit the process
+    return;
+  }
+#endif
+
   is_free = malloc_chunk_is_free(chunk);
 
   if (is_free != 0) { // Is the chunk in use (able to be freed)
@@ -217,11 +374,15 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
   }
 
   // sos_debug_log_info(SOS_DEBUG_MALLOC, "f:%d 0x%X", getpid(), addr);
-  malloc_set_chunk_free(chunk, chunk->header.num_chunks);
+  malloc_profile_release(malloc_get_heap(reent_ptr), chunk);
+  malloc_release_chunks(reent_ptr, chunk, chunk->header.num_chunks);
+#if CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
   cleanup_memory(reent_ptr, 0);
+#endif
+  scrub_memory(reent_ptr);
 
   __malloc_unlock(reent_ptr);
-  SOS_DEBUG_EXIT_TIMER_SCOPE(SOS_DEBUG_MALLOC, _free_r);
+  SOS_PROBE_EXIT(_free_r);
 
   sos_debug_log_datum(SOS_DEBUG_MALLOC, "heap%d:free,%d", getpid(), addr);
 }
@@ -232,6 +393,10 @@ int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap)
 
   if (is_new_heap) {
     extra_bytes = CONFIG_MALLOC_SBRK_JUMP_SIZE;
+#if MALLOC_IS_HEAP_HEADER
+    // the first chunk of the heap holds malloc_heap_t
+    size += malloc_calc_num_chunks(sizeof(malloc_heap_t)) * CONFIG_MALLOC_CHUNK_SIZE;
+#endif
   }
 
   // jump as size but round up to a multiple of CONFIG_MALLOC_SBRK_JUMP_SIZE
@@ -249,8 +414,16 @@ int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap)
     return -1;
   } else {
     malloc_chunk_t *chunk;
+    u16 num_chunks = jump_size / CONFIG_MALLOC_CHUNK_SIZE;
     if (is_new_heap) {
       chunk = new_heap;
+#if MALLOC_IS_HEAP_HEADER
+      const u16 heap_chunks = malloc_calc_num_chunks(sizeof(malloc_heap_t));
+      malloc_set_chunk_used(NULL, chunk, heap_chunks, sizeof(malloc_heap_t));
+      memset(chunk->memory, 0, sizeof(malloc_heap_t));
+      chunk += heap_chunks;
+      num_chunks -= heap_chunks;
+#endif
     } else {
       /*
        * After the first call, there is always an extra CONFIG_MALLOC_SBRK_JUMP_SIZE bytes
@@ -262,9 +435,18 @@ int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap)
        */
       chunk = new_heap - CONFIG_MALLOC_SBRK_JUMP_SIZE;
     }
-    malloc_set_chunk_free(chunk, jump_size / CONFIG_MALLOC_CHUNK_SIZE);
+    if (num_chunks) {
+      malloc_set_chunk_free(chunk, num_chunks);
+    }
     // mark the last block (heap should have extra room for this)
-    set_last_chunk(chunk + chunk->header.num_chunks);
+    set_last_chunk(chunk + num_chunks);
+#if CONFIG_MALLOC_IS_SEGREGATED
+    malloc_segregated_extend(reent_ptr, chunk, num_chunks);
+#else
+    if (num_chunks) {
+      malloc_profile_insert_free(malloc_get_heap(reent_ptr), num_chunks);
+    }
+#endif
 #if ENABLE_DEEP_TRACE
     sos_debug_log_info(
       SOS_DEBUG_MALLOC, "set last chunk at %p", chunk + chunk->header.num_chunks);
@@ -293,12 +475,16 @@ int malloc_is_memory_corrupt(struct _reent *reent_ptr) {
 }
 
 void *_malloc_r(struct _reent *reent_ptr, size_t size) {
+  return malloc_allocate_r(reent_ptr, size, MALLOC_CALL_SITE());
+}
+
+void *malloc_allocate_r(struct _reent *reent_ptr, size_t size, u32 site) {
   void *alloc;
   u16 num_chunks;
   malloc_chunk_t *chunk;
   alloc = NULL;
 
-  SOS_DEBUG_ENTER_TIMER_SCOPE(_malloc_r);
+  SOS_PROBE_ENTER(_malloc_r);
 
   if (reent_ptr == NULL) {
     errno = EINVAL;
@@ -308,10 +494,10 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
   }
 
   __malloc_lock(reent_ptr);
-  num_chunks = malloc_calc_num_chunks(size);
+  num_chunks = malloc_calc_num_chunks(size + MALLOC_PROFILE_TAG_SIZE);
 
   if (reent_ptr->procmem_base->size == 0) {
-    if (malloc_get_more_memory(reent_ptr, size, 1) < 0) {
+    if (malloc_get_more_memory(reent_ptr, size + MALLOC_PROFILE_TAG_SIZE, 1) < 0) {
       __malloc_unlock(reent_ptr);
       errno = ENOMEM;
       sos_debug_log_info(SOS_DEBUG_MALLOC, "ENOMEM %s():%d<-", __FUNCTION__, __LINE__);
@@ -326,6 +512,7 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
     chunk = find_free_chunk(reent_ptr, num_chunks);
     if (chunk == NULL) {
 
+#if CONFIG_MALLOC_IS_CHECK_WHOLE_HEAP
       // See if the memory is corrupt
       if (is_memory_corrupt(reent_ptr)) {
         sos_debug_log_error(SOS_DEBUG_MALLOC, "Memory Corrupt %p", reent_ptr);
@@ -337,10 +524,12 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
         sos_handle_event(SOS_EVENT_MALLOC_FAILED, "ENOMEM2");
         return NULL;
       }
+#endif
 
       // Try to get more memory
-      if (malloc_get_more_memory(reent_ptr, size, 0) < 0) {
+      if (malloc_get_more_memory(reent_ptr, size + MALLOC_PROFILE_TAG_SIZE, 0) < 0) {
         cleanup_memory(reent_ptr, 0); // give memory back to stack
+        malloc_profile_fail(reent_ptr);
         __malloc_unlock(reent_ptr);
         errno = ENOMEM;
         sos_debug_log_info(SOS_DEBUG_MALLOC, "ENOMEM %s():%d<-", __FUNCTION__, __LINE__);
@@ -357,7 +546,9 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
       int diff_chunks = chunk->header.num_chunks - num_chunks;
       if (diff_chunks) {
         malloc_set_chunk_free(chunk + num_chunks, diff_chunks);
+        malloc_profile_insert_free(malloc_get_heap(reent_ptr), diff_chunks);
       } else if (chunk->header.num_chunks < num_chunks) {
+        malloc_profile_fail(reent_ptr);
         __malloc_unlock(reent_ptr);
         errno = ENOMEM;
         sos_debug_log_info(SOS_DEBUG_MALLOC, "ENOMEM %s():%d<-", __FUNCTION__, __LINE__);
@@ -365,19 +556,51 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
         return NULL;
       }
       malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
+      malloc_profile_allocate(malloc_get_heap(reent_ptr), chunk, site);
       alloc = chunk->memory;
     }
   } while (alloc == NULL);
 
+  scrub_memory(reent_ptr);
   __malloc_unlock(reent_ptr);
 
-  SOS_DEBUG_EXIT_TIMER_SCOPE(SOS_DEBUG_MALLOC, _malloc_r);
+  SOS_PROBE_EXIT(_malloc_r);
 
   sos_debug_log_datum(SOS_DEBUG_MALLOC, "heap%d:alloc,%d,%d", getpid(), alloc, size);
 
   return alloc;
 }
 
+void malloc_release_chunks(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u16 num_chunks) {
+#if CONFIG_MALLOC_IS_SEGREGATED
+  malloc_segregated_release(reent_ptr, chunk, num_chunks);
+#else
+  malloc_chunk_t *next = chunk + num_chunks;
+  if ((next->header.num_chunks != 0) && (malloc_chunk_is_free(next) == 1)) {
+    malloc_profile_remove_free(malloc_get_heap(reent_ptr), next->header.num_chunks);
+    num_chunks += next->header.num_chunks;
+    malloc_merge_chunk(reent_ptr, chunk, next);
+  }
+  malloc_set_chunk_free(chunk, num_chunks);
+  malloc_profile_insert_free(malloc_get_heap(reent_ptr), num_chunks);
+#endif
+}
+
+void malloc_claim_free_chunk(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  malloc_chunk_t *free_chunk) {
+#if CONFIG_MALLOC_IS_SEGREGATED
+  malloc_segregated_claim(reent_ptr, free_chunk);
+#else
+  malloc_profile_remove_free(malloc_get_heap(reent_ptr), free_chunk->header.num_chunks);
+#endif
+  malloc_merge_chunk(reent_ptr, chunk, free_chunk);
+}
+
 void malloc_set_chunk_used(
   struct _reent *reent,
   malloc_chunk_t *chunk,
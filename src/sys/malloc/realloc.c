@@ -8,6 +8,8 @@ int _dummy_calloc = 1;
 #include <stdlib.h>
 #include <malloc.h>
 
+#include "sys/malloc/malloc_local.h"
+
 #ifndef _REENT_ONLY
 
 _PTR
@@ -15,7 +17,7 @@ _DEFUN (realloc, (ap, nbytes),
 	_PTR ap _AND
 	size_t nbytes)
 {
-  return _realloc_r (_GLOBAL_REENT, ap, nbytes);
+  return malloc_reallocate_r (_GLOBAL_REENT, ap, nbytes, MALLOC_CALL_SITE());
 }
 
 #endif
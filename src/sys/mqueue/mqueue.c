@@ -95,10 +95,27 @@
 struct message {
   int prio;
   int size;
-  int age;
+  u16 next; // next message in the free list or in the priority list
+  u16 state;
   //! \todo Add a checksum to the message -- generate on send and check on receive
 };
 
+// priorities 0 to 30 each have a list, higher priorities share the last one
+#define MQ_PRIO_LIST_COUNT 32
+#define MQ_MSG_NONE 0xffff
+
+enum mq_msg_state {
+  MQ_MSG_STATE_FREE,
+  MQ_MSG_STATE_QUEUED,
+  MQ_MSG_STATE_RESERVED, // taken by mq_reserve() until mq_commit()
+  MQ_MSG_STATE_PEEKED    // taken by mq_peek() until mq_release()
+};
+
+typedef struct {
+  u16 head;
+  u16 tail;
+} mq_list_fifo_t;
+
 #define MQ_STATUS_REFS_MASK (0xFFFF)
 #define MQ_STATUS_UNLINK_ON_CLOSE_MASK (1 << 16)
 #define MQ_STATUS_NONBLOCK_MASK (1 << 17)
@@ -111,10 +128,13 @@ struct message {
 typedef struct {
   size_t max_size;            // maximum message size
   size_t max_msgs;            // maximum number of messages
-  size_t age;                 // The running age -- 0 is the oldest message
+  size_t cur_msgs;            // messages in the queue
   int mode;                   // not currently implemented
   char name[MQ_NAME_MAX + 1]; // The name of the queue
   struct message *msg_table;  // a pointer to the message table
+  u16 free_head;              // first unused entry in msg_table
+  u32 prio_bitmap;            // bit n is set if prio_list[n] has messages
+  mq_list_fifo_t prio_list[MQ_PRIO_LIST_COUNT];
   u32 status; // how many tasks are accessing the message queue, other flags
   int pid;
   pthread_mutex_t mutex;
@@ -131,10 +151,13 @@ static mq_list_t *mq_first = NULL;
 
 static int mq_entry_size(const mq_t *mq) { return sizeof(struct message) + mq->max_size; }
 
-static struct message *mq_next_message(const struct message *msg, int entry_size) {
-  const u8 *ptr;
-  ptr = ((const u8*)msg) + entry_size;
-  return (struct message *)ptr;
+static struct message *mq_get_message(const mq_t *mq, u16 index) {
+  u8 *ptr = (u8 *)mq->msg_table;
+  return (struct message *)(ptr + index * mq_entry_size(mq));
+}
+
+static u16 mq_get_index(const mq_t *mq, const struct message *msg) {
+  return ((const u8 *)msg - (const u8 *)mq->msg_table) / mq_entry_size(mq);
 }
 
 static mq_t *mq_find_named(const char *name) {
@@ -153,21 +176,6 @@ static mq_t *mq_find_named(const char *name) {
   return NULL;
 }
 
-static ssize_t mq_cur_msgs(const mq_t *mq) {
-  ssize_t count = 0;
-
-  struct message *imsg = mq->msg_table;
-  int entry_size = mq_entry_size(mq);
-
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    if (imsg->size != 0) {
-      count++;
-    }
-    imsg = mq_next_message(imsg, entry_size);
-  }
-  return count;
-}
-
 static void *mq_message_data(struct message *msg) {
   void *ptr = msg;
   return (u8 *)ptr + sizeof(struct message);
@@ -201,53 +209,118 @@ static mq_t *mq_find_free() {
 }
 
 static void mq_init_table(mq_t *mq) {
-  struct message *imsg = mq->msg_table;
-  const int entry_size = mq_entry_size(mq);
   for (size_t i = 0; i < mq->max_msgs; i++) {
+    struct message *imsg = mq_get_message(mq, i);
     imsg->size = 0;
-    imsg = mq_next_message(imsg, entry_size);
+    imsg->state = MQ_MSG_STATE_FREE;
+    imsg->next = (i + 1 < mq->max_msgs) ? i + 1 : MQ_MSG_NONE;
+  }
+  mq->free_head = 0;
+  mq->cur_msgs = 0;
+  mq->prio_bitmap = 0;
+  for (int i = 0; i < MQ_PRIO_LIST_COUNT; i++) {
+    mq->prio_list[i].head = MQ_MSG_NONE;
+    mq->prio_list[i].tail = MQ_MSG_NONE;
   }
 }
 
+static int mq_get_prio_list(int prio) {
+  return ((unsigned)prio < MQ_PRIO_LIST_COUNT - 1) ? prio : MQ_PRIO_LIST_COUNT - 1;
+}
+
+// the head of the highest non-empty list is the oldest, highest priority message
 static struct message *mq_find_oldest_highest(const mq_t *mq) {
-  struct message *msg;
-  int max_prio = 0;
-  int max_age = INT_MAX;
-  struct message *imsg = mq->msg_table;
-  int entry_size = mq_entry_size(mq);
-
-  msg = 0;
-  // find the oldest, highest priority message from the queue
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    if (imsg->size != 0) {
-      if (imsg->prio > max_prio) {
-        max_prio = imsg->prio;
-        max_age = imsg->age;
-        msg = imsg;
-      } else if (imsg->prio == max_prio) {
-        if ((imsg->age < max_age)) {
-          max_prio = imsg->prio;
-          max_age = imsg->age;
-          msg = imsg;
-        }
-      }
+  if (mq->prio_bitmap == 0) {
+    return NULL;
+  }
+  const int list = 31 - __CLZ(mq->prio_bitmap);
+  return mq_get_message(mq, mq->prio_list[list].head);
+}
+
+static void mq_free_msg(mq_t *mq, struct message *msg) {
+  msg->size = 0;
+  msg->state = MQ_MSG_STATE_FREE;
+  msg->next = mq->free_head;
+  mq->free_head = mq_get_index(mq, msg);
+}
+
+static struct message *mq_detach_oldest_highest(mq_t *mq) {
+  const int list = 31 - __CLZ(mq->prio_bitmap);
+  mq_list_fifo_t *fifo = mq->prio_list + list;
+  struct message *msg = mq_get_message(mq, fifo->head);
+
+  fifo->head = msg->next;
+  if (fifo->head == MQ_MSG_NONE) {
+    fifo->tail = MQ_MSG_NONE;
+    mq->prio_bitmap &= ~(1 << list);
+  }
+  mq->cur_msgs--;
+  return msg;
+}
+
+static void mq_remove_oldest_highest(mq_t *mq) {
+  mq_free_msg(mq, mq_detach_oldest_highest(mq));
+}
+
+static struct message *mq_take_free_msg(mq_t *mq) {
+  if (mq->free_head == MQ_MSG_NONE) {
+    if (((mq->status & MQ_STATUS_LOOP_MASK) == 0) || (mq->prio_bitmap == 0)) {
+      return NULL;
     }
-    imsg = mq_next_message(imsg, entry_size);
+    // if mq is full, discard the oldest message
+    mq_remove_oldest_highest(mq);
   }
+  struct message *msg = mq_get_message(mq, mq->free_head);
+  mq->free_head = msg->next;
   return msg;
 }
 
-static struct message *mq_find_free_msg(const mq_t *mq) {
-  struct message *imsg = mq->msg_table;
-  int entry_size = mq_entry_size(mq);
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    if (imsg->size == 0) {
-      return imsg;
+// a reserved or peeked message is only accepted back if msg_ptr is exactly its data
+static struct message *mq_find_held_msg(const mq_t *mq, const void *msg_ptr, int state) {
+  const u8 *table = (const u8 *)mq->msg_table;
+  const u8 *ptr = (const u8 *)msg_ptr - sizeof(struct message);
+  if ((table == NULL) || (ptr < table)) {
+    return NULL;
+  }
+  const u32 offset = ptr - table;
+  const u32 index = offset / mq_entry_size(mq);
+  if ((offset % mq_entry_size(mq)) || (index >= mq->max_msgs)) {
+    return NULL;
+  }
+  struct message *msg = mq_get_message(mq, index);
+  return msg->state == state ? msg : NULL;
+}
+
+static void mq_insert_message(mq_t *mq, struct message *msg) {
+  const int list = mq_get_prio_list(msg->prio);
+  mq_list_fifo_t *fifo = mq->prio_list + list;
+  const u16 index = mq_get_index(mq, msg);
+
+  mq->cur_msgs++;
+  mq->prio_bitmap |= (1 << list);
+  msg->state = MQ_MSG_STATE_QUEUED;
+
+  if (
+    (fifo->tail == MQ_MSG_NONE)
+    || (mq_get_message(mq, fifo->tail)->prio >= msg->prio)) {
+    // the usual case: append to the end of the list
+    msg->next = MQ_MSG_NONE;
+    if (fifo->tail == MQ_MSG_NONE) {
+      fifo->head = index;
+    } else {
+      mq_get_message(mq, fifo->tail)->next = index;
     }
-    imsg = mq_next_message(imsg, entry_size);
+    fifo->tail = index;
+    return;
   }
 
-  return 0;
+  // only the shared list has mixed priorities -- keep it highest first
+  u16 *link = &fifo->head;
+  while (mq_get_message(mq, *link)->prio >= msg->prio) {
+    link = &mq_get_message(mq, *link)->next;
+  }
+  msg->next = *link;
+  *link = index;
 }
 
 static int mq_init_mutex(mq_t *mq) {
@@ -326,7 +399,7 @@ int mq_getattr(mqd_t mqdes, struct mq_attr *mqstat) {
   // read the mq in priv mode
   mqstat->mq_maxmsg = mq->max_msgs;
   mqstat->mq_msgsize = mq->max_size;
-  mqstat->mq_curmsgs = mq_cur_msgs(mq);
+  mqstat->mq_curmsgs = mq->cur_msgs;
 
   mqstat->mq_flags = 0;
 
@@ -402,7 +475,7 @@ int mq_setattr(mqd_t mqdes, const struct mq_attr *mqstat, struct mq_attr *omqsta
  * - ENOMEM:  not enough memory for the queue
  * - EACCES:  permission to create \a name queue is denied
  * - EINVAL: O_CREAT is set and \a attr is not null but \a mq_maxmsg or \a mq_msgsize is
- * less than or equal to zero
+ * less than or equal to zero (or \a mq_maxmsg is 65535 or more)
  *
  *
  */
@@ -463,7 +536,9 @@ mqd_t mq_open(
     va_end(ap);
 
     // check for valid message attributes
-    if ((attr->mq_maxmsg <= 0) || (attr->mq_msgsize <= 0)) {
+    if (
+      (attr->mq_maxmsg <= 0) || (attr->mq_maxmsg >= MQ_MSG_NONE)
+      || (attr->mq_msgsize <= 0)) {
       errno = EINVAL;
       return -1;
     }
@@ -491,8 +566,6 @@ mqd_t mq_open(
       // aligned
       new_mq->max_size = attr->mq_msgsize;
     }
-    new_mq->age = 0;
-
     const int is_user = strncmp(name, "user", 4) == 0;
 
     new_mq->pid = task_get_pid(task_get_current());
@@ -702,7 +775,7 @@ ssize_t mq_timedreceive(
 
         // Remove the message from the queue
         size = new_msg->size;
-        new_msg->size = 0;
+        mq_remove_oldest_highest(mq);
       }
     } else {
       if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
@@ -797,21 +870,14 @@ int mq_timedsend(
   pthread_mutex_lock(&mq->mutex);
 
   do {
-    struct message *new_msg = mq_find_free_msg(mq);
+    struct message *new_msg = msg_len > 0 ? mq_take_free_msg(mq) : NULL;
 
     if (new_msg != NULL) {
       size = msg_len;
-    } else if ((mq->status & MQ_STATUS_LOOP_MASK) != 0) {
-      // if mq is full, discard the oldest message
-      new_msg = mq_find_oldest_highest(mq);
-      size = msg_len;
-    }
-
-    if (size > 0) {
       memcpy(mq_message_data(new_msg), msg_ptr, msg_len);
       new_msg->size = msg_len;
-      new_msg->age = mq->age++;
       new_msg->prio = msg_prio;
+      mq_insert_message(mq, new_msg);
     } else {
       if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
         // Non-blocking mode:  return an error
@@ -852,4 +918,202 @@ int mq_trysend(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_pr
   return mq_timedsend(mqdes, msg_ptr, msg_len, msg_prio, &abs_timeout);
 }
 
+/*! \details This function reserves a free message slot so the message
+ * can be written in place and sent with \ref mq_commit() instead of being
+ * copied by \ref mq_send(). It blocks like \ref mq_timedsend() when the
+ * queue is full.
+ *
+ * The returned pointer has room for \a mq_msgsize bytes. It points into the
+ * queue's own table (the shared system heap for shared queues and the
+ * process heap for `user` queues), which is the memory \ref mq_send()
+ * copies into, so it is valid in any thread that can send on the queue. It
+ * must not be used after it is committed.
+ *
+ * ```
+ * //md2code:main
+ *	mqd_t mdes = mq_open("/path/to/queue", O_RDWR);
+ *	char * msg = mq_reserve(mdes);
+ *	if( msg != NULL ){
+ *		int len = sprintf(msg, "frame %d", 10);
+ *		mq_commit(mdes, msg, len, 0);
+ *	}
+ * ```
+ *
+ * \return A pointer to the message data or NULL with errno (see \ref errno) set to:
+ * - EAGAIN:  no room on the queue and O_NONBLOCK is set in the descriptor flags
+ * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
+ * - EACCES:  the queue was not opened for writing
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+void *mq_timedreserve(mqd_t mqdes, const struct timespec *abs_timeout) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return NULL;
+  }
+
+  if ((mq->status & MQ_STATUS_RDWR_MASK) == 0) {
+    errno = EACCES;
+    return NULL;
+  }
+
+  struct message *new_msg = NULL;
+  pthread_mutex_lock(&mq->mutex);
+  do {
+    new_msg = mq_take_free_msg(mq);
+    if (new_msg != NULL) {
+      new_msg->state = MQ_MSG_STATE_RESERVED;
+    } else if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
+      errno = EAGAIN;
+      break;
+    } else if (pthread_cond_timedwait(&mq->recv_cond, &mq->mutex, abs_timeout) < 0) {
+      break;
+    }
+  } while (new_msg == NULL);
+  pthread_mutex_unlock(&mq->mutex);
+
+  return new_msg != NULL ? mq_message_data(new_msg) : NULL;
+}
+
+/*! \details Reserves a message slot (see \ref mq_timedreserve()) without a timeout. */
+void *mq_reserve(mqd_t mqdes) { return mq_timedreserve(mqdes, NULL); }
+
+/*! \details This function sends the message that was written to a slot
+ * from \ref mq_reserve(). Committing a \a msg_len of zero gives the slot
+ * back without sending anything.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EMSGSIZE:  \a msg_len is greater than \a mq_msgsize (the slot stays reserved)
+ * - EINVAL:  \a msg_ptr is not a reserved slot of \a mqdes
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+int mq_commit(mqd_t mqdes, void *msg_ptr, size_t msg_len, unsigned msg_prio) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return -1;
+  }
+
+  if (mq->max_size < msg_len) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  pthread_mutex_lock(&mq->mutex);
+  struct message *msg = mq_find_held_msg(mq, msg_ptr, MQ_MSG_STATE_RESERVED);
+  if (msg == NULL) {
+    pthread_mutex_unlock(&mq->mutex);
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (msg_len == 0) {
+    mq_free_msg(mq, msg);
+  } else {
+    msg->size = msg_len;
+    msg->prio = msg_prio;
+    mq_insert_message(mq, msg);
+  }
+  pthread_mutex_unlock(&mq->mutex);
+
+  // a receiver is waiting for a message or a sender for a free slot
+  pthread_cond_signal(msg_len == 0 ? &mq->recv_cond : &mq->send_cond);
+  return 0;
+}
+
+/*! \details This function takes the oldest, highest priority message
+ * off the queue and returns a pointer to it so it can be read in place
+ * instead of being copied by \ref mq_receive(). The slot is not reused
+ * until it is given back with \ref mq_release(). It blocks like
+ * \ref mq_timedreceive() when the queue is empty.
+ *
+ * The pointer is into the queue's table like the one from
+ * \ref mq_timedreserve() and must not be used after it is released.
+ *
+ * ```
+ * //md2code:main
+ *	mqd_t mdes = mq_open("/path/to/queue", O_RDWR);
+ *	size_t len;
+ *	unsigned prio;
+ *	const char * msg = mq_peek(mdes, &len, &prio);
+ *	if( msg != NULL ){
+ *		printf("received %d bytes\n", (int)len);
+ *		mq_release(mdes, msg);
+ *	}
+ * ```
+ *
+ * \return A pointer to the message data or NULL with errno (see \ref errno) set to:
+ * - EAGAIN:  no message on the queue and O_NONBLOCK is set in the descriptor flags
+ * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+void *mq_timedpeek(
+  mqd_t mqdes,
+  size_t *msg_len /*! if not NULL, the size of the message is stored here */,
+  unsigned *msg_prio /*! if not NULL, the priority of the message is stored here */,
+  const struct timespec *abs_timeout /*! the absolute timeout value */) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return NULL;
+  }
+
+  struct message *msg = NULL;
+  pthread_mutex_lock(&mq->mutex);
+  do {
+    if (mq->prio_bitmap != 0) {
+      msg = mq_detach_oldest_highest(mq);
+      msg->state = MQ_MSG_STATE_PEEKED;
+      if (msg_len != NULL) {
+        *msg_len = msg->size;
+      }
+      if (msg_prio != NULL) {
+        *msg_prio = msg->prio;
+      }
+    } else if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
+      errno = EAGAIN;
+      break;
+    } else if (pthread_cond_timedwait(&mq->send_cond, &mq->mutex, abs_timeout) < 0) {
+      break;
+    }
+  } while (msg == NULL);
+  pthread_mutex_unlock(&mq->mutex);
+
+  return msg != NULL ? mq_message_data(msg) : NULL;
+}
+
+/*! \details Takes a message (see \ref mq_timedpeek()) without a timeout. */
+void *mq_peek(mqd_t mqdes, size_t *msg_len, unsigned *msg_prio) {
+  return mq_timedpeek(mqdes, msg_len, msg_prio, NULL);
+}
+
+/*! \details This function gives back the slot of a message from
+ * \ref mq_peek().
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL:  \a msg_ptr is not a peeked message of \a mqdes
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+int mq_release(mqd_t mqdes, const void *msg_ptr) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&mq->mutex);
+  struct message *msg = mq_find_held_msg(mq, msg_ptr, MQ_MSG_STATE_PEEKED);
+  if (msg == NULL) {
+    pthread_mutex_unlock(&mq->mutex);
+    errno = EINVAL;
+    return -1;
+  }
+  mq_free_msg(mq, msg);
+  pthread_mutex_unlock(&mq->mutex);
+
+  // there is room in the queue
+  pthread_cond_signal(&mq->recv_cond);
+  return 0;
+}
+
 /*! @} */
@@ -207,7 +207,7 @@ int pthread_cond_timedwait(
   }
 
   // does caller have a lock on the mutex?
-  if (mutex->pthread != task_get_current()) {
+  if (pthread_mutex_get_owner(mutex) != task_get_current()) {
     errno = EACCES;
     return -1;
   }
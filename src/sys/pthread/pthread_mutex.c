@@ -17,6 +17,7 @@
 
 #include "pthread_mutex_local.h"
 #include "sos/debug.h"
+#include "sos/probe.h"
 
 #include "../scheduler/scheduler_root.h"
 #include "../scheduler/scheduler_timing.h"
@@ -24,6 +25,8 @@
 /*! \cond */
 static void pthread_mutex_svcall_unlock(void *args);
 static int mutex_check_initialized(const pthread_mutex_t *mutex);
+static int mutex_fast_lock(pthread_mutex_t *mutex, int id);
+static int mutex_fast_unlock(pthread_mutex_t *mutex, int id);
 static int
 mutex_trylock(pthread_mutex_t *mutex, bool trylock, const struct timespec *abs_timeout);
 typedef struct {
@@ -35,13 +38,20 @@ typedef struct {
 } svcall_mutex_trylock_t;
 static void svcall_mutex_trylock(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_CODE;
 
+static void root_mutex_trylock(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_CODE;
 static void root_mutex_block(svcall_mutex_trylock_t *args);
 static void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_CODE;
+
+SOS_PROBE_DEFINE(pthread_mutex_lock);
+SOS_PROBE_DEFINE(pthread_mutex_unlock);
 /*! \endcond */
 
 /*! \details This function locks \a mutex.  If \a mutex cannot be locked immediately,
  * the thread is blocked until \a mutex is available.
  *
+ * A free mutex is taken with LDREX/STREX without entering the kernel. On
+ * armv6-m (no LDREX/STREX) every call makes an SVCall.
+ *
  * \return Zero on success or -1 with errno set to:
  * - EINVAL:  mutex is NULL
  * - EDEADLK:  the caller already holds the mutex
@@ -49,7 +59,7 @@ static void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_C
  *
  */
 int pthread_mutex_lock(pthread_mutex_t *mutex) {
-  SOS_DEBUG_ENTER_TIMER_SCOPE_AVERAGE(pthread_mutex_lock);
+  SOS_PROBE_ENTER(pthread_mutex_lock);
   int ret;
 
   if (task_get_current() == 0) {
@@ -71,7 +81,7 @@ int pthread_mutex_lock(pthread_mutex_t *mutex) {
     break;
   }
 
-  SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(SOS_DEBUG_PTHREAD, pthread_mutex_lock, 20);
+  SOS_PROBE_EXIT(pthread_mutex_lock);
   return 0;
 }
 
@@ -118,7 +128,7 @@ int pthread_mutex_trylock(pthread_mutex_t *mutex) {
  *
  */
 int pthread_mutex_unlock(pthread_mutex_t *mutex) {
-  SOS_DEBUG_ENTER_TIMER_SCOPE_AVERAGE(pthread_mutex_unlock);
+  SOS_PROBE_ENTER(pthread_mutex_unlock);
   pthread_mutex_root_unlock_t args;
 
   if (task_get_current() == 0) {
@@ -130,21 +140,23 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex) {
   }
 
   args.id = task_get_current();
-  if (mutex->pthread == args.id) { // Does this thread have a lock?
-    if (mutex->flags & PTHREAD_MUTEX_FLAGS_RECURSIVE) {
+  if (pthread_mutex_get_owner(mutex) == args.id) { // Does this thread have a lock?
+    // the count stays at 1 through the last unlock -- the owner swap releases the mutex
+    if ((mutex->flags & PTHREAD_MUTEX_FLAGS_RECURSIVE) && (mutex->lock > 1)) {
       mutex->lock--;
-      if (mutex->lock != 0) {
-        return 0;
-      }
+      return 0;
     }
   } else {
     errno = EACCES;
     return -1;
   }
 
-  args.mutex = mutex; // The Mutex
-  cortexm_svcall((cortexm_svcall_t)pthread_mutex_svcall_unlock, &args);
-  SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(SOS_DEBUG_PTHREAD, pthread_mutex_unlock, 20);
+  // only enter the kernel if there are waiters or the priority needs to be restored
+  if (mutex_fast_unlock(mutex, args.id) == 0) {
+    args.mutex = mutex; // The Mutex
+    cortexm_svcall((cortexm_svcall_t)pthread_mutex_svcall_unlock, &args);
+  }
+  SOS_PROBE_EXIT(pthread_mutex_unlock);
   return 0;
 }
 
@@ -210,7 +222,7 @@ int pthread_mutex_timedlock(pthread_mutex_t *mutex, const struct timespec *abs_t
     break;
   case -2:
     // Either the lock was acquired or the timeout occurred
-    if (mutex->pthread == task_get_current()) {
+    if (pthread_mutex_get_owner(mutex) == task_get_current()) {
       errno = 0;
       // Lock was acquired
       return 0;
@@ -303,7 +315,7 @@ int mutex_trylock(
   id = task_get_current();
 
   // Does this thread already have a lock?
-  if (mutex->pthread == id) {
+  if (pthread_mutex_get_owner(mutex) == id) {
     // If the mutex is recursive, simply update the count
     if (mutex->flags & PTHREAD_MUTEX_FLAGS_RECURSIVE) {
       // Check the maximum number of locks allowed
@@ -320,7 +332,12 @@ int mutex_trylock(
     }
   }
 
-  // Lock the mutex if it is free
+  // Lock the mutex without entering the kernel if it is free
+  if (mutex_fast_lock(mutex, id)) {
+    return 0;
+  }
+
+  // Lock the mutex if it is free or block until it is
   args.id = id;
   args.mutex = mutex;
   args.trylock = trylock;
@@ -340,9 +357,9 @@ int pthread_mutex_force_unlock(pthread_mutex_t *mutex) {
 
   // All pshared objects must be in shared memory space
   if (mutex->flags & PTHREAD_MUTEX_FLAGS_PSHARED) {
-    if (mutex->pid == getpid() && (mutex->lock != 0)) {
-      args.id = mutex->pthread; // Current owner of the mutex
-      args.mutex = mutex;       // The Mutex
+    if (mutex->pid == getpid() && (pthread_mutex_get_owner(mutex) != -1)) {
+      args.id = pthread_mutex_get_owner(mutex); // Current owner of the mutex
+      args.mutex = mutex; // The Mutex
       cortexm_svcall((cortexm_svcall_t)pthread_mutex_svcall_unlock, &args);
     }
   }
@@ -350,7 +367,40 @@ int pthread_mutex_force_unlock(pthread_mutex_t *mutex) {
   return 0;
 }
 
+int mutex_fast_lock(pthread_mutex_t *mutex, int id) {
+  // the kernel has to elevate the priority of the task if the ceiling is higher
+  if (mutex->prio_ceiling > task_get_priority(id)) {
+    return 0;
+  }
+
+  if (cortexm_compare_and_swap((volatile int *)&mutex->pthread, -1, id) == 0) {
+    return 0;
+  }
+
+  mutex->pid = task_get_pid(id);
+  mutex->lock = 1; // This is the lock count
+  return 1;
+}
+
+int mutex_fast_unlock(pthread_mutex_t *mutex, int id) {
+  // the kernel has to restore the priority if locking the mutex elevated it
+  if (task_get_priority(id) != sos_sched_table[id].attr.schedparam.sched_priority) {
+    return 0;
+  }
+
+  // the swap is the only write: the mutex stays owned (and mutex->lock stays 1) until
+  // it succeeds, so there is no window where another thread sees it half released.
+  // It fails if PTHREAD_MUTEX_PTHREAD_IS_WAITING is set so the kernel hands the
+  // mutex to the best waiter.
+  return cortexm_compare_and_swap((volatile int *)&mutex->pthread, id, -1);
+}
+
 void root_mutex_block(svcall_mutex_trylock_t *args) {
+  // the owner must enter the kernel to unlock so that this task is woken
+  if (args->mutex->pthread != -1) {
+    args->mutex->pthread |= PTHREAD_MUTEX_PTHREAD_IS_WAITING;
+  }
+
   // block the calling mutex
   sos_sched_table[args->id].block_object =
     args->mutex; // Elevate the priority of the task based on prio_ceiling
@@ -359,14 +409,19 @@ void root_mutex_block(svcall_mutex_trylock_t *args) {
 
 void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) {
   CORTEXM_SVCALL_ENTER();
-  if (args->mutex->pthread == args->id) {
+  if (pthread_mutex_get_owner(args->mutex) == args->id) {
     // mutex is locked -- exit loop
     scheduler_root_set_unblock_type(args->id, SCHEDULER_UNBLOCK_MUTEX);
     return;
   }
 
-  // now check to see if abs_time has expired
-  root_mutex_block(args);
+  // the mutex may have been unlocked while the signal was handled
+  args->trylock = false;
+  root_mutex_trylock(args);
+  if (args->result == 0) {
+    scheduler_root_set_unblock_type(args->id, SCHEDULER_UNBLOCK_MUTEX);
+    return;
+  }
 
   // if the time has expired, the thread will still be active -- therefore unblock from
   // SLEEP (not signal)
@@ -377,6 +432,10 @@ void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) {
 
 void svcall_mutex_trylock(svcall_mutex_trylock_t *args) {
   CORTEXM_SVCALL_ENTER();
+  root_mutex_trylock(args);
+}
+
+void root_mutex_trylock(svcall_mutex_trylock_t *args) {
   if (args->mutex->pthread == -1) { // Is the mutex free
     // The mutex is free -- lock it up
     args->mutex->pthread =
@@ -418,7 +477,8 @@ void pthread_mutex_root_unlock(pthread_mutex_root_unlock_t *args) {
   new_thread = scheduler_get_highest_priority_blocked(args->mutex);
 
   if (new_thread > 0) {
-    args->mutex->pthread = new_thread;
+    // other threads may still be blocked -- the new owner's unlock will check
+    args->mutex->pthread = new_thread | PTHREAD_MUTEX_PTHREAD_IS_WAITING;
     args->mutex->pid = task_get_pid(new_thread);
     args->mutex->lock = 1;
 
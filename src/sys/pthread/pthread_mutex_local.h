@@ -4,6 +4,22 @@
 #include <pthread.h>
 #include <sdk/types.h>
 
+// mutex->pthread is -1 when the mutex is free otherwise it is the owner's thread id.
+// This bit is added to the owner while other threads may be blocked on the mutex so
+// that unlocking goes through the kernel to wake them. Without it, the owner can lock
+// and unlock with cortexm_compare_and_swap() and no SVCall. mutex->pthread is the only
+// record of ownership: mutex->lock (the recursion count) is only meaningful to the
+// owner and is not cleared by an unlock that doesn't enter the kernel.
+//
+// armv6-m has no LDREX/STREX so cortexm_compare_and_swap() always fails and every lock
+// and unlock on those cores makes an SVCall.
+#define PTHREAD_MUTEX_PTHREAD_IS_WAITING (1 << 16)
+
+static inline int pthread_mutex_get_owner(const pthread_mutex_t *mutex) {
+  const int pthread = ((const volatile pthread_mutex_t *)mutex)->pthread;
+  return pthread == -1 ? -1 : (pthread & ~PTHREAD_MUTEX_PTHREAD_IS_WAITING);
+}
+
 typedef struct {
   int id;
   pthread_mutex_t *mutex;
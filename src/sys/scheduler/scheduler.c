@@ -20,7 +20,10 @@
 #include "../unistd/unistd_local.h"
 #include "sched.h"
 #include "scheduler_root.h"
+#include "scheduler_timing.h"
+#include "scheduler_wait.h"
 #include "sos/debug.h"
+#include "sos/probe.h"
 
 #include "cortexm/fault_local.h"
 
@@ -59,16 +62,28 @@ int scheduler_check_tid(int id) {
  */
 void scheduler() {
 
+#if CONFIG_SYS_IS_PROBE
+  // task 0 is a root thread until scheduler_prepare() drops privilege
+  sos_probe_check();
+#endif
+
   scheduler_prepare();
 
+#if CONFIG_TRACE_STREAM_SIZE > 0
+  sos_trace_stream_initialize();
+#endif
+
   sos_debug_log_info(SOS_DEBUG_SCHEDULER, "Start first thread");
   start_first_thread();
   while (1) {
     check_faults(); // check to see if a fault needs to be logged
+#if CONFIG_TRACE_STREAM_SIZE > 0
+    sos_trace_stream_poll(); // send full or stale trace blocks
+#endif
 
     // Sleep when nothing else is going on
     if (task_get_exec_count() == 0) {
-      sos_config.sleep.idle();
+      scheduler_timing_idle();
     } else {
       // Otherwise switch to the active task
       sched_yield();
@@ -161,25 +176,24 @@ int check_faults() {
   return 0;
 }
 
+SOS_PROBE_DEFINE(scheduler_critical);
+
 // Called when the task stops or drops in priority (e.g., releases a mutex)
 void scheduler_root_update_on_stopped() {
-  int i;
   s8 next_priority;
 
   // Issue #130
 
-  SOS_DEBUG_ENTER_CYCLE_SCOPE_AVERAGE();
+  SOS_PROBE_ENTER(scheduler_critical);
   cortexm_disable_interrupts();
-  next_priority = CONFIG_SCHED_LOWEST_PRIORITY;
-  for (i = 1; i < task_get_total(); i++) {
-    // Find the highest priority of all active tasks
-    if (task_enabled_active_not_stopped(i) && (task_get_priority(i) > next_priority)) {
-      next_priority = task_get_priority(i);
-    }
+  // Find the highest priority of all active tasks
+  next_priority = task_get_ready_priority();
+  if (next_priority < CONFIG_SCHED_LOWEST_PRIORITY) {
+    next_priority = CONFIG_SCHED_LOWEST_PRIORITY;
   }
   task_root_set_current_priority(next_priority);
   cortexm_enable_interrupts();
-  SOS_DEBUG_EXIT_CYCLE_SCOPE_AVERAGE(SOS_DEBUG_TASK, scheduler_critical, 5000);
+  SOS_PROBE_EXIT(scheduler_critical);
 
   // this will cause an interrupt to execute but at a lower IRQ priority
   task_root_switch_context();
@@ -209,69 +223,42 @@ void scheduler_root_update_on_wake(int id, int new_priority) {
   task_root_switch_context();
 }
 
+static int is_blocked_on(int id, void *block_object) {
+  return task_enabled(id) && (sos_sched_table[id].block_object == block_object)
+         && !task_active_asserted(id);
+}
+
 // this is called from user space?
 int scheduler_get_highest_priority_blocked(void *block_object) {
-  int priority;
-  int i;
-  int new_thread;
-  int current_task = task_get_current();
-
-  // check to see if another task is waiting for the mutex
-  priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  new_thread = -1;
-
-  // Issue #139 - blocked mutexes should be awarded in a round robin fashion started with
-  // the current task
-  if (current_task == 0) {
-    current_task++;
-  }
-  i = current_task + 1;
-  if (i == task_get_total()) {
-    i = 1;
-  }
-  do {
-    if (task_enabled(i)) {
-      if (
-        (sos_sched_table[i].block_object == block_object) && (!task_active_asserted(i))) {
-        // it's waiting for the block -- give the block to the highest priority and
-        // waiting longest
-        if (
-          !task_stopped_asserted(i)
-          && (sos_sched_table[i].attr.schedparam.sched_priority > priority)) {
-          //! \todo Find the task that has been waiting the longest time
-          new_thread = i;
-          priority = sos_sched_table[i].attr.schedparam.sched_priority;
-        }
-      }
-    }
-    // Issue #139
-    i++;
-    if (i == task_get_total()) {
-      i = 1;
+  // the wait queue is ordered by priority then by how long each task has waited
+  int id = scheduler_wait_get_first(block_object);
+  for (int i = 0; id && (i < task_get_total()); i++) {
+    // tasks that were deleted while waiting are skipped
+    if (is_blocked_on(id, block_object) && !task_stopped_asserted(id)) {
+      return id;
     }
-  } while (i != current_task);
-
-  return new_thread;
+    id = scheduler_wait_get_next(id);
+  }
+  return -1;
 }
+
 // This is only called from SVcall so it is always synchronous -- no re-entrancy issues
 // with it
 int scheduler_root_unblock_all(void *block_object, int unblock_type) {
-  int i;
+  int id;
   int priority;
   priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  for (i = 1; i < task_get_total(); i++) {
-    if (task_enabled(i)) {
+  while ((id = scheduler_wait_get_first(block_object)) != 0) {
+    if (is_blocked_on(id, block_object)) {
+      // this removes the task from the wait queue
+      scheduler_root_assert_active(id, unblock_type);
       if (
-        (sos_sched_table[i].block_object == block_object) && (!task_active_asserted(i))) {
-        // it's waiting for the semaphore -- give the semaphore to the highest priority
-        // and waiting longest
-        scheduler_root_assert_active(i, unblock_type);
-        if (
-          !task_stopped_asserted(i)
-          && (sos_sched_table[i].attr.schedparam.sched_priority > priority)) {
-          priority = sos_sched_table[i].attr.schedparam.sched_priority;
-        }
+        !task_stopped_asserted(id)
+        && (sos_sched_table[id].attr.schedparam.sched_priority > priority)) {
+        priority = sos_sched_table[id].attr.schedparam.sched_priority;
       }
+    } else {
+      scheduler_wait_root_remove(id);
     }
   }
   return priority;
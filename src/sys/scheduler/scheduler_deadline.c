@@ -0,0 +1,103 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "scheduler_deadline.h"
+
+static int is_before(const struct mcu_timeval *a, const struct mcu_timeval *b) {
+  return (a->tv_sec < b->tv_sec) || ((a->tv_sec == b->tv_sec) && (a->tv_usec < b->tv_usec));
+}
+
+static void place(scheduler_deadline_queue_t *queue, u16 index, scheduler_deadline_entry_t entry) {
+  queue->entries[index] = entry;
+  queue->position[entry.id] = index + 1;
+}
+
+static void sift_up(scheduler_deadline_queue_t *queue, u16 index) {
+  const scheduler_deadline_entry_t entry = queue->entries[index];
+  while (index > 0) {
+    const u16 parent = (index - 1) / 2;
+    if (!is_before(&entry.value, &queue->entries[parent].value)) {
+      break;
+    }
+    place(queue, index, queue->entries[parent]);
+    index = parent;
+  }
+  place(queue, index, entry);
+}
+
+static void sift_down(scheduler_deadline_queue_t *queue, u16 index) {
+  const scheduler_deadline_entry_t entry = queue->entries[index];
+  while (1) {
+    u16 child = index * 2 + 1;
+    if (child >= queue->count) {
+      break;
+    }
+    if (
+      (child + 1 < queue->count)
+      && is_before(&queue->entries[child + 1].value, &queue->entries[child].value)) {
+      child++;
+    }
+    if (!is_before(&queue->entries[child].value, &entry.value)) {
+      break;
+    }
+    place(queue, index, queue->entries[child]);
+    index = child;
+  }
+  place(queue, index, entry);
+}
+
+void scheduler_deadline_init(
+  scheduler_deadline_queue_t *queue,
+  scheduler_deadline_entry_t *entries,
+  u16 *position,
+  u16 size) {
+  queue->entries = entries;
+  queue->position = position;
+  queue->count = 0;
+  memset(position, 0, size * sizeof(u16));
+}
+
+void scheduler_deadline_set(
+  scheduler_deadline_queue_t *queue,
+  u16 id,
+  const struct mcu_timeval *value) {
+  u16 index = queue->position[id];
+  if (index == 0) {
+    index = queue->count++;
+    place(queue, index, (scheduler_deadline_entry_t){.value = *value, .id = id});
+    sift_up(queue, index);
+    return;
+  }
+
+  index--;
+  const int is_sooner = is_before(value, &queue->entries[index].value);
+  queue->entries[index].value = *value;
+  if (is_sooner) {
+    sift_up(queue, index);
+  } else {
+    sift_down(queue, index);
+  }
+}
+
+void scheduler_deadline_remove(scheduler_deadline_queue_t *queue, u16 id) {
+  const u16 position = queue->position[id];
+  if (position == 0) {
+    return;
+  }
+  queue->position[id] = 0;
+
+  // fill the hole with the last entry
+  const u16 index = position - 1;
+  const u16 last = --queue->count;
+  if (index == last) {
+    return;
+  }
+
+  place(queue, index, queue->entries[last]);
+  if (index > 0 && is_before(&queue->entries[index].value, &queue->entries[(index - 1) / 2].value)) {
+    sift_up(queue, index);
+  } else {
+    sift_down(queue, index);
+  }
+}
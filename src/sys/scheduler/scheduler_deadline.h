@@ -0,0 +1,46 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SCHEDULER_SCHEDULER_DEADLINE_H_
+#define SCHEDULER_SCHEDULER_DEADLINE_H_
+
+#include <sdk/types.h>
+
+/*! \details A deadline queue is a binary min-heap of mcu_timeval values.
+ *
+ * Each entry has an id (such as a task id) that is less than the
+ * number of entries the queue was initialized with. \a position
+ * maps ids to heap entries so an id can be rescheduled or removed in
+ * O(log n) without searching.
+ *
+ */
+typedef struct {
+  struct mcu_timeval value;
+  u16 id;
+} scheduler_deadline_entry_t;
+
+typedef struct {
+  scheduler_deadline_entry_t *entries;
+  u16 *position /*! Index + 1 of each id in \a entries (0 if the id is not queued) */;
+  u16 count;
+} scheduler_deadline_queue_t;
+
+void scheduler_deadline_init(
+  scheduler_deadline_queue_t *queue,
+  scheduler_deadline_entry_t *entries,
+  u16 *position,
+  u16 size);
+
+// adds the id or moves it if it is already queued
+void scheduler_deadline_set(
+  scheduler_deadline_queue_t *queue,
+  u16 id,
+  const struct mcu_timeval *value);
+
+void scheduler_deadline_remove(scheduler_deadline_queue_t *queue, u16 id);
+
+static inline const scheduler_deadline_entry_t *
+scheduler_deadline_first(const scheduler_deadline_queue_t *queue) {
+  return queue->count ? queue->entries : NULL;
+}
+
+#endif /* SCHEDULER_SCHEDULER_DEADLINE_H_ */
@@ -9,6 +9,7 @@
 /*! \file */
 #include "scheduler_fault.h"
 #include "scheduler_timing.h"
+#include "scheduler_trace.h"
 
 #include "cortexm/fault_local.h"
 #include "sos/debug.h"
@@ -33,6 +34,9 @@ void scheduler_init() {
     sos_task_table[i] = (task_t){};
     sos_sched_table[i] = (sched_task_t){};
   }
+#if CONFIG_SCHED_IS_TRACE
+  scheduler_trace_init();
+#endif
 
   // Do basic init of task 0 so that memory allocation can happen before the scheduler
   // starts
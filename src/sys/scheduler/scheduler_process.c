@@ -14,6 +14,7 @@
 
 #include "scheduler_root.h"
 #include "scheduler_timing.h"
+#include "scheduler_trace.h"
 
 typedef struct {
   task_memories_t *mem;
@@ -103,6 +104,7 @@ void svcall_init_sched_task(init_sched_task_t *task) {
   sos_sched_table[id].wake.tv_usec = 0;
   scheduler_root_assert_cancel_enable(id);
   scheduler_root_deassert_cancel_asynchronous(id);
+  SCHEDULER_TRACE_START(id);
   scheduler_root_assert_active(id, 0);
   scheduler_root_assert_inuse(id);
   scheduler_root_update_on_wake(id, task_get_priority(id));
@@ -9,6 +9,9 @@
 /*! \file */
 
 #include "scheduler_root.h"
+#include "scheduler_timing.h"
+#include "scheduler_trace.h"
+#include "scheduler_wait.h"
 
 void scheduler_svcall_set_delaymutex(void *args) {
   CORTEXM_SVCALL_ENTER();
@@ -20,18 +23,21 @@ void scheduler_root_set_trace_id(int tid, trace_id_t id) {
 }
 
 void scheduler_root_assert_active(int id, int unblock_type) {
+  SCHEDULER_TRACE_WAKE(id, unblock_type);
   task_assert_active(id);
   scheduler_root_set_unblock_type(id, unblock_type);
   scheduler_root_deassert_aiosuspend(id);
   // Remove all blocks (mutex, timing, etc)
   sos_sched_table[id].block_object = NULL;
+  scheduler_wait_root_remove(id);
   sos_sched_table[id].wake.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   sos_sched_table[id].wake.tv_usec = 0;
+  scheduler_timing_root_update_wake(id);
 }
 
 void scheduler_root_deassert_active(int id) {
-  task_deassert_active(id);
-  task_deassert_exec(id); // stop executing the task
+  SCHEDULER_TRACE_BLOCK(id);
+  task_deassert_active(id); // also stops executing the task
 }
 
 
@@ -12,6 +12,7 @@
 #include "cortexm/cortexm.h"
 #include "scheduler_root.h"
 #include "scheduler_timing.h"
+#include "scheduler_trace.h"
 #include "sos/debug.h"
 #include "sos/dev/sys.h"
 #include "sys/malloc/malloc_local.h"
@@ -112,6 +113,7 @@ void svcall_activate_thread(svcall_activate_thread_t *args) {
   sos_sched_table[id].wake.tv_usec = 0;
   scheduler_root_assert_cancel_enable(id);
   scheduler_root_deassert_cancel_asynchronous(id);
+  SCHEDULER_TRACE_START(id);
   scheduler_root_assert_active(id, 0);
   scheduler_root_assert_inuse(id);
   if (scheduler_authenticated_asserted(task_get_current())) {
@@ -10,19 +10,60 @@
 #include "../signal/sig_local.h"
 #include "cortexm/cortexm.h"
 
+#include "scheduler_deadline.h"
 #include "scheduler_root.h"
 #include "scheduler_timing.h"
+#include "scheduler_wait.h"
 
 #include "sos/debug.h"
 
 static volatile u32 sched_usecond_counter MCU_SYS_MEM;
 
+// sleeping tasks ordered by wake time (the id is the task id)
+static scheduler_deadline_queue_t m_wake_queue MCU_SYS_MEM;
+static scheduler_deadline_entry_t m_wake_entries[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
+static u16 m_wake_position[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
+
+static void update_deadline(
+  scheduler_deadline_queue_t *queue,
+  u16 id,
+  const volatile struct mcu_timeval *value) MCU_ROOT_EXEC_CODE;
+static int pop_expired_deadline(scheduler_deadline_queue_t *queue, u32 now)
+  MCU_ROOT_EXEC_CODE;
+static u32 get_next_deadline(scheduler_deadline_queue_t *queue) MCU_ROOT_EXEC_CODE;
+
+// idle residency -- wake_reason is SYS_IDLE_WAKE_REASON_TOTAL until something
+// ends the current idle period
+typedef struct {
+  sys_idle_stats_t stats;
+  struct mcu_timeval start;
+  u32 tick_count;
+  u32 second;
+  u32 second_wakeup_count;
+  volatile u8 wake_reason;
+} idle_t;
+
+static idle_t m_idle MCU_SYS_MEM;
+
+static void set_wake_reason(u8 reason) MCU_ROOT_EXEC_CODE;
+static void update_wakeups_per_second(u32 second) MCU_ROOT_EXEC_CODE;
+static void svcall_enter_idle(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_exit_idle(void *args) MCU_ROOT_EXEC_CODE;
+
 static int root_handle_usecond_overflow_event(void *context, const mcu_event_t *data)
   MCU_ROOT_EXEC_CODE;
 static int root_handle_usecond_match_event(void *context, const mcu_event_t *data)
   MCU_ROOT_EXEC_CODE;
 
 #if CONFIG_TASK_PROCESS_TIMER_COUNT
+// process timers ordered by expiration (the id is task id * timer count + offset)
+#define PROCESS_TIMER_TOTAL (CONFIG_TASK_TOTAL * CONFIG_TASK_PROCESS_TIMER_COUNT)
+static scheduler_deadline_queue_t m_timer_queue MCU_SYS_MEM;
+static scheduler_deadline_entry_t m_timer_entries[PROCESS_TIMER_TOTAL] MCU_SYS_MEM;
+static u16 m_timer_position[PROCESS_TIMER_TOTAL] MCU_SYS_MEM;
+
+static void update_timer_deadline(volatile sos_process_timer_t *timer) MCU_ROOT_EXEC_CODE;
+
 static int root_handle_usecond_process_timer_match_event(
   void *context,
   const mcu_event_t *data) MCU_ROOT_EXEC_CODE;
@@ -61,6 +102,11 @@ u64 scheduler_timing_real64usec(struct mcu_timeval *tv) {
 #endif
 
 void scheduler_timing_init() {
+  scheduler_deadline_init(&m_wake_queue, m_wake_entries, m_wake_position, CONFIG_TASK_TOTAL);
+#if CONFIG_TASK_PROCESS_TIMER_COUNT > 0
+  scheduler_deadline_init(
+    &m_timer_queue, m_timer_entries, m_timer_position, PROCESS_TIMER_TOTAL);
+#endif
   sos_config.clock.initialize(
     root_handle_usecond_match_event, ROOT_HANDLE_USECOND_PROCESS_TIMER_MATCH_EVENT,
     root_handle_usecond_overflow_event);
@@ -117,10 +163,122 @@ void scheduler_timing_root_timedblock(void *block_object, struct mcu_timeval *ab
 
   // only sleep if the time hasn't already passed
   if (is_time_to_sleep) {
+    scheduler_wait_root_enqueue(id, block_object);
+    scheduler_timing_root_update_wake(id);
     scheduler_root_update_on_sleep();
   }
 }
 
+void scheduler_timing_root_update_wake(int id) {
+  update_deadline(&m_wake_queue, id, &sos_sched_table[id].wake);
+}
+
+void update_deadline(
+  scheduler_deadline_queue_t *queue,
+  u16 id,
+  const volatile struct mcu_timeval *value) {
+  const struct mcu_timeval deadline = {.tv_sec = value->tv_sec, .tv_usec = value->tv_usec};
+
+  // tasks can be woken by interrupts that preempt the usecond timer
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  if (deadline.tv_sec == SCHEDULER_TIMEVAL_SEC_INVALID) {
+    scheduler_deadline_remove(queue, id);
+  } else {
+    scheduler_deadline_set(queue, id, &deadline);
+  }
+  __set_PRIMASK(primask);
+}
+
+int pop_expired_deadline(scheduler_deadline_queue_t *queue, u32 now) {
+  int id = -1;
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const scheduler_deadline_entry_t *first = scheduler_deadline_first(queue);
+  if (
+    first
+    && ((first->value.tv_sec < sched_usecond_counter)
+        || ((first->value.tv_sec == sched_usecond_counter)
+            && (first->value.tv_usec <= now)))) {
+    id = first->id;
+    scheduler_deadline_remove(queue, id);
+  }
+  __set_PRIMASK(primask);
+  return id;
+}
+
+u32 get_next_deadline(scheduler_deadline_queue_t *queue) {
+  // deadlines in a later second are handled after the overflow event
+  u32 next = SOS_USECOND_PERIOD;
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const scheduler_deadline_entry_t *first = scheduler_deadline_first(queue);
+  if (first && (first->value.tv_sec == sched_usecond_counter)) {
+    next = first->value.tv_usec;
+  }
+  __set_PRIMASK(primask);
+  return next;
+}
+
+void scheduler_timing_idle() {
+  cortexm_svcall(svcall_enter_idle, NULL);
+  sos_config.sleep.idle();
+  cortexm_svcall(svcall_exit_idle, NULL);
+}
+
+void svcall_enter_idle(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  MCU_UNUSED_ARGUMENT(args);
+  m_idle.wake_reason = SYS_IDLE_WAKE_REASON_TOTAL;
+  m_idle.tick_count = task_get_tick_count();
+  scheduler_timing_root_get_realtime(&m_idle.start);
+}
+
+void svcall_exit_idle(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  MCU_UNUSED_ARGUMENT(args);
+  struct mcu_timeval now;
+  scheduler_timing_root_get_realtime(&now);
+
+  u8 reason = m_idle.wake_reason;
+  if (reason == SYS_IDLE_WAKE_REASON_TOTAL) {
+    reason = (task_get_tick_count() != m_idle.tick_count) ? SYS_IDLE_WAKE_REASON_TICK
+                                                          : SYS_IDLE_WAKE_REASON_OTHER;
+  }
+
+  m_idle.stats.idle_usec +=
+    scheduler_timing_real64usec(&now) - scheduler_timing_real64usec(&m_idle.start);
+  m_idle.stats.wakeup_count++;
+  m_idle.stats.wake_reason_count[reason]++;
+  update_wakeups_per_second(now.tv_sec);
+  m_idle.second_wakeup_count++;
+}
+
+void update_wakeups_per_second(u32 second) {
+  if (second != m_idle.second) {
+    // only a full second that just ended is reported
+    m_idle.stats.wakeups_per_second =
+      (second == m_idle.second + 1) ? m_idle.second_wakeup_count : 0;
+    m_idle.second = second;
+    m_idle.second_wakeup_count = 0;
+  }
+}
+
+void set_wake_reason(u8 reason) {
+  // the first event to end an idle period is the reason for waking
+  if (m_idle.wake_reason == SYS_IDLE_WAKE_REASON_TOTAL) {
+    m_idle.wake_reason = reason;
+  }
+}
+
+void scheduler_timing_root_get_idle_stats(sys_idle_stats_t *stats) {
+  struct mcu_timeval now;
+  scheduler_timing_root_get_realtime(&now);
+  update_wakeups_per_second(now.tv_sec);
+  *stats = m_idle.stats;
+  stats->uptime_usec = scheduler_timing_real64usec(&now);
+}
+
 void scheduler_timing_convert_timespec(
   struct mcu_timeval *tv,
   const struct timespec *ts) {
@@ -198,6 +356,23 @@ void scheduler_timing_root_get_realtime(struct mcu_timeval *tv) {
   sos_config.clock.enable();
 }
 
+void scheduler_timing_svcall_get_timestamp(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  scheduler_timing_root_get_timestamp(args);
+}
+
+void scheduler_timing_root_get_timestamp(struct mcu_timeval *tv) {
+  // unlike get_realtime() the clock keeps running; the retry only catches an
+  // overflow that is handled during the read -- with interrupts disabled the
+  // overflow stays pending and the result can be up to one period behind
+  u32 seconds;
+  do {
+    seconds = sched_usecond_counter;
+    tv->tv_usec = sos_config.clock.microseconds();
+  } while (seconds != sched_usecond_counter);
+  tv->tv_sec = seconds;
+}
+
 int root_handle_usecond_overflow_event(void *context, const mcu_event_t *data) {
   MCU_UNUSED_ARGUMENT(context);
   MCU_UNUSED_ARGUMENT(data);
@@ -206,6 +381,7 @@ int root_handle_usecond_overflow_event(void *context, const mcu_event_t *data) {
 #if CONFIG_TASK_PROCESS_TIMER_COUNT > 0
   root_handle_usecond_process_timer_match_event(0, 0);
 #endif
+  set_wake_reason(SYS_IDLE_WAKE_REASON_CLOCK);
   sos_config.clock.enable();
   return 1; // do not clear callback
 }
@@ -220,32 +396,24 @@ int root_handle_usecond_match_event(void *context, const mcu_event_t *data) {
     .value = SOS_USECOND_PERIOD + 1};
 
   int new_priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  u32 next = SOS_USECOND_PERIOD;
 
   u32 now = sos_config.clock.disable();
 
-  for (int i = 1; i < task_get_total(); i++) {
-
+  int i;
+  while ((i = pop_expired_deadline(&m_wake_queue, now)) >= 0) {
+    // the task may have been deleted while sleeping
     if (task_enabled_not_active(i)) {
-      u32 tmp = sos_sched_table[i].wake.tv_usec;
-
-      // compare the current clock to the wake time
-      if (
-        (sos_sched_table[i].wake.tv_sec < sched_usecond_counter)
-        || ((sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp <= now))) {
-        // wake this task
-        scheduler_root_assert_active(i, SCHEDULER_UNBLOCK_SLEEP);
-        if (!task_stopped_asserted(i) && (scheduler_priority(i) > new_priority)) {
-          new_priority = scheduler_priority(i);
-        }
-
-      } else if (
-        (sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp < next)) {
-        // see if this is the next event to wake up
-        next = tmp;
+      // wake this task
+      scheduler_root_assert_active(i, SCHEDULER_UNBLOCK_SLEEP);
+      set_wake_reason(SYS_IDLE_WAKE_REASON_SLEEP);
+      if (!task_stopped_asserted(i) && (scheduler_priority(i) > new_priority)) {
+        new_priority = scheduler_priority(i);
       }
     }
   }
+
+  // see if this is the next event to wake up
+  const u32 next = get_next_deadline(&m_wake_queue);
   if (next < SOS_USECOND_PERIOD) {
     chan_req.value = next;
   }
@@ -268,45 +436,25 @@ int root_handle_usecond_process_timer_match_event(
   mcu_channel_t chan_req = {
     .loc = SCHED_USECOND_TMR_SYSTEM_TIMER_OC,
     .value = SOS_USECOND_PERIOD + 1};
-  u32 next = SOS_USECOND_PERIOD;
-
   u32 now = sos_config.clock.disable();
 
-  for (int i = 1; i < task_get_total(); i++) {
-    // look for the next signal
-
-    if (task_enabled(i)) {
-
-      for (int j = 0; j < CONFIG_TASK_PROCESS_TIMER_COUNT; j++) {
-        volatile sos_process_timer_t *timer = sos_sched_table[i].timer + j;
-
-        if (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED) {
-          u32 tmp = timer->value.tv_usec;
-          if (
-            (timer->value.tv_sec < sched_usecond_counter) // seconds are in the past
-            // seconds are the sae and useconds are in the past
-            || ((timer->value.tv_sec == sched_usecond_counter) && (tmp <= now))) {
-
-            // reload the timer if interval is valid
-            send_and_reload_timer(timer, i, now);
-
-            // if interval value is non-zero, need to check if this is less than next
-            if (timer->interval.tv_sec + timer->interval.tv_usec) {
-              tmp = timer->value.tv_usec;
-              if ((timer->value.tv_sec == sched_usecond_counter) && (tmp < next)) {
-                next = tmp;
-              }
-            }
+  int id;
+  while ((id = pop_expired_deadline(&m_timer_queue, now)) >= 0) {
+    const int task_id = id / CONFIG_TASK_PROCESS_TIMER_COUNT;
+    volatile sos_process_timer_t *timer =
+      sos_sched_table[task_id].timer + id % CONFIG_TASK_PROCESS_TIMER_COUNT;
 
-          } else if ((timer->value.tv_sec == sched_usecond_counter) && (tmp < next)) {
-            // see if this is the next event to wake up
-            next = tmp;
-          }
-        }
-      }
+    if (
+      task_enabled(task_id)
+      && (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED)) {
+      // reload the timer if interval is valid (this queues it again)
+      send_and_reload_timer(timer, task_id, now);
+      set_wake_reason(SYS_IDLE_WAKE_REASON_TIMER);
     }
   }
 
+  // see if this is the next event to wake up
+  const u32 next = get_next_deadline(&m_timer_queue);
   if (next < SOS_USECOND_PERIOD) {
     chan_req.value = next;
   }
@@ -359,6 +507,7 @@ void root_allocate_timer(void *args) {
     timer->interval.tv_sec = 0;
     timer->interval.tv_usec = 0;
     timer->o_flags = SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED;
+    update_timer_deadline(timer);
 
     cortexm_assign_zero_sum32((void *)timer, sizeof(sos_process_timer_t) / sizeof(u32));
     p->result = 0;
@@ -370,6 +519,7 @@ void root_allocate_timer(void *args) {
 void scheduler_timing_root_process_timer_initialize(u16 task_id) {
   for (int i = 0; i < CONFIG_TASK_PROCESS_TIMER_COUNT; i++) {
     sos_sched_table[task_id].timer[i] = (sos_process_timer_t){};
+    update_timer_deadline(sos_sched_table[task_id].timer + i);
   }
 
   // the first available timer slot is reserved for alarm/ualarm
@@ -417,6 +567,7 @@ void svcall_delete_timer(void *args) {
   }
 
   *timer = (sos_process_timer_t){};
+  update_timer_deadline(timer);
   cortexm_assign_zero_sum32((void *)timer, sizeof(sos_process_timer_t) / sizeof(u32));
   p->result = 0;
 }
@@ -449,6 +600,7 @@ void svcall_cancel_timer(void *args) {
   timer->interval.tv_sec = 0;
   timer->interval.tv_usec = 0;
   timer->o_flags = SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED;
+  update_timer_deadline(timer);
 
   cortexm_assign_zero_sum32((void *)timer, sizeof(sos_process_timer_t) / sizeof(u32));
   p->result = 0;
@@ -517,6 +669,7 @@ void svcall_settime(void *args) {
   }
 
   // stop the timer -- see if event is in past, assign the values, start the timer
+  update_timer_deadline(timer);
   update_tmr_for_process_timer_match(timer);
 
   cortexm_assign_zero_sum32((void *)timer, sizeof(sos_process_timer_t) / sizeof(u32));
@@ -649,9 +802,23 @@ int send_and_reload_timer(volatile sos_process_timer_t *timer, u8 task_id, u32 n
   } else {
     timer->value.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   }
+  update_timer_deadline(timer);
   return 0;
 }
 
+void update_timer_deadline(volatile sos_process_timer_t *timer) {
+  const int task_id = ((u32)timer - (u32)sos_sched_table) / sizeof(sched_task_t);
+  const u16 id = task_id * CONFIG_TASK_PROCESS_TIMER_COUNT
+                 + (timer - sos_sched_table[task_id].timer);
+
+  if (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED) {
+    update_deadline(&m_timer_queue, id, &timer->value);
+  } else {
+    update_deadline(
+      &m_timer_queue, id, &(struct mcu_timeval){SCHEDULER_TIMEVAL_SEC_INVALID, 0});
+  }
+}
+
 void update_tmr_for_process_timer_match(volatile sos_process_timer_t *timer) {
 
 
@@ -4,17 +4,28 @@
 #ifndef SCHEDULER_SCHEDULER_TIMING_H_
 #define SCHEDULER_SCHEDULER_TIMING_H_
 
+#include "sos/dev/sys.h"
+
 #include "scheduler_local.h"
 
 void scheduler_timing_init();
 
 u32 scheduler_timing_useconds_to_clocks(int useconds);
 void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * interval);
+//keeps the sleep queue in sync with sos_sched_table[id].wake
+void scheduler_timing_root_update_wake(int id) MCU_ROOT_EXEC_CODE;
+
+//calls sos_config.sleep.idle() and records idle residency
+void scheduler_timing_idle();
+void scheduler_timing_root_get_idle_stats(sys_idle_stats_t * stats) MCU_ROOT_EXEC_CODE;
 
 void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts);
 void scheduler_timing_convert_mcu_timeval(struct timespec * ts, const struct mcu_timeval * mcu_tv);
 void scheduler_timing_svcall_get_realtime(void * args) MCU_ROOT_EXEC_CODE;
 void scheduler_timing_root_get_realtime(struct mcu_timeval * tv) MCU_ROOT_CODE;
+//reads the raw clock without stopping it (for timestamping trace records)
+void scheduler_timing_svcall_get_timestamp(void * args) MCU_ROOT_EXEC_CODE;
+void scheduler_timing_root_get_timestamp(struct mcu_timeval * tv) MCU_ROOT_CODE;
 
 struct mcu_timeval scheduler_timing_add_mcu_timeval(const struct mcu_timeval * a, const struct mcu_timeval * b);
 struct mcu_timeval scheduler_timing_subtract_mcu_timeval(const struct mcu_timeval * a, const struct mcu_timeval * b);
@@ -0,0 +1,217 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+
+#include "config.h"
+#include "sos/fs/sysfs.h"
+
+#include "scheduler_timing.h"
+#include "scheduler_trace.h"
+
+#if CONFIG_SCHED_IS_TRACE
+
+#if (CONFIG_SCHED_TRACE_COUNT & (CONFIG_SCHED_TRACE_COUNT - 1)) != 0
+#error "CONFIG_SCHED_TRACE_COUNT must be a power of two"
+#endif
+
+#define TRACE_MASK (CONFIG_SCHED_TRACE_COUNT - 1)
+
+enum {
+  TASK_STATE_STOPPED,
+  TASK_STATE_READY,
+  TASK_STATE_RUNNING
+};
+
+typedef struct {
+  u64 mark /*! When the task started running or became ready */;
+  u64 run_usec;
+  u64 wait_usec;
+  u32 max_wait_usec;
+  u32 switch_count;
+  u32 preempt_count;
+  u32 wake_count;
+  u32 block_count;
+  u8 state;
+} trace_task_t;
+
+static sys_sched_trace_event_t m_trace_event[CONFIG_SCHED_TRACE_COUNT] MCU_SYS_MEM;
+static u32 m_trace_head MCU_SYS_MEM;
+static trace_task_t m_trace_task[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
+
+static u64 get_now() {
+  struct mcu_timeval now;
+  scheduler_timing_root_get_timestamp(&now);
+  return scheduler_timing_real64usec(&now);
+}
+
+// the clock can read low while its overflow interrupt is pending
+static u32 get_elapsed(u64 now, u64 mark) { return now > mark ? now - mark : 0; }
+
+static void write_record(u64 now, u8 type, int tid, u16 arg, u32 value) {
+  sys_sched_trace_event_t *event = m_trace_event + (m_trace_head & TRACE_MASK);
+  event->timestamp = now;
+  event->type = type;
+  event->tid = tid;
+  event->arg = arg;
+  event->value = value;
+  m_trace_head++;
+}
+
+void scheduler_trace_init() {
+  m_trace_head = 0;
+  for (int i = 0; i < CONFIG_TASK_TOTAL; i++) {
+    m_trace_task[i] = (trace_task_t){};
+  }
+}
+
+void scheduler_trace_root_switch(int from, int to) {
+  if (from == to) {
+    return;
+  }
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const u64 now = get_now();
+  trace_task_t *task = m_trace_task + from;
+  const int is_preempted = task_active_asserted(from) != 0;
+  task->run_usec += get_elapsed(now, task->mark);
+  task->mark = now;
+  if (is_preempted) {
+    task->preempt_count++;
+    task->state = TASK_STATE_READY;
+  } else {
+    task->state = TASK_STATE_STOPPED;
+  }
+
+  task = m_trace_task + to;
+  if (task->state == TASK_STATE_READY) {
+    const u32 wait_usec = get_elapsed(now, task->mark);
+    task->wait_usec += wait_usec;
+    if (wait_usec > task->max_wait_usec) {
+      task->max_wait_usec = wait_usec;
+    }
+  }
+  task->mark = now;
+  task->state = TASK_STATE_RUNNING;
+  task->switch_count++;
+
+  write_record(now, SYS_SCHED_TRACE_TYPE_SWITCH, to, from, is_preempted);
+  __set_PRIMASK(primask);
+}
+
+void scheduler_trace_root_wake(int id, int unblock_type) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const u64 now = get_now();
+  trace_task_t *task = m_trace_task + id;
+  if (task->state == TASK_STATE_STOPPED) {
+    task->mark = now;
+    task->state = TASK_STATE_READY;
+  }
+  task->wake_count++;
+  write_record(now, SYS_SCHED_TRACE_TYPE_WAKE, id, unblock_type, task_get_current());
+  __set_PRIMASK(primask);
+}
+
+void scheduler_trace_root_block(int id) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const u64 now = get_now();
+  trace_task_t *task = m_trace_task + id;
+  if (task->state == TASK_STATE_READY) {
+    // a task that is not running stops waiting now (running tasks switch out later)
+    task->wait_usec += get_elapsed(now, task->mark);
+    task->state = TASK_STATE_STOPPED;
+  }
+  task->block_count++;
+  write_record(
+    now, SYS_SCHED_TRACE_TYPE_BLOCK, id, 0, (u32)sos_sched_table[id].block_object);
+  __set_PRIMASK(primask);
+}
+
+void scheduler_trace_root_start(int id) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const u64 now = get_now();
+  m_trace_task[id] = (trace_task_t){};
+  write_record(now, SYS_SCHED_TRACE_TYPE_START, id, 0, task_get_pid(id));
+  __set_PRIMASK(primask);
+}
+
+void scheduler_trace_root_event_enter(const void *callback) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  write_record(
+    get_now(), SYS_SCHED_TRACE_TYPE_EVENT_ENTER, task_get_current(),
+    __get_IPSR() & 0x1ff, (u32)callback);
+  __set_PRIMASK(primask);
+}
+
+void scheduler_trace_root_event_exit(int result) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  write_record(
+    get_now(), SYS_SCHED_TRACE_TYPE_EVENT_EXIT, task_get_current(),
+    __get_IPSR() & 0x1ff, result);
+  __set_PRIMASK(primask);
+}
+
+int scheduler_trace_root_read(sys_sched_trace_t *trace) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const u32 head = m_trace_head;
+  const u32 oldest = head > CONFIG_SCHED_TRACE_COUNT ? head - CONFIG_SCHED_TRACE_COUNT : 0;
+  u32 sequence = trace->sequence;
+  trace->lost_count = 0;
+  if (sequence > head) {
+    // the kernel restarted since the caller's last read
+    sequence = oldest;
+  } else if (sequence < oldest) {
+    trace->lost_count = oldest - sequence;
+    sequence = oldest;
+  }
+
+  u32 count = 0;
+  while ((sequence != head) && (count < SYS_SCHED_TRACE_EVENT_COUNT)) {
+    trace->event[count++] = m_trace_event[sequence & TRACE_MASK];
+    sequence++;
+  }
+  __set_PRIMASK(primask);
+
+  trace->sequence = sequence - count;
+  trace->next_sequence = sequence;
+  trace->count = count;
+  return count;
+}
+
+int scheduler_trace_root_get_stats(sys_sched_stats_t *stats) {
+  const u32 tid = stats->tid;
+  if ((tid >= CONFIG_TASK_TOTAL) || !task_enabled(tid)) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const u64 now = get_now();
+  const trace_task_t *task = m_trace_task + tid;
+  *stats = (sys_sched_stats_t){
+    .tid = tid,
+    .pid = task_get_pid(tid),
+    .run_usec = task->run_usec,
+    .wait_usec = task->wait_usec,
+    .max_wait_usec = task->max_wait_usec,
+    .switch_count = task->switch_count,
+    .preempt_count = task->preempt_count,
+    .wake_count = task->wake_count,
+    .block_count = task->block_count};
+  // include the time since the last switch
+  if (task->state == TASK_STATE_RUNNING) {
+    stats->run_usec += get_elapsed(now, task->mark);
+  } else if (task->state == TASK_STATE_READY) {
+    stats->wait_usec += get_elapsed(now, task->mark);
+  }
+  __set_PRIMASK(primask);
+  return 0;
+}
+
+#endif
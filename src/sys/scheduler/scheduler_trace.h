@@ -0,0 +1,54 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SCHEDULER_SCHEDULER_TRACE_H_
+#define SCHEDULER_SCHEDULER_TRACE_H_
+
+#include "config.h"
+#include "sos/dev/sys.h"
+
+#include "scheduler_local.h"
+
+/*! \details Scheduler tracepoints (CONFIG_SCHED_IS_TRACE).
+ *
+ * The hooks below are called by the context switcher, when tasks are
+ * made active or inactive and around device event handlers. Each one
+ * adds a record to a ring that keeps the newest records and updates
+ * the task's run and wait time. Without CONFIG_SCHED_IS_TRACE the
+ * hooks compile to nothing.
+ *
+ */
+
+#if CONFIG_SCHED_IS_TRACE
+
+#define SCHEDULER_TRACE_SWITCH(from, to) scheduler_trace_root_switch(from, to)
+#define SCHEDULER_TRACE_WAKE(id, unblock_type) scheduler_trace_root_wake(id, unblock_type)
+#define SCHEDULER_TRACE_BLOCK(id) scheduler_trace_root_block(id)
+#define SCHEDULER_TRACE_START(id) scheduler_trace_root_start(id)
+#define SCHEDULER_TRACE_EVENT_ENTER(callback) scheduler_trace_root_event_enter(callback)
+#define SCHEDULER_TRACE_EVENT_EXIT(result) scheduler_trace_root_event_exit(result)
+
+void scheduler_trace_init();
+void scheduler_trace_root_switch(int from, int to) MCU_ROOT_EXEC_CODE;
+void scheduler_trace_root_wake(int id, int unblock_type) MCU_ROOT_EXEC_CODE;
+void scheduler_trace_root_block(int id) MCU_ROOT_EXEC_CODE;
+void scheduler_trace_root_start(int id) MCU_ROOT_EXEC_CODE;
+void scheduler_trace_root_event_enter(const void *callback) MCU_ROOT_EXEC_CODE;
+void scheduler_trace_root_event_exit(int result) MCU_ROOT_EXEC_CODE;
+
+// get_stats returns SYSFS_SET_RETURN(EINVAL) if the tid is not in use
+int scheduler_trace_root_read(sys_sched_trace_t *trace) MCU_ROOT_EXEC_CODE;
+int scheduler_trace_root_get_stats(sys_sched_stats_t *stats) MCU_ROOT_EXEC_CODE;
+
+#else
+
+// from is often a local that is only kept for the trace
+#define SCHEDULER_TRACE_SWITCH(from, to) MCU_UNUSED_ARGUMENT(from)
+#define SCHEDULER_TRACE_WAKE(id, unblock_type)
+#define SCHEDULER_TRACE_BLOCK(id)
+#define SCHEDULER_TRACE_START(id)
+#define SCHEDULER_TRACE_EVENT_ENTER(callback)
+#define SCHEDULER_TRACE_EVENT_EXIT(result)
+
+#endif
+
+#endif /* SCHEDULER_SCHEDULER_TRACE_H_ */
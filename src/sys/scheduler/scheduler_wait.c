@@ -0,0 +1,124 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "config.h"
+
+#include "scheduler_wait.h"
+
+#define BUCKET_COUNT 16
+
+typedef struct {
+  volatile void *object /*! The object the task is queued on (NULL if not queued) */;
+  s8 priority /*! The priority the task was queued with */;
+  u8 next;
+  u8 previous /*! 0 if the task is first in its queue */;
+  u8 bucket_next /*! The first task of the next queue in the same bucket */;
+} wait_node_t;
+
+static wait_node_t m_wait_node[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
+static u8 m_wait_bucket[BUCKET_COUNT] MCU_SYS_MEM;
+
+static u32 get_bucket(volatile void *object) {
+  const u32 address = (u32)object;
+  return ((address >> 2) ^ (address >> 6) ^ (address >> 10)) % BUCKET_COUNT;
+}
+
+// replaces the first task of a queue in the bucket chain (replacement is 0 to remove it)
+static void replace_first(u32 bucket, u8 id, u8 replacement) {
+  volatile u8 *link = m_wait_bucket + bucket;
+  while (*link != id) {
+    link = &m_wait_node[*link].bucket_next;
+  }
+  if (replacement) {
+    m_wait_node[replacement].bucket_next = m_wait_node[id].bucket_next;
+    *link = replacement;
+  } else {
+    *link = m_wait_node[id].bucket_next;
+  }
+}
+
+static void remove_task(int id) {
+  wait_node_t *node = m_wait_node + id;
+  if (node->object == NULL) {
+    return;
+  }
+
+  if (node->previous) {
+    m_wait_node[node->previous].next = node->next;
+  } else {
+    replace_first(get_bucket(node->object), id, node->next);
+  }
+  if (node->next) {
+    m_wait_node[node->next].previous = node->previous;
+  }
+  node->object = NULL;
+}
+
+void scheduler_wait_root_enqueue(int id, volatile void *object) {
+  if ((id <= 0) || (id >= task_get_total()) || (object == NULL)) {
+    return;
+  }
+
+  // this is called from interrupts that can preempt each other
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+
+  remove_task(id);
+
+  wait_node_t *node = m_wait_node + id;
+  node->object = object;
+  node->priority = sos_sched_table[id].attr.schedparam.sched_priority;
+  node->next = 0;
+  node->previous = 0;
+
+  const u32 bucket = get_bucket(object);
+  const int first = scheduler_wait_get_first(object);
+  if (first == 0) {
+    node->bucket_next = m_wait_bucket[bucket];
+    m_wait_bucket[bucket] = id;
+  } else if (node->priority > m_wait_node[first].priority) {
+    node->next = first;
+    replace_first(bucket, first, id);
+    m_wait_node[first].previous = id;
+  } else {
+    // insert after the last task with the same or higher priority
+    u8 previous = first;
+    while (
+      m_wait_node[previous].next
+      && (m_wait_node[m_wait_node[previous].next].priority >= node->priority)) {
+      previous = m_wait_node[previous].next;
+    }
+    node->previous = previous;
+    node->next = m_wait_node[previous].next;
+    if (node->next) {
+      m_wait_node[node->next].previous = id;
+    }
+    m_wait_node[previous].next = id;
+  }
+
+  __set_PRIMASK(primask);
+}
+
+void scheduler_wait_root_remove(int id) {
+  if ((id <= 0) || (id >= task_get_total())) {
+    return;
+  }
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  remove_task(id);
+  __set_PRIMASK(primask);
+}
+
+int scheduler_wait_get_first(volatile void *object) {
+  // the bucket chain can't be longer than the number of tasks
+  u8 id = m_wait_bucket[get_bucket(object)];
+  for (int i = 0; id && (i < CONFIG_TASK_TOTAL); i++) {
+    if (m_wait_node[id].object == object) {
+      return id;
+    }
+    id = m_wait_node[id].bucket_next;
+  }
+  return 0;
+}
+
+int scheduler_wait_get_next(int id) { return m_wait_node[id].next; }
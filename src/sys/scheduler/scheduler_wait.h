@@ -0,0 +1,31 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SCHEDULER_SCHEDULER_WAIT_H_
+#define SCHEDULER_SCHEDULER_WAIT_H_
+
+#include "scheduler_local.h"
+
+/*! \details Wait queues hold the tasks that are blocked on an object
+ * (mutex, semaphore or condition).
+ *
+ * Each object with waiters has a queue ordered by priority (highest
+ * first) then by the order the tasks started waiting. The first task
+ * in the queue is found by hashing the object's address. The links are
+ * kept per task (a task waits on one object at a time) so no memory
+ * is needed in the object itself.
+ *
+ * Task 0 never waits so 0 marks the end of a queue.
+ *
+ */
+
+// adds the task to the end of its priority in the queue for object
+void scheduler_wait_root_enqueue(int id, volatile void *object) MCU_ROOT_EXEC_CODE;
+
+// removes the task from whatever queue it is in (if any)
+void scheduler_wait_root_remove(int id) MCU_ROOT_EXEC_CODE;
+
+// these only read the queues: the first task waiting on object or 0
+int scheduler_wait_get_first(volatile void *object);
+int scheduler_wait_get_next(int id);
+
+#endif /* SCHEDULER_SCHEDULER_WAIT_H_ */
@@ -18,6 +18,7 @@
 
 #include "../scheduler/scheduler_root.h"
 #include "../scheduler/scheduler_timing.h"
+#include "../scheduler/scheduler_wait.h"
 #include "semaphore.h"
 
 #include "sos/debug.h"
@@ -480,6 +481,7 @@ void svcall_sem_wait(void *args) {
 
   if (p->sem->value <= 0) {
     // task must be blocked until the semaphore is available
+    scheduler_wait_root_enqueue(task_get_current(), p->sem);
     scheduler_root_update_on_sleep();
     p->result = -1; // didn't get the semaphore
   } else {
@@ -2,7 +2,9 @@
 
 #include <sdk/api.h>
 
+#include "config.h"
 #include "cortexm/cortexm.h"
+#include "sos/probe.h"
 
 #include "check_config.h"
 
@@ -24,16 +26,6 @@ int sos_main() {
 
     sos_debug_log_directive(
       SOS_DEBUG_MALLOC | SOS_DEBUG_TASK | SOS_DEBUG_SCHEDULER, "reset");
-    sos_debug_log_directive(
-      SOS_DEBUG_MALLOC, "hist:Malloc Perf:_malloc_r_us:malloc() execution time in us");
-    sos_debug_log_directive(
-      SOS_DEBUG_MALLOC, "hist:Free Perf:_free_r_us:free() execution time in us");
-    sos_debug_log_directive(
-      SOS_DEBUG_PTHREAD,
-      "hist:Mutex Lock Perf:pthread_mutex_lock_us:pthread_mutex_lock() execution time in us");
-    sos_debug_log_directive(
-      SOS_DEBUG_PTHREAD,
-      "hist:Mutex Unlock Perf:pthread_mutex_unlock_us:pthread_mutex_unlock() execution time in us");
     sos_debug_log_directive(
       SOS_DEBUG_PTHREAD,
       "hist:Condition Perf:pthread_cond_timedwait_us:pthread_cond_timedwait() execution time in us");
@@ -41,21 +33,16 @@ int sos_main() {
       SOS_DEBUG_UNISTD, "hist:usleep Oversleep:usleep_us:usleep() oversleep time in us");
     sos_debug_log_directive(
       SOS_DEBUG_UNISTD, "hist:sleep Oversleep:sleep_us:sleep() oversleep time in us");
-    sos_debug_log_directive(
-      SOS_DEBUG_TASK,
-      "hist:Context Switch Cycles:switch_contexts:Average number of cycles for context switching");
-    sos_debug_log_directive(
-      SOS_DEBUG_TASK,
-      "hist:PendSV Critical Cycles:pend_critical:Average number of cycles interrupts are off on PendSV");
-    sos_debug_log_directive(
-      SOS_DEBUG_SCHEDULER,
-      "hist:Scheduler Critical Cycles:scheduler_critical:Average number of cycles interrupts are off when stopping a task");
     sos_debug_log_directive(
       SOS_DEBUG_MALLOC, "heap:OS Heap:heap0:OS Heap Utilization over time");
   }
 
   check_config();
 
+#if CONFIG_SYS_IS_PROBE
+  sos_probe_initialize();
+#endif
+
   scheduler_init();
   scheduler_start(sos_config.task.start);
 
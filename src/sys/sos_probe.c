@@ -0,0 +1,94 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <string.h>
+
+#include "config.h"
+#include "cortexm/cortexm.h"
+#include "sos/fs/sysfs.h"
+#include "sos/probe.h"
+#include "sos/sos.h"
+
+#if CONFIG_SYS_IS_PROBE
+
+// the linker script collects the probe descriptors between these symbols
+extern const sos_probe_t _sos_probe;
+extern const sos_probe_t _esos_probe;
+
+static const sos_probe_t *get_first() { return &_sos_probe; }
+static const sos_probe_t *get_end() { return &_esos_probe; }
+
+static void clear_stats(sos_probe_stats_t *stats) {
+  memset(stats, 0, sizeof(sos_probe_stats_t));
+}
+
+void sos_probe_initialize() {
+  // probes read the free running cycle counter (sys mem is not zeroed at reset)
+  cortexm_initialize_dwt();
+  for (const sos_probe_t *probe = get_first(); probe < get_end(); probe++) {
+    clear_stats(probe->stats);
+  }
+}
+
+SOS_PROBE_DEFINE(sos_probe_check);
+
+void sos_probe_check() {
+  // the caller runs privileged in thread mode on the process stack
+  SOS_PROBE_ENTER(sos_probe_check);
+  SOS_PROBE_EXIT(sos_probe_check);
+  if (sos_probe_stats_sos_probe_check.count == 0) {
+    sos_handle_event(SOS_EVENT_ROOT_FATAL, "probe check");
+  }
+}
+
+void sos_probe_root_record(const sos_probe_t *probe, u32 cycles) {
+  sos_probe_stats_t *stats = probe->stats;
+  const int bucket = 31 - __CLZ(cycles | 1);
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  if ((stats->count == 0) || (cycles < stats->min)) {
+    stats->min = cycles;
+  }
+  if (cycles > stats->max) {
+    stats->max = cycles;
+  }
+  stats->count++;
+  stats->total += cycles;
+  stats->bucket[bucket]++;
+  __set_PRIMASK(primask);
+}
+
+int sos_probe_root_read(sys_probe_t *probe) {
+  const u32 index = probe->index;
+  if (index >= (u32)(get_end() - get_first())) {
+    return SYSFS_SET_RETURN(ENOENT);
+  }
+
+  const sos_probe_t *source = get_first() + index;
+  memset(probe, 0, sizeof(sys_probe_t));
+  probe->index = index;
+  strncpy(probe->name, source->name, SYS_PROBE_NAME_MAX - 1);
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const sos_probe_stats_t *stats = source->stats;
+  probe->count = stats->count;
+  probe->min = stats->min;
+  probe->max = stats->max;
+  probe->total = stats->total;
+  memcpy(probe->bucket, stats->bucket, sizeof(probe->bucket));
+  __set_PRIMASK(primask);
+  return 0;
+}
+
+void sos_probe_root_reset() {
+  for (const sos_probe_t *probe = get_first(); probe < get_end(); probe++) {
+    const u32 primask = __get_PRIMASK();
+    cortexm_disable_interrupts();
+    clear_stats(probe->stats);
+    __set_PRIMASK(primask);
+  }
+}
+
+#endif
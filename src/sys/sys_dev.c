@@ -8,6 +8,7 @@
 #include "sos/debug.h"
 #include "sos/dev/bootloader.h"
 #include "sos/dev/sys.h"
+#include "sos/probe.h"
 
 #include "device/sys.h"
 #include "signal/sig_local.h"
@@ -15,8 +16,12 @@
 
 #include "cortexm/task_local.h"
 #include "scheduler/scheduler_root.h"
+#include "scheduler/scheduler_timing.h"
+#include "scheduler/scheduler_trace.h"
+#include "sys/malloc/malloc_local.h"
 
 static int read_task(sys_taskattr_t *task);
+static int read_heap_profile(sys_heap_profile_t *profile);
 static int sys_setattr(const devfs_handle_t *handle, void *ctl);
 
 int sys_open(const devfs_handle_t *handle) {
@@ -125,6 +130,42 @@ int sys_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
     }
     return SYSFS_SET_RETURN(EPERM);
 
+  case I_SYS_GETIDLESTATS:
+    scheduler_timing_root_get_idle_stats(ctl);
+    return 0;
+
+  case I_SYS_GETHEAPPROFILE:
+    return read_heap_profile(ctl);
+
+  case I_SYS_GETSCHEDTRACE:
+#if CONFIG_SCHED_IS_TRACE
+    return scheduler_trace_root_read(ctl);
+#else
+    return SYSFS_SET_RETURN(ENOTSUP);
+#endif
+
+  case I_SYS_GETSCHEDSTATS:
+#if CONFIG_SCHED_IS_TRACE
+    return scheduler_trace_root_get_stats(ctl);
+#else
+    return SYSFS_SET_RETURN(ENOTSUP);
+#endif
+
+  case I_SYS_GETPROBE:
+#if CONFIG_SYS_IS_PROBE
+    return sos_probe_root_read(ctl);
+#else
+    return SYSFS_SET_RETURN(ENOTSUP);
+#endif
+
+  case I_SYS_RESETPROBES:
+#if CONFIG_SYS_IS_PROBE
+    sos_probe_root_reset();
+    return 0;
+#else
+    return SYSFS_SET_RETURN(ENOTSUP);
+#endif
+
   default:
     break;
   }
@@ -198,6 +239,26 @@ int read_task(sys_taskattr_t *task) {
   return ret;
 }
 
+int read_heap_profile(sys_heap_profile_t *profile) {
+#if CONFIG_MALLOC_IS_PROFILE
+  // the process heap belongs to the first thread of the process
+  for (int i = 0; i < task_get_total(); i++) {
+    if (
+      task_enabled(i) && !task_thread_asserted(i)
+      && (task_get_pid(i) == (int)profile->pid)) {
+      if (malloc_get_profile(sos_task_table[i].global_reent, profile) < 0) {
+        return SYSFS_SET_RETURN(ENOENT);
+      }
+      return 0;
+    }
+  }
+  return SYSFS_SET_RETURN(ESRCH);
+#else
+  MCU_UNUSED_ARGUMENT(profile);
+  return SYSFS_SET_RETURN(ENOTSUP);
+#endif
+}
+
 int sys_setattr(const devfs_handle_t *handle, void *ctl) {
   MCU_UNUSED_ARGUMENT(handle);
   const sys_attr_t *attr = ctl;
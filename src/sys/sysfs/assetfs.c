@@ -9,9 +9,11 @@
 
 #include "sos/debug.h"
 #include "sos/fs/assetfs.h"
+#include "config.h"
 #include "cortexm/cortexm.h"
 #include "dirent.h"
 #include "sos/fs/sysfs.h"
+#include "sos/pool.h"
 #include "sos/sos.h"
 
 
@@ -25,6 +27,16 @@ typedef struct {
   u32 checksum;
 } assetfs_handle_t;
 
+// handles come from a static pool while it lasts to keep them off the process heap
+static SOS_POOL_DECLARE_STORAGE(
+  m_handle_storage,
+  sizeof(assetfs_handle_t),
+  CONFIG_SYSFS_HANDLE_POOL_COUNT);
+static sos_pool_t m_handle_pool = SOS_POOL_INITIALIZER(
+  m_handle_storage,
+  sizeof(assetfs_handle_t),
+  CONFIG_SYSFS_HANDLE_POOL_COUNT);
+
 int assetfs_init(const void *config) {
   MCU_UNUSED_ARGUMENT(config);
   // nothing to initialize
@@ -54,7 +66,10 @@ int assetfs_open(const void *cfg, void **handle, const char *path, int flags, in
     return SYSFS_SET_RETURN(EPERM);
   }
 
-  assetfs_handle_t *h = malloc(sizeof(assetfs_handle_t));
+  assetfs_handle_t *h = sos_pool_alloc(&m_handle_pool);
+  if (h == NULL) {
+    h = malloc(sizeof(assetfs_handle_t));
+  }
   if (h == 0) {
     return -1;
   }
@@ -114,7 +129,11 @@ int assetfs_close(const void *cfg, void **handle) {
     if (cortexm_verify_zero_sum32(*handle, sizeof(assetfs_handle_t) / sizeof(u32)) == 0) {
       return SYSFS_SET_RETURN(EINVAL);
     }
-    free(*handle);
+    if (sos_pool_is_member(&m_handle_pool, *handle)) {
+      sos_pool_free(&m_handle_pool, *handle);
+    } else {
+      free(*handle);
+    }
     *handle = 0;
   }
   return 0;
@@ -6,11 +6,13 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include "config.h"
 #include "cortexm/cortexm.h"
 #include "dirent.h"
 #include "sos/debug.h"
 #include "sos/fs/drive_assetfs.h"
 #include "sos/fs/sysfs.h"
+#include "sos/pool.h"
 #include "sos/sos.h"
 
 #define INVALID_DIR_HANDLE ((void *)0)
@@ -23,6 +25,15 @@ typedef struct {
   u32 checksum;
 } drive_assetfs_handle_t;
 
+static SOS_POOL_DECLARE_STORAGE(
+  m_handle_storage,
+  sizeof(drive_assetfs_handle_t),
+  CONFIG_SYSFS_HANDLE_POOL_COUNT);
+static sos_pool_t m_handle_pool = SOS_POOL_INITIALIZER(
+  m_handle_storage,
+  sizeof(drive_assetfs_handle_t),
+  CONFIG_SYSFS_HANDLE_POOL_COUNT);
+
 #define ASSETFS_CONFIG(cfg) ((drive_assetfs_config_t *)cfg)
 #define ASSETFS_STATE(cfg)                                                               \
   ((drive_assetfs_state_t *)(((drive_assetfs_config_t *)cfg)->drive.state))
@@ -97,7 +108,10 @@ int drive_assetfs_open(
     return SYSFS_SET_RETURN(EPERM);
   }
 
-  drive_assetfs_handle_t *h = malloc(sizeof(drive_assetfs_handle_t));
+  drive_assetfs_handle_t *h = sos_pool_alloc(&m_handle_pool);
+  if (h == NULL) {
+    h = malloc(sizeof(drive_assetfs_handle_t));
+  }
   if (h == 0) {
     return SYSFS_SET_RETURN(ENOMEM);
   }
@@ -157,7 +171,11 @@ int drive_assetfs_close(const void *cfg, void **handle) {
       == 0) {
       return SYSFS_SET_RETURN(EINVAL);
     }
-    free(*handle);
+    if (sos_pool_is_member(&m_handle_pool, *handle)) {
+      sos_pool_free(&m_handle_pool, *handle);
+    } else {
+      free(*handle);
+    }
     *handle = 0;
   }
   return 0;
@@ -1,18 +1,25 @@
 // Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
 #include <errno.h>
-#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../scheduler/scheduler_root.h"
+#include "../scheduler/scheduler_timing.h"
 #include "cortexm/mpu.h"
 #include "cortexm/task.h"
 #include "sos/symbols.h"
 #include "trace.h"
+#include "trace_ring.h"
+
+// how often a blocking read checks the rings for new events
+#define TRACE_POLL_INTERVAL_USECONDS 1000
 
 typedef struct {
-  trace_id_handle_t trace;
+  trace_id_handle_t trace; // must be first: trace_id_t points here
   void *next;
+  trace_ring_t *ring; // one ring for each traced thread followed by the records
+  int ring_count;
 } trace_list_t;
 
 static trace_list_t *trace_first = 0;
@@ -94,11 +101,24 @@ static int is_invalid(trace_id_t id) {
 
 static void update_checksum(trace_id_t id) { id->checksum = calc_checksum(id); }
 
-static int exec_trace_event(
-  mqd_t mqdes,
-  struct posix_trace_event_info *info,
-  const void *data_ptr,
-  size_t data_len);
+static trace_list_t *trace_get_entry(trace_id_t id) { return (trace_list_t *)id; }
+
+static trace_ring_t *trace_get_ring(trace_id_t id, int tid) {
+  trace_list_t *entry = trace_get_entry(id);
+  for (int i = 0; i < entry->ring_count; i++) {
+    if (entry->ring[i].tid == tid) {
+      return entry->ring + i;
+    }
+  }
+  return 0;
+}
+
+static int trace_read_event(
+  trace_list_t *entry,
+  struct posix_trace_event_info *event,
+  void *data,
+  size_t num_bytes,
+  size_t *data_len);
 
 typedef struct {
   trace_id_t id;
@@ -117,10 +137,17 @@ static int trace_timedgetnext_event(
   const struct timespec *abs_timeout);
 
 int posix_trace_clear(trace_id_t id) {
-  MCU_UNUSED_ARGUMENT(id);
   // clear all events in the trace stream
-  errno = ENOTSUP;
-  return -1;
+  id = trace_get_ptr(id);
+  if (is_invalid(id)) {
+    return -1;
+  }
+
+  trace_list_t *entry = trace_get_entry(id);
+  for (int i = 0; i < entry->ring_count; i++) {
+    trace_ring_clear(entry->ring + i);
+  }
+  return 0;
 }
 
 int posix_trace_close(trace_id_t id) {
@@ -148,11 +175,14 @@ void svcall_count_trace_id(void *args) {
 void svcall_set_trace_id(void *args) {
   CORTEXM_SVCALL_ENTER();
   root_trace_id_t *p = args;
+  trace_list_t *entry = trace_get_entry(p->id);
   int i;
   p->result = 0;
   for (i = 0; i < task_get_total(); i++) {
     if (task_enabled(i)) {
-      if (task_get_pid(i) == p->id->pid) {
+      // threads created after the rings were allocated are not traced
+      if ((task_get_pid(i) == p->id->pid) && (p->result < entry->ring_count)) {
+        entry->ring[p->result].tid = i;
         scheduler_root_set_trace_id(i, p->id);
         p->result++; // found the pid -- otherwise return ESRCH
       }
@@ -163,12 +193,10 @@ void svcall_set_trace_id(void *args) {
 // This is setup by the system or another process that wants to trace the target pid
 int posix_trace_create(pid_t pid, const trace_attr_t *attr, trace_id_t *id) {
   trace_id_handle_t trace_handle;
-  struct mq_attr mattr;
-  size_t msg_size;
   root_trace_id_t args;
   trace_attr_t tmp_attr;
-  // create a new trace stream for pid -- create a new message queue and tell the target
-  // pid it is being traced
+  // create a new trace stream for pid -- allocate a ring for each thread and tell the
+  // target pid it is being traced
 
   // check for any existing traces on processes that no longer exist
   trace_cleanup();
@@ -189,20 +217,28 @@ int posix_trace_create(pid_t pid, const trace_attr_t *attr, trace_id_t *id) {
     return -1;
   }
 
-  mattr.mq_maxmsg = tmp_attr.stream_size;
-  posix_trace_attr_getmaxsystemeventsize(&tmp_attr, &msg_size);
-  mattr.mq_msgsize = msg_size;
-
-  int oflag = O_CREAT | O_EXCL | O_RDWR | O_NONBLOCK;
-  if (tmp_attr.stream_policy == POSIX_TRACE_LOOP) {
-    oflag |= MQ_FLAGS_LOOP;
+  const int ring_count = tmp_pid;
+  const u32 storage_size =
+    trace_ring_get_storage_size(tmp_attr.stream_size, tmp_attr.data_size);
+  if (storage_size == 0) {
+    errno = EINVAL;
+    return -1;
   }
 
-  trace_handle.mq = mq_open(tmp_attr.name, oflag, 0666, &mattr);
-  if (trace_handle.mq < 0) {
+  trace_ring_t *ring = _malloc_r(
+    sos_task_table[0].global_reent, ring_count * (sizeof(trace_ring_t) + storage_size));
+  if (ring == 0) {
     return -1;
   }
 
+  u8 *storage = (u8 *)(ring + ring_count);
+  for (int i = 0; i < ring_count; i++) {
+    trace_ring_initialize(
+      ring + i, storage + i * storage_size, tmp_attr.stream_size, tmp_attr.data_size,
+      tmp_attr.stream_policy == POSIX_TRACE_LOOP);
+  }
+
+  trace_handle.mq = 0;
   trace_handle.filter = POSIX_TRACE_ALL_EVENTS_MASK;
   trace_handle.pid = pid;
   trace_handle.status = 0; // trace is suspended on start
@@ -218,13 +254,14 @@ int posix_trace_create(pid_t pid, const trace_attr_t *attr, trace_id_t *id) {
 
   *id = trace_find_free();
   if (*id == 0) {
-    // discard the message queue if creation of the id memory fails
-    mq_discard(trace_handle.mq);
+    _free_r(sos_task_table[0].global_reent, ring);
     return -1;
   }
 
   // copy the data over to the id area
   memcpy(*id, &trace_handle, sizeof(trace_id_handle_t));
+  trace_get_entry(*id)->ring = ring;
+  trace_get_entry(*id)->ring_count = ring_count;
 
   args.id = *id;
   args.result = 0;
@@ -254,66 +291,45 @@ void posix_trace_event_addr_tid(
   uint32_t addr,
   int tid) {
   // record event id and in-calling processes trace stream
-  trace_id_handle_t trace_handle;
-  int ret;
-  struct posix_trace_event_info event_info;
-  // check for an active trace stream
+  struct mcu_timeval timestamp;
 
+  // each ring has only one writer (thread tid) -- an interrupt or
+  // another thread would race it, so the event is not recorded
+  if (__get_IPSR() || (tid != task_get_current())) {
+    return;
+  }
+
+  // check for an active trace stream
   trace_id_t trace_id = scheduler_trace_id(tid);
 
   if (trace_id == 0) {
     return;
   }
 
-  memcpy(&trace_handle, trace_id, sizeof(trace_id_handle_t));
-
   // check to see if trace is running
-  if ((trace_handle.status & POSIX_STREAM_STATUS_MASK) == 0) {
+  if ((trace_id->status & POSIX_STREAM_STATUS_MASK) == 0) {
     return;
   }
 
   // check to see if event is filtered out
-  if ((trace_handle.filter & (1 << event_id)) == 0) {
+  if ((trace_id->filter & (1 << event_id)) == 0) {
     return;
   }
 
-  // convert the address using the task memory location
-  // check if addr is part of kernel or app
-  if (
-    ((addr > (uint32_t)&_text) && (addr < (uint32_t)&_etext))
-    || ((addr > (uint32_t)&_tcim) && (addr < (uint32_t)&_etcim))) {
-    // kernel
-    addr = addr - 1;
-  } else {
-    // app
-    addr = addr - (u32)sos_task_table[tid].mem.code.address - 1 + 0xDE000000;
+  trace_ring_t *ring = trace_get_ring(trace_id, tid);
+  if (ring == 0) {
+    return;
   }
 
-  event_info.posix_event_id = event_id;
-  event_info.posix_pid = task_get_pid(tid);
-  event_info.posix_prog_address = (void *)addr; // grab the value of the caller
-  event_info.posix_thread_id = tid;
-  clock_gettime(CLOCK_REALTIME, &event_info.posix_timestamp);
-
-  // if data_len is too big for the data in the trace - set the trunc status to true
-  if (trace_handle.attr.data_size < data_len) {
-    event_info.posix_truncation_status = 1;
-    data_len = trace_handle.attr.data_size;
+  if (cortexm_is_root_mode()) {
+    scheduler_timing_root_get_timestamp(&timestamp);
   } else {
-    event_info.posix_truncation_status = 0;
+    cortexm_svcall(scheduler_timing_svcall_get_timestamp, &timestamp);
   }
 
-  // now send a message on the associated message queue
-  if ((ret = exec_trace_event(trace_handle.mq, &event_info, data_ptr, data_len)) != 0) {
-    // trace overrun condition
-    if (ret == EAGAIN) {
-      // overrun
-      trace_handle.status |= POSIX_STREAM_OVERRUN_STATUS_MASK;
-    } else {
-      // some other error writing to the queue
-    }
-  }
-  return;
+  // the address is converted by the reader; a full ring is seen by posix_trace_get_status()
+  trace_ring_write(
+    ring, timestamp.tv_sec, timestamp.tv_usec, addr, event_id, data_ptr, data_len);
 }
 
 void posix_trace_event_addr(
@@ -333,28 +349,6 @@ void posix_trace_event(trace_event_id_t event_id, const void *data_ptr, size_t d
   // posix_trace_event_addr(event_id, data_ptr, data_len, lr);
 }
 
-int exec_trace_event(
-  mqd_t mqdes,
-  struct posix_trace_event_info *info,
-  const void *data_ptr,
-  size_t data_len) {
-  int tmp_errno;
-  int ret;
-  size_t len = sizeof(struct posix_trace_event_info) + data_len;
-  // create a buffer on the stack large enough to hold the data and the header
-  char buffer[len];
-  memcpy(buffer, info, sizeof(struct posix_trace_event_info));
-  memcpy(buffer + sizeof(struct posix_trace_event_info), data_ptr, data_len);
-
-  // send the message on the queue
-  tmp_errno = errno;
-  errno = 0;
-  mq_trysend(mqdes, buffer, len, 0);
-  ret = errno;
-  errno = tmp_errno;
-  return ret;
-}
-
 int posix_trace_eventid_equal(
   trace_id_t id,
   trace_event_id_t event1,
@@ -491,19 +485,27 @@ int posix_trace_get_filter(trace_id_t id, trace_event_set_t *event_set) {
 }
 
 int posix_trace_get_status(trace_id_t id, struct posix_trace_status_info *info) {
-  struct mq_attr attr;
-
-  mq_getattr(id->mq, &attr);
-  if (attr.mq_msgsize == attr.mq_maxmsg) {
-    id->status |= POSIX_STREAM_FULL_STATUS_MASK;
+  trace_list_t *entry = trace_get_entry(id);
+  int is_full = 0;
+  int is_overrun = 0;
+
+  // overrun is reported once for each batch of dropped or overwritten events
+  for (int i = 0; i < entry->ring_count; i++) {
+    trace_ring_t *ring = entry->ring + i;
+    const u32 overrun_count = ring->drop_count + ring->lost_count;
+    if (trace_ring_is_full(ring)) {
+      is_full = 1;
+    }
+    if (overrun_count != ring->reported_count) {
+      ring->reported_count = overrun_count;
+      is_overrun = 1;
+    }
   }
 
   info->posix_stream_status =
     ((id->status & POSIX_STREAM_STATUS_MASK) == POSIX_STREAM_STATUS_MASK);
-  info->posix_stream_full_status =
-    ((id->status & POSIX_STREAM_FULL_STATUS_MASK) == POSIX_STREAM_FULL_STATUS_MASK);
-  info->posix_stream_overrun_status =
-    ((id->status & POSIX_STREAM_OVERRUN_STATUS_MASK) == POSIX_STREAM_OVERRUN_STATUS_MASK);
+  info->posix_stream_full_status = is_full;
+  info->posix_stream_overrun_status = is_overrun;
   info->posix_stream_flush_status =
     ((id->status & POSIX_STREAM_FLUSH_STATUS_MASK) == POSIX_STREAM_FLUSH_STATUS_MASK);
   info->posix_stream_flush_error =
@@ -514,8 +516,6 @@ int posix_trace_get_status(trace_id_t id, struct posix_trace_status_info *info)
   info->posix_log_full_status =
     ((id->status & POSIX_STREAM_LOG_FULL_STATUS_MASK)
      == POSIX_STREAM_LOG_FULL_STATUS_MASK);
-
-  id->status &= ~POSIX_STREAM_OVERRUN_STATUS_MASK; // clear the overrun
   return 0;
 }
 
@@ -580,7 +580,10 @@ int posix_trace_shutdown(trace_id_t id) {
 
   args.id = id;
   cortexm_svcall(svcall_shutdown_trace_id, &args);
-  mq_discard(id->mq);
+  trace_list_t *entry = trace_get_entry(id);
+  _free_r(sos_task_table[0].global_reent, entry->ring);
+  entry->ring = 0;
+  entry->ring_count = 0;
   memset(id, 0, sizeof(trace_id_handle_t));
   return 0;
 }
@@ -660,16 +663,105 @@ int posix_trace_trygetnext_event(
   size_t num_bytes,
   size_t *data_len,
   int *unavailable) {
-  struct timespec abs_timeout;
-  abs_timeout.tv_sec = 0;
-  abs_timeout.tv_nsec = 0;
-  return trace_timedgetnext_event(
-    id, event, data, num_bytes, data_len, unavailable, &abs_timeout);
+  id = trace_get_ptr(id);
+  if (is_invalid(id)) {
+    return -1;
+  }
+
+  *unavailable =
+    trace_read_event(trace_get_entry(id), event, data, num_bytes, data_len) == 0;
+  return 0;
 }
 
 int posix_trace_trygetnext_data(trace_id_t id, void *data, size_t num_bytes) {
-  unsigned msg_prio = 0;
-  return mq_receive(id->mq, data, num_bytes, &msg_prio);
+  // data gets the event info followed by the event data
+  struct posix_trace_event_info event;
+  size_t data_len;
+
+  id = trace_get_ptr(id);
+  if (is_invalid(id)) {
+    return -1;
+  }
+
+  if (num_bytes < sizeof(event)) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  if (
+    trace_read_event(
+      trace_get_entry(id), &event, (u8 *)data + sizeof(event), num_bytes - sizeof(event),
+      &data_len)
+    == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  memcpy(data, &event, sizeof(event));
+  return sizeof(event) + data_len;
+}
+
+static int is_earlier(const trace_ring_record_t *a, const trace_ring_record_t *b) {
+  if (a->seconds == b->seconds) {
+    return a->microseconds < b->microseconds;
+  }
+  return a->seconds < b->seconds;
+}
+
+static u32 trace_convert_address(u32 addr, int tid) {
+  // check if addr is part of kernel or app
+  if (
+    ((addr > (uint32_t)&_text) && (addr < (uint32_t)&_etext))
+    || ((addr > (uint32_t)&_tcim) && (addr < (uint32_t)&_etcim))) {
+    // kernel
+    return addr - 1;
+  }
+  // app
+  return addr - (u32)sos_task_table[tid].mem.code.address - 1 + 0xDE000000;
+}
+
+int trace_read_event(
+  trace_list_t *entry,
+  struct posix_trace_event_info *event,
+  void *data,
+  size_t num_bytes,
+  size_t *data_len) {
+  trace_ring_record_t record;
+  trace_ring_t *ring;
+  int len;
+
+  do {
+    // merge the per-thread rings oldest first
+    trace_ring_record_t oldest;
+    ring = 0;
+    for (int i = 0; i < entry->ring_count; i++) {
+      if (
+        trace_ring_peek(entry->ring + i, &record)
+        && ((ring == 0) || is_earlier(&record, &oldest))) {
+        ring = entry->ring + i;
+        oldest = record;
+      }
+    }
+
+    if (ring == 0) {
+      return 0;
+    }
+
+    // the read only fails if the producer overwrote everything since the peek
+  } while ((len = trace_ring_read(ring, &record, data, num_bytes)) < 0);
+
+  const struct mcu_timeval timestamp = {
+    .tv_sec = record.seconds, .tv_usec = record.microseconds};
+  event->posix_event_id = record.event_id;
+  event->posix_pid = entry->trace.pid;
+  event->posix_thread_id = ring->tid;
+  event->posix_prog_address = (void *)trace_convert_address(record.address, ring->tid);
+  event->posix_truncation_status =
+    (record.data_size & TRACE_RING_RECORD_TRUNCATED)
+    || (len < (record.data_size & ~TRACE_RING_RECORD_TRUNCATED));
+  *data_len = len;
+  scheduler_timing_convert_mcu_timeval(&event->posix_timestamp, &timestamp);
+  return 1;
 }
 
 int trace_timedgetnext_event(
@@ -680,38 +772,26 @@ int trace_timedgetnext_event(
   size_t *data_len,
   int *unavailable,
   const struct timespec *abs_timeout) {
-  size_t len = sizeof(struct posix_trace_event_info) + id->attr.data_size;
-  size_t received_data_size;
-
   id = trace_get_ptr(id);
   if (is_invalid(id)) {
     return -1;
   }
 
-  // create a buffer on the stack large enough to hold the data and the header
-  char buffer[len];
-  int ret;
-  unsigned msg_prio = 0;
-
-  ret = mq_timedreceive(id->mq, buffer, len, &msg_prio, abs_timeout);
-  if (ret < 0) {
-    return ret;
-  }
-
-  if (ret < (int)sizeof(struct posix_trace_event_info)) {
-    return -1;
-  }
-
-  received_data_size = ret - sizeof(struct posix_trace_event_info);
-  if (received_data_size > num_bytes) {
-    received_data_size = num_bytes;
+  // the rings can't wake the reader so poll until an event arrives or the time is up
+  while (trace_read_event(trace_get_entry(id), event, data, num_bytes, data_len) == 0) {
+    if (abs_timeout != 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      if (
+        (now.tv_sec > abs_timeout->tv_sec)
+        || ((now.tv_sec == abs_timeout->tv_sec) && (now.tv_nsec >= abs_timeout->tv_nsec))) {
+        errno = ETIMEDOUT;
+        return -1;
+      }
+    }
+    usleep(TRACE_POLL_INTERVAL_USECONDS);
   }
 
-  *data_len = received_data_size;
   *unavailable = 0;
-
-  // copy the message to the event/trace locations
-  memcpy(event, buffer, sizeof(struct posix_trace_event_info));
-  memcpy(data, buffer + sizeof(struct posix_trace_event_info), received_data_size);
   return 0;
 }
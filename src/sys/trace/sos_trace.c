@@ -47,6 +47,10 @@ void sos_trace_root_trace_event(
   size_t data_len) {
   register u32 lr asm("lr");
   link_trace_event_t event;
+#if CONFIG_TRACE_STREAM_SIZE > 0
+  sos_trace_stream_root_event(event_id, data_ptr, data_len, lr, task_get_current());
+  return;
+#endif
   if (sos_config.debug.trace_event) {
     sos_trace_build_event(
       &event, event_id, data_ptr, data_len, lr, task_get_current(), 0);
@@ -117,7 +121,7 @@ void sos_trace_event_addr_tid(
   int tid) {
   // record event id and in-calling processes trace stream
 
-  if (sos_config.debug.trace_event) {
+  if (sos_config.debug.trace_event || (CONFIG_TRACE_STREAM_SIZE > 0)) {
     // convert the address using the task memory location
     // check if addr is part of kernel or app
     if (
@@ -130,6 +134,11 @@ void sos_trace_event_addr_tid(
       addr = addr - (u32)sos_task_table[tid].mem.code.address - 1 + 0xDE000000;
     }
 
+#if CONFIG_TRACE_STREAM_SIZE > 0
+    sos_trace_stream_event(event_id, data_ptr, data_len, addr, tid);
+    return;
+#endif
+
     link_trace_event_t event;
     struct timespec spec;
 
@@ -0,0 +1,348 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*
+ * Batched trace stream (CONFIG_TRACE_STREAM_SIZE).
+ *
+ * sos_trace events are packed as variable-length records (see
+ * link_trace_stream_header_t) into one of two blocks. A full block is
+ * closed and the other block takes new events; when both are waiting to
+ * be sent, events are dropped and counted in the next block header.
+ *
+ * Blocks are only sent by the scheduler (task 0) from its idle loop with
+ * one write() to the trace device, which sos_trace_stream_initialize()
+ * opens in the kernel process. Without a trace device the block goes to
+ * the debug UART a few bytes per SVCall so no single SVCall holds off
+ * the scheduler for a whole block. sos_trace_stream_flush() from any
+ * other thread asks the scheduler to send the active block as well.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../scheduler/scheduler_timing.h"
+#include "config.h"
+#include "cortexm/cortexm.h"
+#include "cortexm/task.h"
+#include "sos/sos.h"
+#include "sos/trace.h"
+
+#if CONFIG_TRACE_STREAM_SIZE > 0
+
+#define BLOCK_SIZE ((CONFIG_TRACE_STREAM_SIZE / 2) & ~0x03)
+#define BLOCK_RECORDS_SIZE (BLOCK_SIZE - sizeof(link_trace_stream_header_t))
+
+#if BLOCK_SIZE > 0xffff
+#error "CONFIG_TRACE_STREAM_SIZE must be less than 128KB"
+#endif
+
+// 28 is sizeof(link_trace_stream_header_t)
+#if BLOCK_SIZE - 28 < LINK_TRACE_STREAM_RECORD_MAX
+#error "CONFIG_TRACE_STREAM_SIZE is too small for a full trace record"
+#endif
+
+// a block that is not full is sent once it is this old (or half full)
+#define TRACE_STREAM_FLUSH_AGE_USECONDS 100000
+
+// bytes written to the debug UART per SVCall
+#define TRACE_STREAM_DEBUG_WRITE_SIZE 64
+
+typedef struct {
+  link_trace_stream_header_t header;
+  u8 records[BLOCK_RECORDS_SIZE];
+} trace_stream_block_t;
+
+typedef struct {
+  trace_stream_block_t block[2];
+  u64 last_timestamp; // time of the last record in the active block
+  u32 sequence;
+  u32 drop_count;
+  u8 active;
+  u8 is_closed[2]; // the block is waiting to be (or being) sent
+  u8 is_flush_pending; // the scheduler should also send the active block
+} trace_stream_t;
+
+typedef struct {
+  int is_all;
+  int is_dropped;
+  int index;
+} trace_stream_take_t;
+
+typedef struct {
+  const u8 *buffer;
+  int nbyte;
+} trace_stream_write_t;
+
+typedef struct {
+  link_trace_event_id_t event_id;
+  const void *data_ptr;
+  size_t data_len;
+  u32 addr;
+  int tid;
+} trace_stream_event_t;
+
+static trace_stream_t m_trace_stream MCU_SYS_MEM;
+static int m_trace_stream_fd = -1;
+
+static void svcall_take_block(void *args);
+static void svcall_release_block(void *args);
+static void svcall_request_flush(void *args);
+static void svcall_write_debug(void *args);
+static void svcall_stream_event(void *args);
+
+static u8 *encode_varint(u8 *dest, u32 value) {
+  while (value > 0x7f) {
+    *dest++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  *dest++ = value;
+  return dest;
+}
+
+// zero if the clock went backwards
+static u32 get_elapsed(u64 now, u64 mark) { return now > mark ? now - mark : 0; }
+
+static void close_block(int index) {
+  trace_stream_block_t *block = m_trace_stream.block + index;
+  block->header.magic = LINK_TRACE_STREAM_MAGIC;
+  block->header.id = LINK_NOTIFY_ID_POSIX_TRACE_STREAM;
+  block->header.sequence = m_trace_stream.sequence++;
+  block->header.drop_count = m_trace_stream.drop_count;
+  m_trace_stream.drop_count = 0;
+  m_trace_stream.is_closed[index] = 1;
+}
+
+static void reset_block(int index) {
+  trace_stream_block_t *block = m_trace_stream.block + index;
+  block->header.size = sizeof(link_trace_stream_header_t);
+  block->header.count = 0;
+  block->header.checksum = 0;
+}
+
+void sos_trace_stream_root_event(
+  link_trace_event_id_t event_id,
+  const void *data_ptr,
+  size_t data_len,
+  u32 addr,
+  int tid) {
+  u8 record[LINK_TRACE_STREAM_RECORD_MAX];
+  u8 size_flags = data_len;
+  if (data_len > LINK_TRACE_STREAM_DATA_SIZE) {
+    data_len = LINK_TRACE_STREAM_DATA_SIZE;
+    size_flags = data_len | LINK_TRACE_STREAM_TRUNCATED;
+  }
+
+  // events can come from interrupts as well as SVCalls
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+
+  struct mcu_timeval now;
+  scheduler_timing_root_get_timestamp(&now);
+  u64 timestamp = scheduler_timing_real64usec(&now);
+  if (timestamp < m_trace_stream.last_timestamp) {
+    // the timer wrapped but the overflow interrupt can't run until PRIMASK is restored
+    timestamp += SOS_USECOND_PERIOD;
+  }
+
+  trace_stream_block_t *block = m_trace_stream.block + m_trace_stream.active;
+  if (block->header.size == 0) {
+    // first use
+    reset_block(0);
+    reset_block(1);
+  }
+
+  u8 *end = record + 3;
+  end = encode_varint(
+    end, block->header.count ? get_elapsed(timestamp, m_trace_stream.last_timestamp) : 0);
+  end = encode_varint(end, task_get_pid(tid));
+  const u32 header_size = end - record + sizeof(u32);
+
+  if (block->header.size + header_size + data_len > BLOCK_SIZE) {
+    const int next = m_trace_stream.active ^ 1;
+    if (m_trace_stream.is_closed[next]) {
+      m_trace_stream.drop_count++;
+      __set_PRIMASK(primask);
+      return;
+    }
+    close_block(m_trace_stream.active);
+    m_trace_stream.active = next;
+    block = m_trace_stream.block + next;
+    // the first record of a block has no delta
+    end = encode_varint(record + 3, 0);
+    end = encode_varint(end, task_get_pid(tid));
+  }
+
+  record[0] = event_id;
+  record[1] = tid;
+  record[2] = size_flags;
+  for (int i = 0; i < 4; i++) {
+    *end++ = addr >> (i * 8);
+  }
+
+  if (block->header.count == 0) {
+    block->header.timestamp = timestamp;
+  }
+
+  u8 *dest = (u8 *)block + block->header.size;
+  const u32 record_size = end - record;
+  memcpy(dest, record, record_size);
+  memcpy(dest + record_size, data_ptr, data_len);
+  u16 checksum = block->header.checksum;
+  for (u32 i = 0; i < record_size + data_len; i++) {
+    checksum += dest[i];
+  }
+  block->header.checksum = checksum;
+  block->header.size += record_size + data_len;
+  block->header.count++;
+  m_trace_stream.last_timestamp = timestamp;
+  __set_PRIMASK(primask);
+}
+
+void svcall_stream_event(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  const trace_stream_event_t *p = args;
+  sos_trace_stream_root_event(p->event_id, p->data_ptr, p->data_len, p->addr, p->tid);
+}
+
+void sos_trace_stream_event(
+  link_trace_event_id_t event_id,
+  const void *data_ptr,
+  size_t data_len,
+  u32 addr,
+  int tid) {
+  trace_stream_event_t args = {
+    .event_id = event_id,
+    .data_ptr = data_ptr,
+    .data_len = data_len,
+    .addr = addr,
+    .tid = tid};
+  if (cortexm_is_root_mode()) {
+    svcall_stream_event(&args);
+  } else {
+    cortexm_svcall(svcall_stream_event, &args);
+  }
+}
+
+void svcall_take_block(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  trace_stream_take_t *p = args;
+  struct mcu_timeval now;
+  scheduler_timing_root_get_timestamp(&now);
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const int active = m_trace_stream.active;
+  const int other = active ^ 1;
+  const trace_stream_block_t *block = m_trace_stream.block + active;
+  const u64 now_usec = scheduler_timing_real64usec(&now);
+  const u64 age =
+    now_usec > block->header.timestamp ? now_usec - block->header.timestamp : 0;
+
+  p->index = -1;
+  if (m_trace_stream.is_closed[other]) {
+    // blocks are sent in the order they were closed
+    p->index = other;
+  } else if (
+    (block->header.count > 0)
+    && (p->is_all || m_trace_stream.is_flush_pending
+        || (block->header.size >= BLOCK_SIZE / 2)
+        || (age >= TRACE_STREAM_FLUSH_AGE_USECONDS))) {
+    close_block(active);
+    m_trace_stream.active = other;
+    p->index = active;
+  } else {
+    m_trace_stream.is_flush_pending = 0;
+  }
+  __set_PRIMASK(primask);
+}
+
+void svcall_release_block(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  const trace_stream_take_t *p = args;
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  if (p->is_dropped) {
+    m_trace_stream.drop_count += m_trace_stream.block[p->index].header.count;
+  }
+  reset_block(p->index);
+  m_trace_stream.is_closed[p->index] = 0;
+  __set_PRIMASK(primask);
+}
+
+void svcall_request_flush(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  MCU_UNUSED_ARGUMENT(args);
+  m_trace_stream.is_flush_pending = 1;
+}
+
+void svcall_write_debug(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  const trace_stream_write_t *p = args;
+  sos_config.debug.write(p->buffer, p->nbyte);
+}
+
+static int write_block(const trace_stream_block_t *block) {
+  if (m_trace_stream_fd >= 0) {
+    return write(m_trace_stream_fd, block, block->header.size) == block->header.size
+             ? 0
+             : -1;
+  }
+
+  if (sos_config.debug.write == NULL) {
+    return -1;
+  }
+
+  // the scheduler is unprivileged -- the UART is written in short SVCalls so
+  // other threads and interrupts at the SVCall priority run in between
+  const u8 *buffer = (const u8 *)block;
+  for (int i = 0; i < block->header.size; i += TRACE_STREAM_DEBUG_WRITE_SIZE) {
+    trace_stream_write_t args = {.buffer = buffer + i, .nbyte = block->header.size - i};
+    if (args.nbyte > TRACE_STREAM_DEBUG_WRITE_SIZE) {
+      args.nbyte = TRACE_STREAM_DEBUG_WRITE_SIZE;
+    }
+    cortexm_svcall(svcall_write_debug, &args);
+  }
+  return 0;
+}
+
+static int flush_blocks(int is_all) {
+  trace_stream_take_t args = {.is_all = is_all};
+  int result = 0;
+  cortexm_svcall(svcall_take_block, &args);
+  while (args.index >= 0) {
+    // release counts the records as dropped if the write failed
+    args.is_dropped = write_block(m_trace_stream.block + args.index) < 0;
+    if (args.is_dropped) {
+      result = -1;
+    }
+    cortexm_svcall(svcall_release_block, &args);
+    cortexm_svcall(svcall_take_block, &args);
+  }
+  return result;
+}
+
+void sos_trace_stream_initialize() {
+  // the descriptor belongs to the kernel process (pid 0) like the scheduler that uses it
+  if (sos_config.fs.trace_dev != NULL) {
+    m_trace_stream_fd = open(sos_config.fs.trace_dev, O_WRONLY | O_NONBLOCK);
+  }
+}
+
+int sos_trace_stream_flush() {
+  if (task_get_current() != 0) {
+    // only the scheduler sends blocks
+    cortexm_svcall(svcall_request_flush, NULL);
+    return 0;
+  }
+
+  if (flush_blocks(1) < 0) {
+    errno = EIO;
+    return -1;
+  }
+  return 0;
+}
+
+void sos_trace_stream_poll() { flush_blocks(0); }
+
+#endif
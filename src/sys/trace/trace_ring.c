@@ -0,0 +1,138 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "cortexm/cortexm.h"
+#include "trace_ring.h"
+
+static u32 get_count(u32 count) {
+  // round up to a power of two so the free running indexes wrap cleanly
+  u32 result = 1;
+  while (result < count) {
+    result <<= 1;
+  }
+  return result;
+}
+
+static u32 get_record_size(u32 data_size) {
+  return sizeof(trace_ring_record_t) + ((data_size + 3) & ~0x03);
+}
+
+static trace_ring_record_t *get_record(const trace_ring_t *ring, u32 index) {
+  return (trace_ring_record_t *)(ring->records + (index & ring->mask) * ring->record_size);
+}
+
+// returns the number of records the consumer can read
+static u32 get_readable(trace_ring_t *ring) {
+  const u32 count = ring->mask + 1;
+  const u32 readable = ring->head - ring->tail;
+  if (readable > count) {
+    // the producer lapped the consumer
+    ring->lost_count += readable - count;
+    ring->tail += readable - count;
+    return count;
+  }
+  return readable;
+}
+
+u32 trace_ring_get_storage_size(u32 count, u32 data_size) {
+  if ((count == 0) || (count > TRACE_RING_COUNT_MAX) || (data_size > TRACE_RING_DATA_SIZE_MAX)) {
+    return 0;
+  }
+  return get_count(count) * get_record_size(data_size);
+}
+
+void trace_ring_initialize(
+  trace_ring_t *ring,
+  void *storage,
+  u32 count,
+  u32 data_size,
+  int is_overwrite) {
+  memset(ring, 0, sizeof(trace_ring_t));
+  ring->records = storage;
+  ring->mask = get_count(count) - 1;
+  ring->record_size = get_record_size(data_size);
+  ring->is_overwrite = is_overwrite != 0;
+  ring->tid = -1;
+}
+
+int trace_ring_write(
+  trace_ring_t *ring,
+  u32 seconds,
+  u32 microseconds,
+  u32 address,
+  u16 event_id,
+  const void *data,
+  size_t data_size) {
+  const u32 head = ring->head;
+  if ((ring->is_overwrite == 0) && (head - ring->tail > ring->mask)) {
+    ring->drop_count++;
+    return -1;
+  }
+
+  trace_ring_record_t *record = get_record(ring, head);
+  const size_t capacity = ring->record_size - sizeof(trace_ring_record_t);
+  record->seconds = seconds;
+  record->microseconds = microseconds;
+  record->address = address;
+  record->event_id = event_id;
+  if (data_size > capacity) {
+    data_size = capacity;
+    record->data_size = data_size | TRACE_RING_RECORD_TRUNCATED;
+  } else {
+    record->data_size = data_size;
+  }
+  memcpy(record + 1, data, data_size);
+
+  // the record must be complete before the consumer can see it
+  __DMB();
+  ring->head = head + 1;
+  return 0;
+}
+
+int trace_ring_peek(trace_ring_t *ring, trace_ring_record_t *record) {
+  if (get_readable(ring) == 0) {
+    return 0;
+  }
+  __DMB();
+  // in overwrite mode this may be torn; trace_ring_read() checks
+  *record = *get_record(ring, ring->tail);
+  return 1;
+}
+
+int trace_ring_read(
+  trace_ring_t *ring,
+  trace_ring_record_t *record,
+  void *data,
+  size_t data_size) {
+  const size_t capacity = ring->record_size - sizeof(trace_ring_record_t);
+  while (get_readable(ring)) {
+    __DMB();
+    const u32 tail = ring->tail;
+    const trace_ring_record_t *source = get_record(ring, tail);
+    *record = *source;
+    size_t size = record->data_size & ~TRACE_RING_RECORD_TRUNCATED;
+    if (size > capacity) {
+      size = capacity;
+    }
+    if (size > data_size) {
+      size = data_size;
+    }
+    memcpy(data, source + 1, size);
+    __DMB();
+
+    if (ring->is_overwrite && (ring->head - tail > ring->mask)) {
+      // the producer may have been writing this slot during the copy
+      ring->lost_count++;
+      ring->tail = tail + 1;
+      continue;
+    }
+
+    // the slot can be reused once tail moves
+    ring->tail = tail + 1;
+    return size;
+  }
+  return -1;
+}
+
+void trace_ring_clear(trace_ring_t *ring) { ring->tail = ring->head; }
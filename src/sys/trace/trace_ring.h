@@ -0,0 +1,73 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef TRACE_TRACE_RING_H_
+#define TRACE_TRACE_RING_H_
+
+#include <sdk/types.h>
+#include <stddef.h>
+
+/*
+ * Single-producer, single-consumer ring of fixed-size trace records.
+ *
+ * Only the traced thread writes a ring (head) and only the reader of the
+ * trace stream consumes it (tail) so neither side needs a lock or a
+ * system call. When the ring is full an overwrite ring keeps writing and
+ * the reader skips what it lost; otherwise new records are dropped and
+ * counted.
+ */
+
+#define TRACE_RING_RECORD_TRUNCATED 0x8000
+#define TRACE_RING_DATA_SIZE_MAX 0x7ff0
+#define TRACE_RING_COUNT_MAX 0x8000
+
+typedef struct {
+  u32 seconds;      // scheduler clock overflow count (tv_sec of struct mcu_timeval)
+  u32 microseconds; // raw sos_config.clock.microseconds() value
+  u32 address;      // address of the caller (not converted)
+  u16 event_id;
+  u16 data_size; // TRACE_RING_RECORD_TRUNCATED is set if the data did not fit
+} trace_ring_record_t;
+
+typedef struct {
+  volatile u32 head;       // records written (only changed by the producer)
+  volatile u32 tail;       // records consumed (only changed by the consumer)
+  volatile u32 drop_count; // records dropped because the ring was full
+  u32 lost_count;          // records overwritten before they were read
+  u32 reported_count;      // drop_count + lost_count when status was last read
+  u8 *records;
+  u32 mask; // number of records - 1
+  u16 record_size;
+  u16 is_overwrite;
+  int tid;
+} trace_ring_t;
+
+u32 trace_ring_get_storage_size(u32 count, u32 data_size);
+void trace_ring_initialize(
+  trace_ring_t *ring,
+  void *storage,
+  u32 count,
+  u32 data_size,
+  int is_overwrite);
+
+int trace_ring_write(
+  trace_ring_t *ring,
+  u32 seconds,
+  u32 microseconds,
+  u32 address,
+  u16 event_id,
+  const void *data,
+  size_t data_size);
+
+int trace_ring_peek(trace_ring_t *ring, trace_ring_record_t *record);
+int trace_ring_read(
+  trace_ring_t *ring,
+  trace_ring_record_t *record,
+  void *data,
+  size_t data_size);
+void trace_ring_clear(trace_ring_t *ring);
+
+static inline int trace_ring_is_full(const trace_ring_t *ring) {
+  return ring->head - ring->tail > ring->mask;
+}
+
+#endif /* TRACE_TRACE_RING_H_ */
@@ -0,0 +1,210 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// Stress benchmark for link_mux: writes the same amount of data to a number
+// of virtual devices one device at a time and then through a link_mux, and
+// checks what each device received.
+//
+// link_mux_bench [device count] [writes per device] [bytes per write]
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "link_vdevice.h"
+#include "sos/link.h"
+#include "sos/link/mux.h"
+
+#define DEVICE_MAX 32
+
+typedef struct {
+  link_vdevice_t vdevice;
+  pthread_t thread;
+  link_transport_mdriver_t driver;
+  link_mux_t *mux;
+  link_mux_request_t request;
+  int fd;
+  int remaining;
+  int error_count;
+} device_t;
+
+static device_t m_devices[DEVICE_MAX];
+static int m_device_count = 4;
+static int m_write_count = 64;
+static int m_write_size = 1024;
+static u8 *m_data;
+
+static double get_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static int open_file(device_t *device, const char *path) {
+  device->fd = link_open(&device->driver, path, O_CREAT | O_RDWR | O_TRUNC, 0666);
+  return device->fd;
+}
+
+static int check_file(device_t *device) {
+  u8 *buffer = malloc((size_t)m_write_size);
+  int result = 0;
+
+  if (link_lseek(&device->driver, device->fd, 0, SEEK_SET) < 0) {
+    result = -1;
+  }
+
+  for (int i = 0; (result == 0) && (i < m_write_count); i++) {
+    if (
+      (link_read(&device->driver, device->fd, buffer, m_write_size) != m_write_size)
+      || memcmp(buffer, m_data, (size_t)m_write_size) != 0) {
+      result = -1;
+    }
+  }
+
+  free(buffer);
+  link_close(&device->driver, device->fd);
+  device->fd = -1;
+  return result;
+}
+
+static double run_sequential() {
+  const double start = get_ms();
+  for (int i = 0; i < m_device_count; i++) {
+    device_t *device = m_devices + i;
+    for (int j = 0; j < m_write_count; j++) {
+      if (link_write(&device->driver, device->fd, m_data, m_write_size) != m_write_size) {
+        device->error_count++;
+      }
+    }
+  }
+  return get_ms() - start;
+}
+
+static void write_complete(void *context, link_mux_request_t *request) {
+  device_t *device = context;
+  if (request->result != m_write_size) {
+    device->error_count++;
+  }
+
+  if (--device->remaining > 0) {
+    link_mux_write(
+      device->mux, &device->driver, &device->request, device->fd, m_data, m_write_size);
+  }
+}
+
+static double run_mux(link_mux_t *mux) {
+  const double start = get_ms();
+  for (int i = 0; i < m_device_count; i++) {
+    device_t *device = m_devices + i;
+    device->mux = mux;
+    device->remaining = m_write_count;
+    device->request.callback = write_complete;
+    device->request.context = device;
+    link_mux_write(mux, &device->driver, &device->request, device->fd, m_data, m_write_size);
+  }
+
+  // requests are suspended on the device stacks
+  if (link_mux_destroy(mux) == 0 || errno != EBUSY) {
+    printf("link_mux_destroy() didn't refuse pending requests\n");
+    m_devices[0].error_count++;
+  }
+
+  while (link_mux_run(mux, 100) > 0) {
+  }
+  return get_ms() - start;
+}
+
+static void print_result(const char *name, double ms) {
+  const double bytes = (double)m_device_count * m_write_count * m_write_size;
+  printf("%-10s %9.1fms %9.1fKB/s\n", name, ms, bytes / ms);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    m_device_count = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    m_write_count = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    m_write_size = atoi(argv[3]);
+  }
+
+  if ((m_device_count < 1) || (m_device_count > DEVICE_MAX) || (m_write_count < 1)
+      || (m_write_size < 1)) {
+    printf("usage: %s [devices (1 to %d)] [writes] [bytes]\n", argv[0], DEVICE_MAX);
+    return 1;
+  }
+
+  m_data = malloc((size_t)m_write_size);
+  for (int i = 0; i < m_write_size; i++) {
+    m_data[i] = (u8)(i * 7);
+  }
+
+  for (int i = 0; i < m_device_count; i++) {
+    device_t *device = m_devices + i;
+    if (link_vdevice_open(&device->vdevice, NULL, 2) < 0) {
+      perror("link_vdevice_open");
+      return 1;
+    }
+    pthread_create(&device->thread, NULL, link_vdevice_thread, &device->vdevice);
+
+    link_load_default_driver(&device->driver);
+    device->driver.phy_driver.handle = device->driver.phy_driver.open(
+      link_vdevice_name(&device->vdevice), device->driver.options);
+    if (device->driver.phy_driver.handle == LINK_PHY_OPEN_ERROR) {
+      printf("failed to open %s\n", link_vdevice_name(&device->vdevice));
+      return 1;
+    }
+  }
+
+  printf(
+    "%d devices, %d writes of %d bytes per device\n", m_device_count, m_write_count,
+    m_write_size);
+
+  int error_count = 0;
+  for (int i = 0; i < m_device_count; i++) {
+    if (open_file(m_devices + i, "/sequential.bin") < 0) {
+      error_count++;
+    }
+  }
+  print_result("sequential", run_sequential());
+  for (int i = 0; i < m_device_count; i++) {
+    if (check_file(m_devices + i) < 0) {
+      error_count++;
+    }
+  }
+
+  link_mux_t *mux = link_mux_create(m_device_count, 0);
+  for (int i = 0; i < m_device_count; i++) {
+    link_mux_add(mux, &m_devices[i].driver);
+    if (open_file(m_devices + i, "/mux.bin") < 0) {
+      error_count++;
+    }
+  }
+  print_result("mux", run_mux(mux));
+  if (link_mux_destroy(mux) < 0) {
+    error_count++;
+  }
+  for (int i = 0; i < m_device_count; i++) {
+    if (check_file(m_devices + i) < 0) {
+      error_count++;
+    }
+  }
+
+  for (int i = 0; i < m_device_count; i++) {
+    device_t *device = m_devices + i;
+    error_count += device->error_count;
+    device->driver.phy_driver.close(&device->driver.phy_driver.handle);
+    link_vdevice_stop(&device->vdevice);
+    pthread_join(device->thread, NULL);
+    link_vdevice_close(&device->vdevice);
+  }
+
+  free(m_data);
+  printf("%d errors\n", error_count);
+  return error_count ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// Benchmark and regression check for the link protocol against a virtual
+// device: measures command latency and file throughput and checks that
+// what the device stored is what the host sent.
+//
+// link_vdevice_bench [bytes per transfer] [latency iterations] [root directory]
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "link_vdevice.h"
+#include "sos/link.h"
+
+#define DIRECTORY_ENTRY_COUNT 50
+
+static link_transport_mdriver_t m_driver;
+static int m_transfer_size = 256 * 1024;
+static int m_iteration_count = 1000;
+static u8 *m_data;
+static u8 *m_buffer;
+static int m_error_count;
+
+static double get_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static void check(int condition, const char *name) {
+  if (!condition) {
+    printf("FAIL %s (link_errno %d)\n", name, link_errno);
+    m_error_count++;
+  }
+}
+
+static void print_latency(const char *name, double ms) {
+  printf("%-10s %9.1fus\n", name, ms * 1000.0 / m_iteration_count);
+}
+
+static void print_throughput(const char *name, double ms) {
+  printf("%-10s %9.1fms %9.1fKB/s\n", name, ms, m_transfer_size / ms);
+}
+
+static void run_latency() {
+  char serial_number[LINK_PACKET_DATA_SIZE + 1];
+  double start = get_ms();
+  for (int i = 0; i < m_iteration_count; i++) {
+    if (link_readserialno(&m_driver, serial_number, sizeof(serial_number)) < 0) {
+      check(0, "readserialno");
+      return;
+    }
+  }
+  print_latency("serialno", get_ms() - start);
+
+  struct stat st;
+  start = get_ms();
+  for (int i = 0; i < m_iteration_count; i++) {
+    if (link_stat(&m_driver, "/", &st) < 0) {
+      check(0, "stat");
+      return;
+    }
+  }
+  print_latency("stat", get_ms() - start);
+}
+
+static void run_file() {
+  const int fd = link_open(&m_driver, "/file.bin", O_CREAT | O_RDWR | O_TRUNC, 0666);
+  check(fd >= 0, "open");
+  if (fd < 0) {
+    return;
+  }
+
+  double start = get_ms();
+  check(link_write(&m_driver, fd, m_data, m_transfer_size) == m_transfer_size, "write");
+  print_throughput("write", get_ms() - start);
+
+  check(link_lseek(&m_driver, fd, 0, SEEK_SET) == 0, "lseek");
+  memset(m_buffer, 0, (size_t)m_transfer_size);
+  start = get_ms();
+  check(link_read(&m_driver, fd, m_buffer, m_transfer_size) == m_transfer_size, "read");
+  print_throughput("read", get_ms() - start);
+  check(memcmp(m_data, m_buffer, (size_t)m_transfer_size) == 0, "read contents");
+
+  struct stat st;
+  check(link_fstat(&m_driver, fd, &st) == 0, "fstat");
+  check(st.st_size == m_transfer_size, "fstat size");
+  check(link_close(&m_driver, fd) == 0, "close");
+}
+
+static void run_stream() {
+  double start = get_ms();
+  check(
+    link_sendfile(&m_driver, "/stream.bin", O_CREAT | O_TRUNC, 0, m_data, m_transfer_size)
+      == m_transfer_size,
+    "sendfile");
+  print_throughput("sendfile", get_ms() - start);
+
+  memset(m_buffer, 0, (size_t)m_transfer_size);
+  start = get_ms();
+  check(
+    link_recvfile(&m_driver, "/stream.bin", 0, m_buffer, m_transfer_size)
+      == m_transfer_size,
+    "recvfile");
+  print_throughput("recvfile", get_ms() - start);
+  check(memcmp(m_data, m_buffer, (size_t)m_transfer_size) == 0, "recvfile contents");
+
+  check(link_recvfile(&m_driver, "/missing.bin", 0, m_buffer, 1) < 0, "recvfile missing");
+}
+
+static void run_directory() {
+  check(link_mkdir(&m_driver, "/dir", 0777) == 0, "mkdir");
+  for (int i = 0; i < DIRECTORY_ENTRY_COUNT; i++) {
+    char path[LINK_PATH_MAX];
+    snprintf(path, sizeof(path), "/dir/file_with_a_long_name_%03d", i);
+    const int fd = link_open(&m_driver, path, O_CREAT | O_RDWR, 0666);
+    check(fd >= 0 && link_close(&m_driver, fd) == 0, "create");
+  }
+
+  const double start = get_ms();
+  DIR *dirp = link_opendir(&m_driver, "/dir");
+  check(dirp != NULL, "opendir");
+  if (dirp == NULL) {
+    return;
+  }
+
+  struct dirent entry;
+  struct dirent *result;
+  int count = 0;
+  while (link_readdir_r(&m_driver, dirp, &entry, &result) == 0 && result != NULL) {
+    if (strncmp(entry.d_name, "file_with_a_long_name_", 22) == 0) {
+      count++;
+    }
+  }
+  check(link_closedir(&m_driver, dirp) == 0, "closedir");
+  printf("%-10s %9.1fms %9d entries\n", "readdir", get_ms() - start, count);
+  check(count == DIRECTORY_ENTRY_COUNT, "readdir entries");
+}
+
+int main(int argc, char *argv[]) {
+  const char *root = NULL;
+  if (argc > 1) {
+    m_transfer_size = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    m_iteration_count = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    root = argv[3];
+  }
+
+  if ((m_transfer_size < 1) || (m_iteration_count < 1)) {
+    printf("usage: %s [bytes] [iterations] [root directory]\n", argv[0]);
+    return 1;
+  }
+
+  m_data = malloc((size_t)m_transfer_size);
+  m_buffer = malloc((size_t)m_transfer_size);
+  for (int i = 0; i < m_transfer_size; i++) {
+    m_data[i] = (u8)(i * 7);
+  }
+
+  link_vdevice_t vdevice;
+  if (link_vdevice_open(&vdevice, root, 2) < 0) {
+    perror("link_vdevice_open");
+    return 1;
+  }
+  pthread_t thread;
+  pthread_create(&thread, NULL, link_vdevice_thread, &vdevice);
+
+  link_load_default_driver(&m_driver);
+  m_driver.phy_driver.handle =
+    m_driver.phy_driver.open(link_vdevice_name(&vdevice), m_driver.options);
+  if (m_driver.phy_driver.handle == LINK_PHY_OPEN_ERROR) {
+    printf("failed to open %s\n", link_vdevice_name(&vdevice));
+    return 1;
+  }
+
+  printf(
+    "%s: %d byte transfers, %d latency iterations\n", vdevice.root, m_transfer_size,
+    m_iteration_count);
+  run_latency();
+  run_file();
+  run_stream();
+  run_directory();
+
+  m_driver.phy_driver.close(&m_driver.phy_driver.handle);
+  link_vdevice_stop(&vdevice);
+  pthread_join(thread, NULL);
+  link_vdevice_close(&vdevice);
+
+  free(m_data);
+  free(m_buffer);
+  printf("%u commands, %d errors\n", vdevice.command_count, m_error_count);
+  return m_error_count ? 1 : 0;
+}
@@ -0,0 +1,717 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#if defined __macosx || defined __linux
+
+#if defined __linux
+// posix_openpt(), ptsname() and cfmakeraw()
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "boot/boot_link_sys.h"
+#include "link_vdevice.h"
+#include "sos/dev/flash.h"
+#include "sys/link/link_sys.h"
+
+// how often a blocked read checks whether the device has been stopped
+#define READ_POLL_TIMEOUT_MS 100
+
+// the slave transport on a board blocks in read() so it never times out
+#define TRANSPORT_TIMEOUT_MS 1000
+
+// written to the software bootloader request by boot_link_cmd_reset_bootloader()
+#define BOOTLOADER_REQUEST_VALUE 0x55AA55AA
+
+// the virtual device running link_vdevice_update() in this thread
+static __thread link_vdevice_t *m_vdevice;
+static __thread jmp_buf m_reset;
+static __thread u32 m_software_bootloader_request;
+
+static int phy_write(link_transport_phy_t handle, const void *buf, int nbyte);
+static int phy_read(link_transport_phy_t handle, void *buf, int nbyte);
+static int phy_close(link_transport_phy_t *handle);
+static void phy_wait(int msec);
+static void phy_flush(link_transport_phy_t handle);
+
+static void get_serial_number(mcu_sn_t *serial_number);
+static int flash_erase_page(const devfs_handle_t *handle, void *ctl);
+static int flash_write_page(const devfs_handle_t *handle, void *ctl);
+static int flash_get_page_info(const devfs_handle_t *handle, void *ctl);
+static u8 *get_flash(link_vdevice_t *vdevice, u32 addr, u32 nbyte);
+
+static int get_path(char *dest, const char *path);
+static int convert_flags(int link_flags);
+static link_vdevice_dir_t *get_dir(DIR *dirp);
+
+// the bootloader is the only user (see link_vdevice_set_flash())
+boot_link_sys_config_t sos_config = {
+  .sys.get_serial_number = get_serial_number,
+  .boot.software_bootloader_request_value = BOOTLOADER_REQUEST_VALUE,
+  .boot.flash_erase_page = flash_erase_page,
+  .boot.flash_write_page = flash_write_page,
+  .boot.flash_get_page_info = flash_get_page_info};
+
+int link_vdevice_open(link_vdevice_t *vdevice, const char *root, int transport_version) {
+  memset(vdevice, 0, sizeof(link_vdevice_t));
+  vdevice->fd = -1;
+  vdevice->slave_fd = -1;
+
+  if (transport_version == 2) {
+    vdevice->driver.transport_read = link2_transport_slaveread;
+    vdevice->driver.transport_write = link2_transport_slavewrite;
+  } else if (transport_version == 3) {
+    vdevice->driver.transport_read = link3_transport_slaveread;
+    vdevice->driver.transport_write = link3_transport_slavewrite;
+  } else {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (root == NULL) {
+    strcpy(vdevice->root, "/tmp/link-vdevice-XXXXXX");
+    if (mkdtemp(vdevice->root) == NULL) {
+      return -1;
+    }
+  } else {
+    if (strlen(root) >= sizeof(vdevice->root)) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+    strcpy(vdevice->root, root);
+  }
+
+  vdevice->fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (vdevice->fd < 0) {
+    return -1;
+  }
+
+  if (grantpt(vdevice->fd) < 0 || unlockpt(vdevice->fd) < 0) {
+    goto close_master;
+  }
+
+  const char *name = ptsname(vdevice->fd);
+  if (name == NULL || strlen(name) >= sizeof(vdevice->name)) {
+    goto close_master;
+  }
+  strcpy(vdevice->name, name);
+
+  vdevice->slave_fd = open(vdevice->name, O_RDWR | O_NOCTTY);
+  if (vdevice->slave_fd < 0) {
+    goto close_master;
+  }
+
+  // the link protocol is binary -- no echo or line processing
+  struct termios options;
+  if (tcgetattr(vdevice->slave_fd, &options) < 0) {
+    goto close_slave;
+  }
+  cfmakeraw(&options);
+  if (tcsetattr(vdevice->slave_fd, TCSANOW, &options) < 0) {
+    goto close_slave;
+  }
+
+  vdevice->serial_number.sn[0] = (u32)vdevice->fd;
+  vdevice->serial_number.sn[1] = (u32)getpid();
+
+  vdevice->driver.handle = vdevice;
+  vdevice->driver.write = phy_write;
+  vdevice->driver.read = phy_read;
+  vdevice->driver.close = phy_close;
+  vdevice->driver.wait = phy_wait;
+  vdevice->driver.flush = phy_flush;
+  vdevice->driver.timeout = TRANSPORT_TIMEOUT_MS;
+  vdevice->is_running = 1;
+
+  link_debug(LINK_DEBUG_INFO, "virtual device at %s (%s)", vdevice->name, vdevice->root);
+  return 0;
+
+close_slave:
+  close(vdevice->slave_fd);
+  vdevice->slave_fd = -1;
+close_master:
+  close(vdevice->fd);
+  vdevice->fd = -1;
+  return -1;
+}
+
+const char *link_vdevice_name(const link_vdevice_t *vdevice) { return vdevice->name; }
+
+void link_vdevice_set_flash(
+  link_vdevice_t *vdevice,
+  void *memory,
+  u32 address,
+  u32 size,
+  u32 page_size,
+  u32 program_start_address) {
+  memset(&vdevice->flash, 0, sizeof(vdevice->flash));
+  vdevice->flash.memory = memory;
+  vdevice->flash.address = address;
+  vdevice->flash.size = size;
+  vdevice->flash.page_size = page_size;
+  vdevice->flash.program_start_address = program_start_address;
+}
+
+int link_vdevice_update(link_vdevice_t *vdevice) {
+  link_op_t op;
+  int err;
+
+  // wait for the next command (see link_update())
+  do {
+    op = (link_op_t){};
+    if (vdevice->is_running == 0) {
+      return LINK_PHY_ERROR;
+    }
+    err = link_transport_slaveread(&vdevice->driver, &op, sizeof(op), NULL, NULL);
+  } while (err <= 0);
+
+  vdevice->command_count++;
+  m_vdevice = vdevice;
+  if (vdevice->flash.memory != NULL) {
+    sos_config.boot.program_start_address = vdevice->flash.program_start_address;
+    sos_config.boot.software_bootloader_request_address = &m_software_bootloader_request;
+    if (setjmp(m_reset) == 0) {
+      boot_link_execute(&vdevice->driver, &op);
+    } else {
+      // a board resets without a reply and the device stays a bootloader
+      link_debug(
+        LINK_DEBUG_INFO, "reset (request 0x%X)", m_software_bootloader_request);
+    }
+  } else {
+    link_execute(&vdevice->driver, &op);
+  }
+  m_vdevice = NULL;
+
+  return 0;
+}
+
+void *link_vdevice_thread(void *vdevice) {
+  while (link_vdevice_update(vdevice) == 0) {
+  }
+  return NULL;
+}
+
+void link_vdevice_stop(link_vdevice_t *vdevice) { vdevice->is_running = 0; }
+
+void link_vdevice_close(link_vdevice_t *vdevice) {
+  vdevice->is_running = 0;
+  for (int i = 0; i < LINK_VDEVICE_DIR_MAX; i++) {
+    if (vdevice->dirs[i].dirp) {
+      closedir(vdevice->dirs[i].dirp);
+      vdevice->dirs[i].dirp = NULL;
+    }
+  }
+
+  if (vdevice->slave_fd >= 0) {
+    close(vdevice->slave_fd);
+    vdevice->slave_fd = -1;
+  }
+
+  if (vdevice->fd >= 0) {
+    close(vdevice->fd);
+    vdevice->fd = -1;
+  }
+}
+
+int phy_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  link_vdevice_t *vdevice = handle;
+  const char *p = buf;
+  int bytes = 0;
+  while (bytes < nbyte) {
+    const int result = write(vdevice->fd, p + bytes, nbyte - bytes);
+    if (result < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      return LINK_PHY_ERROR;
+    }
+    bytes += result;
+  }
+  return bytes;
+}
+
+int phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
+  link_vdevice_t *vdevice = handle;
+  struct pollfd pfd = {.fd = vdevice->fd, .events = POLLIN};
+
+  // block like the phy on a board but give up when the device is stopped
+  while (vdevice->is_running) {
+    const int result = poll(&pfd, 1, READ_POLL_TIMEOUT_MS);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return LINK_PHY_ERROR;
+    }
+
+    if (result > 0) {
+      const int bytes = read(vdevice->fd, buf, nbyte);
+      if (bytes < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+          continue;
+        }
+        return LINK_PHY_ERROR;
+      }
+      if (bytes > 0) {
+        return bytes;
+      }
+    }
+  }
+
+  return LINK_PHY_ERROR;
+}
+
+void phy_wait(int msec) { usleep(msec * 1000); }
+
+void phy_flush(link_transport_phy_t handle) {
+  link_vdevice_t *vdevice = handle;
+  struct pollfd pfd = {.fd = vdevice->fd, .events = POLLIN};
+  char buffer[64];
+  while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+    if (read(vdevice->fd, buffer, sizeof(buffer)) <= 0) {
+      return;
+    }
+  }
+}
+
+
+int phy_close(link_transport_phy_t *handle) {
+  // the pty stays open so the host can reconnect like it would after a reset
+  MCU_UNUSED_ARGUMENT(handle);
+  return 0;
+}
+
+int link_transport_slaveread(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  return driver->transport_read(driver, buf, nbyte, callback, context);
+}
+
+int link_transport_slavewrite(
+  link_transport_driver_t *driver,
+  const void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  return driver->transport_write(driver, buf, nbyte, callback, context);
+}
+
+void sos_handle_event(int event, void *args) {
+  MCU_UNUSED_ARGUMENT(event);
+  MCU_UNUSED_ARGUMENT(args);
+}
+
+void sos_led_root_enable() {}
+
+void sos_led_root_disable() {}
+
+char htoc(int nibble) {
+  // the same as htoc() in src/cortexm/util.c
+  if (nibble >= 0 && nibble < 10) {
+    return (char)nibble + '0';
+  }
+  return (char)nibble + 'A' - 10;
+}
+
+void cortexm_reset(void *args) {
+  MCU_UNUSED_ARGUMENT(args);
+  longjmp(m_reset, 1);
+}
+
+u32 cortexm_get_hardware_id() { return 0; }
+
+void link_sys_get_serial_number(mcu_sn_t *serial_number) {
+  *serial_number = m_vdevice->serial_number;
+}
+
+void get_serial_number(mcu_sn_t *serial_number) {
+  *serial_number = m_vdevice->serial_number;
+}
+
+int flash_get_page_info(const devfs_handle_t *handle, void *ctl) {
+  const link_vdevice_flash_t *flash = &m_vdevice->flash;
+  flash_pageinfo_t *info = ctl;
+  MCU_UNUSED_ARGUMENT(handle);
+  if (info->page >= flash->size / flash->page_size) {
+    errno = EINVAL;
+    return -1;
+  }
+  info->addr = flash->address + info->page * flash->page_size;
+  info->size = flash->page_size;
+  return 0;
+}
+
+int flash_erase_page(const devfs_handle_t *handle, void *ctl) {
+  link_vdevice_flash_t *flash = &m_vdevice->flash;
+  // ctl is the page number (see erase_flash() in boot_link.c)
+  flash_pageinfo_t info = {.page = (u32)(size_t)ctl};
+  if (flash_get_page_info(handle, &info) < 0) {
+    return -1;
+  }
+
+  if (info.addr < flash->program_start_address) {
+    // the bootloader pages can't be erased
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(get_flash(m_vdevice, info.addr, info.size), 0xff, info.size);
+  flash->erase_count++;
+  return 0;
+}
+
+int flash_write_page(const devfs_handle_t *handle, void *ctl) {
+  link_vdevice_flash_t *flash = &m_vdevice->flash;
+  const bootloader_writepage_t *wattr = ctl;
+  MCU_UNUSED_ARGUMENT(handle);
+
+  u8 *dest = wattr->nbyte > sizeof(wattr->buf)
+               ? NULL
+               : get_flash(m_vdevice, wattr->addr, wattr->nbyte);
+  if (dest == NULL || wattr->addr < flash->program_start_address) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // programming can only clear bits
+  for (u32 i = 0; i < wattr->nbyte; i++) {
+    dest[i] &= wattr->buf[i];
+  }
+  flash->write_count += wattr->nbyte;
+  return 0;
+}
+
+int mcu_sync_io(
+  const devfs_handle_t *handle,
+  int (*func)(const devfs_handle_t *handle, devfs_async_t *op),
+  int loc,
+  const void *buf,
+  int nbyte,
+  int flags) {
+  // the simulated flash is the only device (func reads it with boot_link_sys_flash())
+  const link_vdevice_flash_t *flash = &m_vdevice->flash;
+  if ((u32)loc < flash->address || (u32)loc - flash->address >= flash->size) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const u32 offset = (u32)loc - flash->address;
+  devfs_async_t async = {
+    .loc = loc,
+    .buf_const = buf,
+    .nbyte = (u32)nbyte < flash->size - offset ? nbyte : flash->size - offset,
+    .flags = flags};
+  return func(handle, &async);
+}
+
+const void *boot_link_sys_flash(u32 address, u32 size) {
+  return get_flash(m_vdevice, address, size);
+}
+
+int link_sys_driver_fildes(const link_transport_driver_t *driver) {
+  MCU_UNUSED_ARGUMENT(driver);
+  return m_vdevice->fd;
+}
+
+int link_sys_open(const char *path, int flags, int mode) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return open(host_path, convert_flags(flags), mode);
+}
+
+int link_sys_close(int fildes) {
+  // the host can't close the pty
+  if (fildes == m_vdevice->fd || fildes == m_vdevice->slave_fd) {
+    errno = EBADF;
+    return -1;
+  }
+  return close(fildes);
+}
+
+int link_sys_read(int fildes, void *buf, int nbyte) { return read(fildes, buf, nbyte); }
+
+int link_sys_write(int fildes, const void *buf, int nbyte) {
+  return write(fildes, buf, nbyte);
+}
+
+int link_sys_lseek(int fildes, int offset, int whence) {
+  return lseek(fildes, offset, whence);
+}
+
+int link_sys_fstat(int fildes, struct stat *st) { return fstat(fildes, st); }
+
+DIR *link_sys_opendir(const char *path) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return NULL;
+  }
+
+  for (int i = 0; i < LINK_VDEVICE_DIR_MAX; i++) {
+    link_vdevice_dir_t *dir = m_vdevice->dirs + i;
+    if (dir->dirp == NULL) {
+      dir->dirp = opendir(host_path);
+      if (dir->dirp == NULL) {
+        return NULL;
+      }
+      dir->loc = 0;
+      // the link protocol only has 32-bits for dirp
+      return (DIR *)(size_t)(i + 1);
+    }
+  }
+
+  errno = EMFILE;
+  return NULL;
+}
+
+int link_sys_readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result) {
+  link_vdevice_dir_t *dir = get_dir(dirp);
+  if (dir == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  dir->position = telldir(dir->dirp);
+  errno = 0;
+  const struct dirent *host_entry = readdir(dir->dirp);
+  if (host_entry == NULL) {
+    // the end of the directory is an error on the device
+    if (errno == 0) {
+      errno = ENOENT;
+    }
+    return -1;
+  }
+  dir->loc++;
+
+  // names are truncated to what struct link_dirent can hold
+  const size_t name_size = strnlen(host_entry->d_name, LINK_NAME_MAX_LARGE);
+  entry->d_ino = host_entry->d_ino;
+  memcpy(entry->d_name, host_entry->d_name, name_size);
+  entry->d_name[name_size] = 0;
+  if (result != NULL) {
+    *result = entry;
+  }
+  return 0;
+}
+
+int link_sys_closedir(DIR *dirp) {
+  link_vdevice_dir_t *dir = get_dir(dirp);
+  if (dir == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  const int result = closedir(dir->dirp);
+  dir->dirp = NULL;
+  return result;
+}
+
+void link_sys_seekdir(DIR *dirp, long loc) {
+  link_vdevice_dir_t *dir = get_dir(dirp);
+  if (dir == NULL || loc == dir->loc) {
+    return;
+  }
+
+  if (loc == dir->loc - 1) {
+    // link_cmd_readdir_bulk() backs up one entry when a transfer is full
+    seekdir(dir->dirp, dir->position);
+    dir->loc = loc;
+    return;
+  }
+
+  // locations are entry counts (not host locations)
+  rewinddir(dir->dirp);
+  dir->loc = 0;
+  while (dir->loc < loc && readdir(dir->dirp) != NULL) {
+    dir->loc++;
+  }
+}
+
+long link_sys_telldir(DIR *dirp) {
+  const link_vdevice_dir_t *dir = get_dir(dirp);
+  if (dir == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  return dir->loc;
+}
+
+int link_sys_stat(const char *path, struct stat *st) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return stat(host_path, st);
+}
+
+int link_sys_mkdir(const char *path, mode_t mode) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return mkdir(host_path, mode);
+}
+
+int link_sys_rmdir(const char *path) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return rmdir(host_path);
+}
+
+int link_sys_unlink(const char *path) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return unlink(host_path);
+}
+
+int link_sys_link(const char *old_path, const char *new_path) {
+  char host_old_path[PATH_MAX + 1];
+  char host_new_path[PATH_MAX + 1];
+  if (get_path(host_old_path, old_path) < 0 || get_path(host_new_path, new_path) < 0) {
+    return -1;
+  }
+  return link(host_old_path, host_new_path);
+}
+
+int link_sys_rename(const char *old_path, const char *new_path) {
+  char host_old_path[PATH_MAX + 1];
+  char host_new_path[PATH_MAX + 1];
+  if (get_path(host_old_path, old_path) < 0 || get_path(host_new_path, new_path) < 0) {
+    return -1;
+  }
+  return rename(host_old_path, host_new_path);
+}
+
+int link_sys_chmod(const char *path, mode_t mode) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return chmod(host_path, mode);
+}
+
+int link_sys_chown(const char *path, uid_t uid, gid_t gid) {
+  char host_path[PATH_MAX + 1];
+  if (get_path(host_path, path) < 0) {
+    return -1;
+  }
+  return chown(host_path, uid, gid);
+}
+
+int link_sys_ioctl(int fildes, int request, void *arg) {
+  // there are no device drivers to pass the request to
+  if (_IOCTL_IOCTLR(request) != 0) {
+    // link_cmd_ioctl() sends the buffer to the host anyway
+    memset(arg, 0, _IOCTL_SIZE(request));
+  }
+
+  link_debug(LINK_DEBUG_MESSAGE, "ioctl 0x%08x is not supported", request);
+  // the OS replies EBADF to bootloader requests (see link_bootloader_attr())
+  errno = fildes == LINK_BOOTLOADER_FILDES ? EBADF : ENOTSUP;
+  return -1;
+}
+
+int link_sys_mkfs(const char *path) {
+  MCU_UNUSED_ARGUMENT(path);
+  errno = ENOTSUP;
+  return -1;
+}
+
+int link_sys_process_start(const char *path_arg, char *const envp[]) {
+  MCU_UNUSED_ARGUMENT(path_arg);
+  MCU_UNUSED_ARGUMENT(envp);
+  errno = ENOTSUP;
+  return -1;
+}
+
+u8 *get_flash(link_vdevice_t *vdevice, u32 addr, u32 nbyte) {
+  link_vdevice_flash_t *flash = &vdevice->flash;
+  if (
+    addr < flash->address || nbyte > flash->size
+    || addr - flash->address > flash->size - nbyte) {
+    return NULL;
+  }
+  return flash->memory + (addr - flash->address);
+}
+
+int get_path(char *dest, const char *path) {
+  const char *root = m_vdevice->root;
+
+  // device paths are absolute and must stay inside the root directory
+  if (strstr(path, "..") != NULL) {
+    errno = EACCES;
+    return -1;
+  }
+
+  if (strlen(root) + strlen(path) + 1 > PATH_MAX) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  strcpy(dest, root);
+  if (path[0] != '/') {
+    strcat(dest, "/");
+  }
+  strcat(dest, path);
+  return 0;
+}
+
+link_vdevice_dir_t *get_dir(DIR *dirp) {
+  const size_t index = (size_t)dirp;
+  if (index < 1 || index > LINK_VDEVICE_DIR_MAX) {
+    return NULL;
+  }
+  link_vdevice_dir_t *dir = m_vdevice->dirs + index - 1;
+  return dir->dirp ? dir : NULL;
+}
+
+int convert_flags(int link_flags) {
+  // the reverse of convert_flags() in link_file.c
+  int result = 0;
+  switch (link_flags & LINK_O_ACCMODE) {
+  case LINK_O_WRONLY:
+    result = O_WRONLY;
+    break;
+  case LINK_O_RDWR:
+    result = O_RDWR;
+    break;
+  default:
+    result = O_RDONLY;
+    break;
+  }
+
+  if (link_flags & LINK_O_CREAT) {
+    result |= O_CREAT;
+  }
+  if (link_flags & LINK_O_APPEND) {
+    result |= O_APPEND;
+  }
+  if (link_flags & LINK_O_EXCL) {
+    result |= O_EXCL;
+  }
+  if (link_flags & LINK_O_TRUNC) {
+    result |= O_TRUNC;
+  }
+  if (link_flags & LINK_O_NONBLOCK) {
+    result |= O_NONBLOCK;
+  }
+  return result;
+}
+
+#endif
@@ -0,0 +1,124 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef LINK_VDEVICE_H_
+#define LINK_VDEVICE_H_
+
+#include <limits.h>
+
+#include "sos/link.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*! \details A virtual device serves the device side of the link protocol on the host.
+ *
+ * The virtual device runs the same slave transport
+ * (link2_transport_slaveread()/link3_transport_slaveread()) and the same
+ * command handlers (src/sys/link/link_thread.c and src/boot/boot_link.c)
+ * as a board on the master side of a pseudo-terminal. Host code connects to the pty slave (see
+ * link_vdevice_name()) exactly as it would to a tty of a real board.
+ * Device paths are mapped into the \a root directory so placing \a root
+ * on a tmpfs (such as /dev/shm) keeps the file system in memory.
+ *
+ * The command handlers get their kernel services from link_sys.h and
+ * boot_link_sys.h which this library implements on the host. It is
+ * only built for tests (SOS_LINK_IS_TEST) and only on POSIX hosts.
+ *
+ */
+
+#define LINK_VDEVICE_DIR_MAX 16
+
+typedef struct {
+  void *dirp /*! Host DIR pointer (the link protocol only has 32-bits for dirp) */;
+  s32 loc /*! Number of entries read so far */;
+  long position /*! Host location of the last entry read */;
+} link_vdevice_dir_t;
+
+/*! \details Simulated flash for a virtual device running as a bootloader.
+ *
+ * Pages are \a page_size bytes starting at \a address. Writes can only
+ * clear bits (like NOR flash) so writing a page that hasn't been erased
+ * corrupts it the same way it would on a board.
+ */
+typedef struct {
+  u8 *memory /*! Contents of the flash (NULL if the device is not a bootloader) */;
+  u32 address /*! Address of the first byte of \a memory */;
+  u32 size;
+  u32 page_size;
+  u32 program_start_address /*! Pages before this hold the bootloader and can't be erased */;
+  u32 erase_count /*! Number of pages erased */;
+  u32 write_count /*! Number of bytes written */;
+} link_vdevice_flash_t;
+
+typedef struct {
+  link_transport_driver_t driver;
+  int fd /*! pty master */;
+  int slave_fd /*! Held open so the pty is not hung up between host connections */;
+  volatile int is_running;
+  char root[PATH_MAX];
+  char name[LINK_PATH_MAX] /*! Path to the pty slave */;
+  mcu_sn_t serial_number;
+  link_vdevice_dir_t dirs[LINK_VDEVICE_DIR_MAX];
+  link_vdevice_flash_t flash;
+  u32 command_count;
+} link_vdevice_t;
+
+/*! \details Creates the pty and prepares the slave transport.
+ *
+ * @param vdevice The virtual device to initialize
+ * @param root Host directory that device paths are mapped into
+ * @param transport_version 2 or 3 (3 requires driver.crypto_driver to be assigned)
+ * \return Zero on success or -1 with errno set
+ */
+int link_vdevice_open(link_vdevice_t *vdevice, const char *root, int transport_version);
+const char *link_vdevice_name(const link_vdevice_t *vdevice);
+
+/*! \details Makes the virtual device act as a bootloader for \a memory.
+ *
+ * The device then only accepts the bootloader commands (see boot_link.c):
+ * link_isbootloader(), link_eraseflash(), link_writeflash(),
+ * link_writeflash_delta(), link_readflash() and link_verify_signature().
+ * Resetting the device doesn't send a reply (like a board) and leaves it
+ * running as a bootloader. boot_link.c keeps the first page of an image in
+ * a static buffer so only write one virtual bootloader at a time. \a memory must remain valid until the device
+ * is closed. Call this before starting link_vdevice_thread().
+ */
+void link_vdevice_set_flash(
+  link_vdevice_t *vdevice,
+  void *memory,
+  u32 address,
+  u32 size,
+  u32 page_size,
+  u32 program_start_address);
+
+/*! \details Waits for one command from the master and executes it.
+ *
+ * \return Zero when a command was executed, or LINK_PHY_ERROR once stopped
+ */
+int link_vdevice_update(link_vdevice_t *vdevice);
+
+/*! \details Runs link_vdevice_update() until link_vdevice_stop() is called.
+ *
+ * This can be passed directly to pthread_create().
+ */
+void *link_vdevice_thread(void *vdevice);
+
+/*! \details Causes link_vdevice_update() to return LINK_PHY_ERROR within about 100ms.
+ *
+ * This is safe to call from another thread.
+ */
+void link_vdevice_stop(link_vdevice_t *vdevice);
+
+/*! \details Closes the pty and any open directories.
+ *
+ * Files in the root directory are left in place. Call this
+ * after the thread running link_vdevice_update() has returned.
+ */
+void link_vdevice_close(link_vdevice_t *vdevice);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LINK_VDEVICE_H_ */